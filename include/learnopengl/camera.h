@@ -133,6 +133,14 @@ public:
             Zoom = 45.0f; 
     }
 
+    // sets the Euler Angles directly, e.g. when the camera follows a scripted path
+    void SetOrientation(float yaw, float pitch)
+    {
+        Yaw = yaw;
+        Pitch = pitch;
+        updateCameraVectors();
+    }
+
 private:
     // calculates the front vector from the Camera's (updated) Euler Angles
     void updateCameraVectors()
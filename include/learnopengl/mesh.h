@@ -7,6 +7,9 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <learnopengl/shader.h>
+#include <rg/Bounds.h>
+#include <rg/MemoryTracker.h>
+#include <rg/TextureStreamer.h>
 
 #include <string>
 #include <vector>
@@ -41,29 +44,108 @@ public:
     vector<Texture>      textures;
 
     unsigned int VAO;
+    // positions only, for depth-only passes that don't need the rest of the vertex
+    unsigned int PositionVAO;
     std::string glslIdentifierPrefix;
+    // sampler uniform of every texture (prefix + type + number), built once so Draw doesn't build strings
+    vector<string> samplerNames;
+    // object space bounds, used for culling
+    rg::Aabb bounds;
+    // material features, select the shader permutation this mesh is drawn with
+    bool hasSpecularMap = false;
+    bool hasNormalMap = false;
+    // the diffuse texture cuts out texels (leaves ...), every pass has to discard them
+    bool alphaTested = false;
     // constructor
     Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
     {
         this->vertices = vertices;
         this->indices = indices;
         this->textures = textures;
+        for (const Vertex& vertex : this->vertices)
+            bounds.Expand(vertex.Position);
+        for (unsigned int i = 0; i < this->textures.size(); i++) {
+            const Texture& texture = this->textures[i];
+            hasSpecularMap |= texture.type == "texture_specular";
+            hasNormalMap |= texture.type == "texture_normal";
+            if (texture.type == "texture_diffuse" && diffuseIndex < 0) {
+                diffuseIndex = i;
+                alphaTested = rg::TextureStreamer::Instance().Cutout(texture.id);
+            }
+        }
+
+        updateSamplerNames();
 
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
         setupMesh();
     }
 
+    void SetSamplerPrefix(const std::string& prefix)
+    {
+        glslIdentifierPrefix = prefix;
+        updateSamplerNames();
+    }
+
     // render the mesh
-    void Draw(Shader &shader)
+    void Draw(Shader &shader) const
     {
+        BindMaterial(shader);
+
+        // draw mesh, the texture units and the vertex array stay as they are, whoever draws next binds what it needs
+        DrawGeometry();
+    }
+
+    // selects the shader permutation of the material and binds its textures, leaves the last texture unit active
+    void BindMaterial(Shader &shader) const
+    {
+        // pick the permutation matching the material, the program only changes when the features differ
+        shader.SetFeature(ShaderFeatures::HAS_SPECULAR_MAP, hasSpecularMap);
+        shader.SetFeature(ShaderFeatures::HAS_NORMAL_MAP, hasNormalMap);
+        shader.SetFeature(ShaderFeatures::ALPHA_TEST, alphaTested);
         // bind appropriate textures
+        for(unsigned int i = 0; i < textures.size(); i++)
+        {
+            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
+            // now set the sampler to the correct texture unit
+            shader.setInt(samplerNames[i], i);
+            // and finally bind the texture
+            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+        }
+    }
+
+    // what a depth-only pass needs of the material: the ALPHA_TEST permutation and the diffuse texture on unit 0
+    // for alpha tested meshes, their depth has to be drawn with VAO instead of PositionVAO then
+    void BindAlphaTest(Shader &shader) const
+    {
+        shader.SetFeature(ShaderFeatures::ALPHA_TEST, alphaTested);
+        if (!alphaTested)
+            return;
+        glActiveTexture(GL_TEXTURE0);
+        shader.setInt(samplerNames[diffuseIndex], 0);
+        glBindTexture(GL_TEXTURE_2D, textures[diffuseIndex].id);
+    }
+
+    // render only the geometry, used by depth-only passes that don't sample any material textures
+    void DrawGeometry() const
+    {
+        glBindVertexArray(VAO);
+        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+    }
+
+private:
+    // render data
+    unsigned int VBO, EBO, PositionVBO;
+    int diffuseIndex = -1;
+
+    void updateSamplerNames()
+    {
         unsigned int diffuseNr  = 1;
         unsigned int specularNr = 1;
         unsigned int normalNr   = 1;
         unsigned int heightNr   = 1;
+        samplerNames.clear();
         for(unsigned int i = 0; i < textures.size(); i++)
         {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
             // retrieve texture number (the N in diffuse_textureN)
             string number;
             string name = textures[i].type;
@@ -75,28 +157,10 @@ public:
                 number = std::to_string(normalNr++); // transfer unsigned int to stream
             else if(name == "texture_height")
                 number = std::to_string(heightNr++); // transfer unsigned int to stream
-
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (glslIdentifierPrefix + name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            samplerNames.push_back(glslIdentifierPrefix + name + number);
         }
-
-
-
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
-
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
     }
 
-private:
-    // render data
-    unsigned int VBO, EBO;
-
     // initializes all the buffer objects/arrays
     void setupMesh()
     {
@@ -115,6 +179,12 @@ private:
 
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
         glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+        // the vertex and index vectors stay around as CPU copies, they are tracked under the VAO
+        rg::MemoryTracker& memory = rg::MemoryTracker::Instance();
+        memory.Track(rg::MemoryTracker::Kind::Buffer, VBO, "Mesh vertices", vertices.size() * sizeof(Vertex));
+        memory.Track(rg::MemoryTracker::Kind::Buffer, EBO, "Mesh indices", indices.size() * sizeof(unsigned int));
+        memory.Track(rg::MemoryTracker::Kind::Cpu, VAO, "Mesh CPU copy",
+                     vertices.capacity() * sizeof(Vertex) + indices.capacity() * sizeof(unsigned int));
 
         // set the vertex attribute pointers
         // vertex Positions
@@ -133,6 +203,20 @@ private:
         glEnableVertexAttribArray(4);
         glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
 
+        // tightly packed positions sharing the index buffer, a depth-only pass fetches 12 instead of 56 bytes per vertex
+        vector<glm::vec3> positions(vertices.size());
+        for (size_t i = 0; i < vertices.size(); i++)
+            positions[i] = vertices[i].Position;
+        glGenVertexArrays(1, &PositionVAO);
+        glGenBuffers(1, &PositionVBO);
+        glBindVertexArray(PositionVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, PositionVBO);
+        glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(glm::vec3), &positions[0], GL_STATIC_DRAW);
+        memory.Track(rg::MemoryTracker::Kind::Buffer, PositionVBO, "Mesh positions", positions.size() * sizeof(glm::vec3));
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+
         glBindVertexArray(0);
     }
 };
@@ -12,6 +12,11 @@
 
 #include <learnopengl/mesh.h>
 #include <learnopengl/shader.h>
+#include <rg/Log.h>
+#include <rg/GLDebug.h>
+#include <rg/MemoryTracker.h>
+#include <rg/StartupTracer.h>
+#include <rg/TextureStreamer.h>
 
 #include <string>
 #include <fstream>
@@ -33,6 +38,8 @@ public:
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
+    // object space bounds of all meshes
+    rg::Aabb bounds;
 
     // constructor, expects a filepath to a 3D model.
     Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
@@ -47,15 +54,25 @@ public:
             meshes[i].Draw(shader);
     }
 
+    // draws the model without binding any textures (shadow and depth passes)
+    void DrawGeometry()
+    {
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].DrawGeometry();
+    }
+
     void SetShaderTextureNamePrefix(std::string prefix) {
         for (Mesh& mesh: meshes) {
-            mesh.glslIdentifierPrefix = prefix;
+            mesh.SetSamplerPrefix(prefix);
         }
     }
 private:
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
     void loadModel(string const &path)
     {
+        // meshes and textures created while loading are accounted to this model
+        rg::MemoryOwner owner(path);
+        STARTUP_SCOPE(path);
         // read file via ASSIMP
         Assimp::Importer importer;
         const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
@@ -82,6 +99,7 @@ private:
             // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
             aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
             meshes.push_back(processMesh(mesh, scene));
+            bounds.Expand(meshes.back().bounds);
         }
         // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
         for(unsigned int i = 0; i < node->mNumChildren; i++)
@@ -221,36 +239,22 @@ unsigned int TextureFromFile(const char *path, const string &directory, bool gam
 {
     string filename = string(path);
     filename = directory + '/' + filename;
+    STARTUP_SCOPE(filename);
 
     unsigned int textureID;
-    glGenTextures(1, &textureID);
 
     int width, height, nrComponents;
     unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
     if (data)
     {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
+        // only the small mip levels are uploaded now, the renderer streams in the rest as it needs them
+        textureID = rg::TextureStreamer::Instance().Create(filename, data, width, height, nrComponents);
         stbi_image_free(data);
     }
     else
     {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
+        LOG_ERROR(Assets, "Texture failed to load at path: %s", path);
+        glGenTextures(1, &textureID);
         stbi_image_free(data);
     }
 
@@ -8,24 +8,90 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <cstring>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <algorithm>
+#include <chrono>
 #include <common.h>
+#include <rg/ProgramCache.h>
+#include <rg/Log.h>
+#include <rg/GLDebug.h>
+#include <rg/StartupTracer.h>
+
+// A compile time feature a program can be specialised for. Every feature owns a bit range of the
+// permutation key and is injected into the sources as a #define: one bit features only when set
+// ("#define NAME"), wider features always ("#define NAME value").
+struct ShaderFeature {
+    const char* define;
+    unsigned int shift;
+    unsigned int bits;
+};
+
+namespace ShaderFeatures {
+    const ShaderFeature SPOTLIGHT_ON     = {"SPOTLIGHT_ON", 0, 1};
+    const ShaderFeature HAS_SPECULAR_MAP = {"HAS_SPECULAR_MAP", 1, 1};
+    const ShaderFeature HAS_NORMAL_MAP   = {"HAS_NORMAL_MAP", 2, 1};
+    const ShaderFeature NUM_POINT_LIGHTS = {"NUM_POINT_LIGHTS", 3, 3};
+    const ShaderFeature CARD_BACK        = {"CARD_BACK", 6, 1};
+    const ShaderFeature CARD_PAIR        = {"CARD_PAIR", 7, 3};
+    const ShaderFeature ALPHA_TEST       = {"ALPHA_TEST", 10, 1};
+    const ShaderFeature DEBUG_VIEW       = {"DEBUG_VIEW", 11, 2}; // DebugView of main.cpp, 0 shades normally
+
+    const ShaderFeature ALL[] = {
+            SPOTLIGHT_ON, HAS_SPECULAR_MAP, HAS_NORMAL_MAP, NUM_POINT_LIGHTS, CARD_BACK, CARD_PAIR, ALPHA_TEST,
+            DEBUG_VIEW
+    };
+}
+
+// A uniform block with a fixed binding point. GLSL 3.30 can't declare bindings, every permutation that declares
+// one of these blocks gets it assigned after linking.
+struct UniformBlock {
+    const char* name;
+    unsigned int binding;
+};
+
+namespace UniformBlocks {
+    // per-draw data from rg::DrawDataRing, "model" of the lighting and card shaders
+    const UniformBlock PER_DRAW = {"PerDraw", 0};
+
+    const UniformBlock ALL[] = {
+            PER_DRAW
+    };
+}
+
+// Name of a uniform as the setters take it. Literals are hashed in place instead of being copied into a
+// std::string on every call, so setting uniforms in the render loop doesn't touch the heap.
+struct UniformName {
+    const char* name;
+    uint64_t hash;
+
+    UniformName(const char* name) : name(name), hash(Hash(name)) {}
+    UniformName(const std::string& name) : name(name.c_str()), hash(Hash(name.c_str())) {}
+
+    // FNV-1a
+    static uint64_t Hash(const char* name)
+    {
+        uint64_t hash = 14695981039346656037ull;
+        for (; *name; name++)
+            hash = (hash ^ (unsigned char) *name) * 1099511628211ull;
+        return hash;
+    }
+};
+
 class Shader
 {
 public:
-    unsigned int ID;
-    // constructor generates the shader on the fly
+    // program of the active permutation
+    unsigned int ID = 0;
+    // constructor only loads the sources, permutations are compiled lazily the first time they are used
+    // or submitted up front through a ShaderBatch
     // ------------------------------------------------------------------------
     Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
     {
-        std::string vertexPathString(vertexPath);
-        std::string fragmentPathString(fragmentPath);
-
-        vertexPath = vertexPathString.c_str();
-        fragmentPath= fragmentPathString.c_str();
+        STARTUP_SCOPE(fragmentPath);
         // 1. retrieve the vertex/fragment source code from filePath
-        std::string vertexCode;
-        std::string fragmentCode;
-        std::string geometryCode;
         std::ifstream vShaderFile;
         std::ifstream fShaderFile;
         std::ifstream gShaderFile;
@@ -33,7 +99,7 @@ public:
         vShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
         fShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
         gShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        try 
+        try
         {
             // open files
             vShaderFile.open(vertexPath);
@@ -41,137 +107,387 @@ public:
             std::stringstream vShaderStream, fShaderStream;
             // read file's buffer contents into streams
             vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();		
+            fShaderStream << fShaderFile.rdbuf();
             // close file handlers
             vShaderFile.close();
             fShaderFile.close();
             // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();			
+            m_VertexCode = vShaderStream.str();
+            m_FragmentCode = fShaderStream.str();
             // if geometry shader path is present, also load a geometry shader
             if(geometryPath != nullptr)
             {
-                std::string geometryPathString(geometryPath);
-                geometryPath = geometryPathString.c_str();
                 gShaderFile.open(geometryPath);
                 std::stringstream gShaderStream;
                 gShaderStream << gShaderFile.rdbuf();
                 gShaderFile.close();
-                geometryCode = gShaderStream.str();
+                m_GeometryCode = gShaderStream.str();
             }
         }
         catch (std::ifstream::failure& e)
         {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+            LOG_ERROR(Shader, "File not successfully read: %s", vertexPath);
         }
-        const char* vShaderCode = vertexCode.c_str();
-        const char * fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
-        unsigned int vertex, fragment;
-        // vertex shader
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
-        // fragment Shader
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
-        // if geometry shader is given, compile geometry shader
-        unsigned int geometry;
-        if(geometryPath != nullptr)
-        {
-            const char * gShaderCode = geometryCode.c_str();
-            geometry = glCreateShader(GL_GEOMETRY_SHADER);
-            glShaderSource(geometry, 1, &gShaderCode, NULL);
-            glCompileShader(geometry);
-            checkCompileErrors(geometry, "GEOMETRY");
+        m_HasGeometry = geometryPath != nullptr;
+        m_Name = std::string(vertexPath) + "|" + fragmentPath + "|" + (geometryPath ? geometryPath : "");
+    }
+    ~Shader()
+    {
+        for (auto& variant : m_Variants) {
+            for (unsigned int stage : variant.second.stages)
+                glDeleteShader(stage);
+            glDeleteProgram(variant.second.program);
         }
-        // shader Program
-        ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        if(geometryPath != nullptr)
-            glAttachShader(ID, geometry);
-        glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
-        // delete the shaders as they're linked into our program now and no longer necessery
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
-        if(geometryPath != nullptr)
-            glDeleteShader(geometry);
-
+        if (current() == this)
+            current() = nullptr;
     }
+    Shader(const Shader&) = delete;
+    Shader& operator=(const Shader&) = delete;
+
     // activate the shader
     // ------------------------------------------------------------------------
-    void use() 
-    { 
-        glUseProgram(ID); 
+    void use()
+    {
+        current() = this;
+        activate();
+    }
+    // selects the permutation for the following draws, switches programs right away when the shader is in use
+    // ------------------------------------------------------------------------
+    void SetFeature(const ShaderFeature& feature, unsigned int value)
+    {
+        unsigned int key = WithFeature(m_Key, feature, value);
+        if (key == m_Key)
+            return;
+        m_Key = key;
+        if (current() == this)
+            activate();
+    }
+    // starts building a permutation in the background, see ShaderBatch
+    // ------------------------------------------------------------------------
+    void Submit(unsigned int key)
+    {
+        auto it = m_Variants.find(key);
+        if (it == m_Variants.end())
+            submit(m_Variants[key], key);
+    }
+    // finishes the permutations the driver is done with, true once none is pending.
+    // Without GL_KHR_parallel_shader_compile there is no way to ask, so one permutation is finished per call.
+    // ------------------------------------------------------------------------
+    bool Poll()
+    {
+        bool ready = true;
+        bool finishedBlocking = false;
+        for (auto& variant : m_Variants) {
+            if (!variant.second.pending)
+                continue;
+            if (completed(variant.second)) {
+                finish(variant.second);
+            } else if (!GLAD_GL_KHR_parallel_shader_compile && !finishedBlocking) {
+                finish(variant.second);
+                finishedBlocking = true;
+            } else {
+                ready = false;
+            }
+        }
+        return ready;
     }
+    static unsigned int WithFeature(unsigned int key, const ShaderFeature& feature, unsigned int value)
+    {
+        unsigned int mask = ((1u << feature.bits) - 1u) << feature.shift;
+        return (key & ~mask) | ((value << feature.shift) & mask);
+    }
+    unsigned int Key() const { return m_Key; }
+    // whether the active permutation declares the block, its members can't be set through the uniform setters
+    bool HasBlock(const UniformBlock& block) const
+    {
+        return m_Active && (m_Active->blocks & (1u << block.binding));
+    }
+    unsigned int VariantCount() const { return m_Variants.size(); }
+
     // utility uniform functions
+    // values are kept per shader and uploaded to every permutation the next time it gets activated
     // ------------------------------------------------------------------------
-    void setBool(const std::string &name, bool value) const
-    {         
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+    void setBool(const UniformName &name, bool value)
+    {
+        setInt(name, (int)value);
     }
     // ------------------------------------------------------------------------
-    void setInt(const std::string &name, int value) const
-    { 
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+    void setInt(const UniformName &name, int value)
+    {
+        UniformValue u(GL_INT);
+        u.i = value;
+        store(name, u);
     }
     // ------------------------------------------------------------------------
-    void setFloat(const std::string &name, float value) const
-    { 
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+    void setFloat(const UniformName &name, float value)
+    {
+        store(name, UniformValue(GL_FLOAT, &value, 1));
     }
     // ------------------------------------------------------------------------
-    void setVec2(const std::string &name, const glm::vec2 &value) const
-    { 
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+    void setVec2(const UniformName &name, const glm::vec2 &value)
+    {
+        store(name, UniformValue(GL_FLOAT_VEC2, &value[0], 2));
     }
-    void setVec2(const std::string &name, float x, float y) const
-    { 
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
+    void setVec2(const UniformName &name, float x, float y)
+    {
+        setVec2(name, glm::vec2(x, y));
     }
     // ------------------------------------------------------------------------
-    void setVec3(const std::string &name, const glm::vec3 &value) const
-    { 
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+    void setVec3(const UniformName &name, const glm::vec3 &value)
+    {
+        store(name, UniformValue(GL_FLOAT_VEC3, &value[0], 3));
     }
-    void setVec3(const std::string &name, float x, float y, float z) const
-    { 
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+    void setVec3(const UniformName &name, float x, float y, float z)
+    {
+        setVec3(name, glm::vec3(x, y, z));
     }
     // ------------------------------------------------------------------------
-    void setVec4(const std::string &name, const glm::vec4 &value) const
-    { 
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+    void setVec4(const UniformName &name, const glm::vec4 &value)
+    {
+        store(name, UniformValue(GL_FLOAT_VEC4, &value[0], 4));
     }
-    void setVec4(const std::string &name, float x, float y, float z, float w) 
-    { 
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
+    void setVec4(const UniformName &name, float x, float y, float z, float w)
+    {
+        setVec4(name, glm::vec4(x, y, z, w));
     }
     // ------------------------------------------------------------------------
-    void setMat2(const std::string &name, const glm::mat2 &mat) const
+    void setMat2(const UniformName &name, const glm::mat2 &mat)
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        store(name, UniformValue(GL_FLOAT_MAT2, &mat[0][0], 4));
     }
     // ------------------------------------------------------------------------
-    void setMat3(const std::string &name, const glm::mat3 &mat) const
+    void setMat3(const UniformName &name, const glm::mat3 &mat)
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        store(name, UniformValue(GL_FLOAT_MAT3, &mat[0][0], 9));
     }
     // ------------------------------------------------------------------------
-    void setMat4(const std::string &name, const glm::mat4 &mat) const
+    void setMat4(const UniformName &name, const glm::mat4 &mat)
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        store(name, UniformValue(GL_FLOAT_MAT4, &mat[0][0], 16));
     }
 
 private:
+    struct UniformValue {
+        GLenum type;
+        GLint i = 0;
+        float f[16];
+        // value of the shader's version counter when this uniform last changed
+        unsigned long version = 0;
+
+        explicit UniformValue(GLenum type) : type(type) {}
+        UniformValue(GLenum type, const float* values, unsigned int count) : type(type) {
+            std::memcpy(f, values, count * sizeof(float));
+        }
+        bool operator==(const UniformValue& other) const {
+            if (type != other.type)
+                return false;
+            switch (type) {
+                case GL_INT:        return i == other.i;
+                case GL_FLOAT:      return f[0] == other.f[0];
+                case GL_FLOAT_VEC2: return std::memcmp(f, other.f, 2 * sizeof(float)) == 0;
+                case GL_FLOAT_VEC3: return std::memcmp(f, other.f, 3 * sizeof(float)) == 0;
+                case GL_FLOAT_VEC4:
+                case GL_FLOAT_MAT2: return std::memcmp(f, other.f, 4 * sizeof(float)) == 0;
+                case GL_FLOAT_MAT3: return std::memcmp(f, other.f, 9 * sizeof(float)) == 0;
+                default:            return std::memcmp(f, other.f, 16 * sizeof(float)) == 0;
+            }
+        }
+    };
+    struct Uniform {
+        std::string name;
+        UniformValue value;
+    };
+    struct Variant {
+        unsigned int program = 0;
+        // compiled and linked, but the results haven't been checked yet
+        bool pending = false;
+        unsigned int stages[3] = {0, 0, 0};
+        std::string defines;
+        uint64_t cacheKey = 0;
+        // every uniform changed after this version still has to be uploaded to the program
+        unsigned long syncedVersion = 0;
+        // keyed by the hash of the uniform name
+        std::unordered_map<uint64_t, GLint> locations;
+        // bit per binding point of the UniformBlocks the program declares
+        unsigned int blocks = 0;
+    };
+
+    // makes the permutation of the current key the bound program, compiling it on first use
+    void activate()
+    {
+        Submit(m_Key);
+        m_Active = &m_Variants[m_Key];
+        if (m_Active->pending)
+            finish(*m_Active);
+        ID = m_Active->program;
+        glUseProgram(ID);
+        // upload only the uniforms that changed since this permutation was last active
+        if (m_Active->syncedVersion != m_Version) {
+            for (auto& uniform : m_Uniforms) {
+                if (uniform.second.value.version > m_Active->syncedVersion)
+                    upload(*m_Active, uniform.first, uniform.second.name.c_str(), uniform.second.value);
+            }
+            m_Active->syncedVersion = m_Version;
+        }
+    }
+
+    void store(const UniformName& name, const UniformValue& value)
+    {
+        auto it = m_Uniforms.find(name.hash);
+        if (it != m_Uniforms.end() && it->second.value == value)
+            return;
+        // the name is only copied the first time a uniform is set
+        if (it == m_Uniforms.end())
+            it = m_Uniforms.emplace(name.hash, Uniform{name.name, value}).first;
+        UniformValue& u = it->second.value;
+        u = value;
+        u.version = ++m_Version;
+        // the bound permutation is always fully synced, keep it that way
+        if (current() == this && m_Active) {
+            upload(*m_Active, name.hash, name.name, u);
+            m_Active->syncedVersion = m_Version;
+        }
+    }
+
+    static void upload(Variant& variant, uint64_t hash, const char* name, const UniformValue& u)
+    {
+        auto it = variant.locations.find(hash);
+        if (it == variant.locations.end())
+            it = variant.locations.emplace(hash, glGetUniformLocation(variant.program, name)).first;
+        GLint location = it->second;
+        if (location < 0)
+            return;
+        switch (u.type) {
+            case GL_INT:        glUniform1i(location, u.i); break;
+            case GL_FLOAT:      glUniform1f(location, u.f[0]); break;
+            case GL_FLOAT_VEC2: glUniform2fv(location, 1, u.f); break;
+            case GL_FLOAT_VEC3: glUniform3fv(location, 1, u.f); break;
+            case GL_FLOAT_VEC4: glUniform4fv(location, 1, u.f); break;
+            case GL_FLOAT_MAT2: glUniformMatrix2fv(location, 1, GL_FALSE, u.f); break;
+            case GL_FLOAT_MAT3: glUniformMatrix3fv(location, 1, GL_FALSE, u.f); break;
+            case GL_FLOAT_MAT4: glUniformMatrix4fv(location, 1, GL_FALSE, u.f); break;
+        }
+    }
+
+    static std::string definesFor(unsigned int key)
+    {
+        std::string defines;
+        for (const ShaderFeature& feature : ShaderFeatures::ALL) {
+            unsigned int value = (key >> feature.shift) & ((1u << feature.bits) - 1u);
+            if (feature.bits == 1) {
+                if (value)
+                    defines += std::string("#define ") + feature.define + "\n";
+            } else {
+                defines += std::string("#define ") + feature.define + " " + std::to_string(value) + "\n";
+            }
+        }
+        return defines;
+    }
+
+    // inserts the defines right after the #version line, #line keeps the compiler's line numbers intact
+    static std::string injectDefines(const std::string& source, const std::string& defines)
+    {
+        size_t version = source.find("#version");
+        if (version == std::string::npos)
+            return defines + source;
+        size_t versionEnd = source.find('\n', version);
+        if (versionEnd == std::string::npos)
+            return source + "\n" + defines;
+        unsigned int versionLine = 1;
+        for (size_t i = 0; i < versionEnd; i++)
+            versionLine += source[i] == '\n';
+        return source.substr(0, versionEnd + 1) + defines + "#line " + std::to_string(versionLine + 1) + "\n" +
+               source.substr(versionEnd + 1);
+    }
+
+    unsigned int compileStage(GLenum stage, const std::string& source, const std::string& defines)
+    {
+        std::string code = injectDefines(source, defines);
+        const char* shaderCode = code.c_str();
+        unsigned int shader = glCreateShader(stage);
+        glShaderSource(shader, 1, &shaderCode, NULL);
+        glCompileShader(shader);
+        return shader;
+    }
+
+    // submits compilation and linking of a permutation, nothing here waits for the driver
+    void submit(Variant& variant, unsigned int key)
+    {
+        variant.defines = definesFor(key);
+        // a cached binary skips GLSL compilation entirely
+        rg::ProgramCache& cache = rg::ProgramCache::Instance();
+        std::string slot = m_Name + "\n" + variant.defines;
+        variant.cacheKey = cache.Key(variant.defines + m_VertexCode + "\n--\n" + m_FragmentCode + "\n--\n" + m_GeometryCode);
+        variant.program = cache.Load(slot, variant.cacheKey);
+        if (variant.program) {
+            bindBlocks(variant);
+            return;
+        }
+        // 2. compile shaders
+        variant.stages[0] = compileStage(GL_VERTEX_SHADER, m_VertexCode, variant.defines);
+        variant.stages[1] = compileStage(GL_FRAGMENT_SHADER, m_FragmentCode, variant.defines);
+        // if geometry shader is given, compile geometry shader
+        if(m_HasGeometry)
+            variant.stages[2] = compileStage(GL_GEOMETRY_SHADER, m_GeometryCode, variant.defines);
+        // shader Program
+        variant.program = glCreateProgram();
+        for (unsigned int stage : variant.stages) {
+            if (stage)
+                glAttachShader(variant.program, stage);
+        }
+        cache.PrepareForStore(variant.program);
+        glLinkProgram(variant.program);
+        variant.pending = true;
+    }
+
+    // with GL_KHR_parallel_shader_compile the driver tells whether querying the results would block
+    static bool completed(const Variant& variant)
+    {
+        if (!GLAD_GL_KHR_parallel_shader_compile)
+            return false;
+        GLint done = GL_FALSE;
+        glGetProgramiv(variant.program, GL_COMPLETION_STATUS_KHR, &done);
+        return done == GL_TRUE;
+    }
+
+    // checks the results of a submitted permutation, blocks if the driver isn't done with it yet
+    void finish(Variant& variant)
+    {
+        rg::GLDebug::Label(GL_PROGRAM, variant.program, m_Name + (variant.defines.empty() ? "" : "\n" + variant.defines));
+        static const char* stageNames[3] = {"VERTEX", "FRAGMENT", "GEOMETRY"};
+        for (unsigned int i = 0; i < 3; i++) {
+            if (variant.stages[i])
+                checkCompileErrors(variant.stages[i], stageNames[i], variant.defines);
+        }
+        if (checkCompileErrors(variant.program, "PROGRAM", variant.defines)) {
+            rg::ProgramCache::Instance().Store(m_Name + "\n" + variant.defines, variant.cacheKey, variant.program);
+            bindBlocks(variant);
+        }
+        // delete the shaders as they're linked into our program now and no longer necessery
+        for (unsigned int& stage : variant.stages) {
+            if (stage)
+                glDeleteShader(stage);
+            stage = 0;
+        }
+        variant.pending = false;
+    }
+
+    // linking resets the block bindings, so does loading a binary
+    static void bindBlocks(Variant& variant)
+    {
+        variant.blocks = 0;
+        for (const UniformBlock& block : UniformBlocks::ALL) {
+            GLuint index = glGetUniformBlockIndex(variant.program, block.name);
+            if (index == GL_INVALID_INDEX)
+                continue;
+            glUniformBlockBinding(variant.program, index, block.binding);
+            variant.blocks |= 1u << block.binding;
+        }
+    }
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
-    void checkCompileErrors(GLuint shader, std::string type)
+    bool checkCompileErrors(GLuint shader, std::string type, const std::string& defines)
     {
         GLint success;
         GLchar infoLog[1024];
@@ -181,7 +497,7 @@ private:
             if(!success)
             {
                 glGetShaderInfoLog(shader, 1024, NULL, infoLog);
-                std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
+                LOG_ERROR(Shader, "Compilation error of type %s in %s\n%s%s", type.c_str(), m_Name.c_str(), defines.c_str(), infoLog);
             }
         }
         else
@@ -190,9 +506,73 @@ private:
             if(!success)
             {
                 glGetProgramInfoLog(shader, 1024, NULL, infoLog);
-                std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
+                LOG_ERROR(Shader, "Linking error in %s\n%s%s", m_Name.c_str(), defines.c_str(), infoLog);
             }
         }
+        return success;
+    }
+
+    std::string m_Name;
+    std::string m_VertexCode;
+    std::string m_FragmentCode;
+    std::string m_GeometryCode;
+    bool m_HasGeometry = false;
+    unsigned int m_Key = 0;
+    unsigned long m_Version = 0;
+    std::unordered_map<unsigned int, Variant> m_Variants;
+    // keyed by the hash of the uniform name
+    std::unordered_map<uint64_t, Uniform> m_Uniforms;
+    Variant* m_Active = nullptr;
+
+    // the shader whose permutation is currently bound
+    static Shader*& current()
+    {
+        static Shader* shader = nullptr;
+        return shader;
+    }
+};
+
+// Builds a set of shader permutations together. All compiles and links are submitted up front, so a driver
+// with GL_KHR_parallel_shader_compile can spread them over its compiler threads, and completion is polled
+// from the render loop instead of waiting on every program in turn.
+class ShaderBatch
+{
+public:
+    ShaderBatch() : m_Start(std::chrono::steady_clock::now())
+    {
+        // let the driver use as many compiler threads as it likes
+        if (GLAD_GL_KHR_parallel_shader_compile)
+            glMaxShaderCompilerThreadsKHR(0xFFFFFFFFu);
+    }
+
+    void Add(Shader& shader, unsigned int key = 0)
+    {
+        shader.Submit(key);
+        if (std::find(m_Shaders.begin(), m_Shaders.end(), &shader) == m_Shaders.end())
+            m_Shaders.push_back(&shader);
+        m_Ready = false;
+    }
+    // true once every submitted permutation is ready to be used
+    bool Poll()
+    {
+        if (m_Ready)
+            return true;
+        bool ready = true;
+        for (Shader* shader : m_Shaders)
+            ready = shader->Poll() && ready;
+        if (ready) {
+            m_Ready = true;
+            m_SetupMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - m_Start).count();
+        }
+        return m_Ready;
     }
+    // time from creating the batch until the last permutation was ready
+    float SetupMilliseconds() const { return m_SetupMs; }
+
+private:
+    std::vector<Shader*> m_Shaders;
+    std::chrono::steady_clock::time_point m_Start;
+    float m_SetupMs = 0.0f;
+    bool m_Ready = false;
 };
 #endif
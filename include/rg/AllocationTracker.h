@@ -0,0 +1,248 @@
+#ifndef PROJECT_BASE_ALLOCATIONTRACKER_H
+#define PROJECT_BASE_ALLOCATIONTRACKER_H
+
+#include "imgui.h"
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <ostream>
+
+namespace rg {
+
+// Counts heap allocations made through operator new, per thread and per frame.
+// Exactly one translation unit defines ALLOCATION_TRACKER_IMPLEMENTATION before including this header, that
+// replaces the global operator new/delete with versions that report here. Every thread gets a counter slot the
+// first time it allocates. The render loop brackets its frames with BeginFrame/EndFrame, after the warm-up frames
+// the steady state loop is expected not to allocate at all: strict mode reports the first allocation that breaks
+// this and aborts right there, so a debugger or core dump shows the call stack that allocated.
+// ImGui allocates through malloc and isn't counted, neither are drivers and C libraries.
+class AllocationTracker {
+public:
+    static const unsigned int MAX_THREADS = 32;
+
+    static AllocationTracker& Instance() {
+        static AllocationTracker tracker;
+        return tracker;
+    }
+    AllocationTracker(const AllocationTracker&) = delete;
+    AllocationTracker& operator=(const AllocationTracker&) = delete;
+
+    // called by operator new, must not allocate
+    static void Record(size_t bytes) {
+        Slot& slot = slots()[threadSlot()];
+        slot.allocations.fetch_add(1, std::memory_order_relaxed);
+        slot.bytes.fetch_add(bytes, std::memory_order_relaxed);
+        if (armed()) {
+            // disarmed first, reporting must not end up here again
+            armed() = false;
+            AllocationTracker& tracker = Instance();
+            tracker.m_Violations.fetch_add(1, std::memory_order_relaxed);
+            if (tracker.m_Strict) {
+                // straight to stderr, the logger's thread wouldn't get to print anything
+                std::fprintf(stderr, "Heap allocation of %zu bytes in the steady state render loop (frame %u)\n",
+                             bytes, tracker.m_Frame);
+                std::abort();
+            }
+        }
+    }
+    // shown in the window instead of the slot number
+    static void NameThread(const char* name) {
+        slots()[threadSlot()].name.store(name, std::memory_order_relaxed);
+    }
+
+    // frames before this count as warm-up, in strict mode the first allocation of the render thread after them aborts
+    void SetWarmup(unsigned int frames) { m_WarmupFrames = frames; }
+    void SetStrict(bool strict) { m_Strict = strict; }
+    bool Strict() const { return m_Strict; }
+
+    // bracket one frame of the render loop, both on the render thread
+    void BeginFrame() {
+        m_Thread = threadSlot();
+        for (unsigned int i = 0; i < MAX_THREADS; i++)
+            m_Start[i] = slots()[i].allocations.load(std::memory_order_relaxed);
+        m_StartBytes = slots()[m_Thread].bytes.load(std::memory_order_relaxed);
+        armed() = SteadyState();
+    }
+    void EndFrame() {
+        armed() = false;
+        for (unsigned int i = 0; i < MAX_THREADS; i++)
+            m_Last[i] = slots()[i].allocations.load(std::memory_order_relaxed) - m_Start[i];
+        unsigned int self = m_Thread;
+        m_LastBytes = slots()[self].bytes.load(std::memory_order_relaxed) - m_StartBytes;
+        if (SteadyState()) {
+            m_SteadyFrames++;
+            m_SteadyAllocations += m_Last[self];
+            m_SteadyMax = m_Last[self] > m_SteadyMax ? m_Last[self] : m_SteadyMax;
+            m_FramesWithAllocations += m_Last[self] != 0;
+        }
+        m_Frame++;
+        std::lock_guard<std::mutex> lock(m_ShownMutex);
+        for (unsigned int i = 0; i < MAX_THREADS; i++)
+            m_Shown.last[i] = m_Last[i];
+        m_Shown.lastBytes = m_LastBytes;
+        m_Shown.thread = m_Thread;
+        m_Shown.steadyFrames = m_SteadyFrames;
+        m_Shown.steadyMax = m_SteadyMax;
+        m_Shown.framesWithAllocations = m_FramesWithAllocations;
+        m_Shown.steadyState = SteadyState();
+    }
+    bool SteadyState() const { return m_Frame >= m_WarmupFrames; }
+
+    // allocations of the render thread during the last frame, render thread only
+    uint64_t FrameAllocations() const { return m_Last[m_Thread]; }
+    uint64_t FrameBytes() const { return m_LastBytes; }
+    uint64_t Violations() const { return m_Violations.load(std::memory_order_relaxed); }
+
+    // shows the counts of the last EndFrame(), from any thread
+    void DrawWindow() {
+        {
+            std::lock_guard<std::mutex> lock(m_ShownMutex);
+            m_Drawn = m_Shown;
+        }
+        const Shown& shown = m_Drawn;
+        ImGui::Text("Render thread: %llu allocations, %llu bytes last frame",
+                    (unsigned long long) shown.last[shown.thread], (unsigned long long) shown.lastBytes);
+        ImGui::Text("Steady state: %llu of %llu frames allocated, max %llu per frame%s",
+                    (unsigned long long) shown.framesWithAllocations, (unsigned long long) shown.steadyFrames,
+                    (unsigned long long) shown.steadyMax, shown.steadyState ? "" : " (warming up)");
+        ImGui::Columns(3, "allocationThreads");
+        ImGui::Text("Thread");
+        ImGui::NextColumn();
+        ImGui::Text("Last frame");
+        ImGui::NextColumn();
+        ImGui::Text("Total");
+        ImGui::NextColumn();
+        ImGui::Separator();
+        for (unsigned int i = 0; i < MAX_THREADS; i++) {
+            uint64_t total = slots()[i].allocations.load(std::memory_order_relaxed);
+            if (!total)
+                continue;
+            const char* name = slots()[i].name.load(std::memory_order_relaxed);
+            if (name)
+                ImGui::Text("%s", name);
+            else
+                ImGui::Text("thread %u%s", i, i == MAX_THREADS - 1 ? "+" : "");
+            ImGui::NextColumn();
+            ImGui::Text("%llu", (unsigned long long) shown.last[i]);
+            ImGui::NextColumn();
+            ImGui::Text("%llu", (unsigned long long) total);
+            ImGui::NextColumn();
+        }
+        ImGui::Columns(1);
+    }
+
+    // steady state allocations of the render thread, part of the benchmark results
+    void WriteJson(std::ostream& out) const {
+        char buffer[256];
+        std::snprintf(buffer, sizeof(buffer),
+                      "{\"warmupFrames\": %u, \"frames\": %llu, \"framesWithAllocations\": %llu, \"mean\": %.3f, "
+                      "\"max\": %llu, \"violations\": %llu}",
+                      m_WarmupFrames, (unsigned long long) m_SteadyFrames, (unsigned long long) m_FramesWithAllocations,
+                      m_SteadyFrames ? (double) m_SteadyAllocations / m_SteadyFrames : 0.0,
+                      (unsigned long long) m_SteadyMax, (unsigned long long) Violations());
+        out << buffer;
+    }
+
+private:
+    // what DrawWindow() shows
+    struct Shown {
+        uint64_t last[MAX_THREADS] = {};
+        uint64_t lastBytes = 0;
+        unsigned int thread = 0;
+        uint64_t steadyFrames = 0;
+        uint64_t steadyMax = 0;
+        uint64_t framesWithAllocations = 0;
+        bool steadyState = false;
+    };
+    struct Slot {
+        std::atomic<uint64_t> allocations{0};
+        std::atomic<uint64_t> bytes{0};
+        std::atomic<const char*> name{nullptr};
+    };
+
+    AllocationTracker() = default;
+
+    // constant initialised, usable from operator new before main and after static destruction started
+    static Slot* slots() {
+        static Slot slots[MAX_THREADS];
+        return slots;
+    }
+    // threads past the last slot share it
+    static unsigned int threadSlot() {
+        static std::atomic<unsigned int> next{0};
+        thread_local unsigned int slot = MAX_THREADS;
+        if (slot == MAX_THREADS) {
+            unsigned int claimed = next.fetch_add(1, std::memory_order_relaxed);
+            slot = claimed < MAX_THREADS - 1 ? claimed : MAX_THREADS - 1;
+        }
+        return slot;
+    }
+    // set on the render thread between BeginFrame and EndFrame of steady state frames
+    static bool& armed() {
+        thread_local bool armed = false;
+        return armed;
+    }
+
+    unsigned int m_WarmupFrames = 60;
+    bool m_Strict = false;
+    unsigned int m_Frame = 0;
+    unsigned int m_Thread = 0; // slot of the thread calling BeginFrame
+    uint64_t m_Start[MAX_THREADS] = {};
+    uint64_t m_Last[MAX_THREADS] = {};
+    uint64_t m_StartBytes = 0;
+    uint64_t m_LastBytes = 0;
+    uint64_t m_SteadyFrames = 0;
+    uint64_t m_SteadyAllocations = 0;
+    uint64_t m_SteadyMax = 0;
+    uint64_t m_FramesWithAllocations = 0;
+    std::atomic<uint64_t> m_Violations{0};
+    std::mutex m_ShownMutex;
+    Shown m_Shown;
+    Shown m_Drawn; // the drawing thread's copy of m_Shown
+};
+
+};
+
+#ifdef ALLOCATION_TRACKER_IMPLEMENTATION
+
+void* operator new(size_t size) {
+    rg::AllocationTracker::Record(size);
+    if (void* memory = std::malloc(size ? size : 1))
+        return memory;
+    throw std::bad_alloc();
+}
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    rg::AllocationTracker::Record(size);
+    return std::malloc(size ? size : 1);
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return operator new(size, std::nothrow);
+}
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+void operator delete[](void* memory) noexcept {
+    std::free(memory);
+}
+void operator delete(void* memory, size_t) noexcept {
+    std::free(memory);
+}
+void operator delete[](void* memory, size_t) noexcept {
+    std::free(memory);
+}
+void operator delete(void* memory, const std::nothrow_t&) noexcept {
+    std::free(memory);
+}
+void operator delete[](void* memory, const std::nothrow_t&) noexcept {
+    std::free(memory);
+}
+
+#endif
+
+#endif //PROJECT_BASE_ALLOCATIONTRACKER_H
@@ -0,0 +1,42 @@
+#ifndef PROJECT_BASE_BOUNDS_H
+#define PROJECT_BASE_BOUNDS_H
+
+#include <glm/glm.hpp>
+#include <limits>
+
+namespace rg {
+
+// axis aligned bounding box
+struct Aabb {
+    glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+
+    void Expand(const glm::vec3& point) {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+    void Expand(const Aabb& other) {
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+    }
+    bool Empty() const {
+        return min.x > max.x;
+    }
+};
+
+// transforms all eight corners of the box and returns the box around them
+inline Aabb transformAabb(const Aabb& box, const glm::mat4& transform) {
+    Aabb result;
+    for (int i = 0; i < 8; i++) {
+        glm::vec3 corner((i & 1) ? box.max.x : box.min.x,
+                         (i & 2) ? box.max.y : box.min.y,
+                         (i & 4) ? box.max.z : box.min.z);
+        glm::vec4 p = transform * glm::vec4(corner, 1.0f);
+        result.Expand(glm::vec3(p) / p.w);
+    }
+    return result;
+}
+
+};
+
+#endif //PROJECT_BASE_BOUNDS_H
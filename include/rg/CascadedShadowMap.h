@@ -0,0 +1,251 @@
+#ifndef PROJECT_BASE_CASCADEDSHADOWMAP_H
+#define PROJECT_BASE_CASCADEDSHADOWMAP_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <learnopengl/shader.h>
+#include <rg/Bounds.h>
+#include <rg/GpuTimer.h>
+#include <rg/Log.h>
+#include <rg/GLDebug.h>
+#include <rg/MemoryTracker.h>
+#include <chrono>
+#include <cmath>
+
+namespace rg {
+
+// Cascaded shadow maps for a directional light.
+// The view frustum up to the shadow distance is split into slices, every slice gets its own layer of a depth
+// texture array. Each cascade is fitted to the bounding sphere of its slice and its origin is snapped to whole
+// shadow map texels, so the shadows don't shimmer when the camera moves or turns.
+// The first cascade is rendered every frame. Distant cascades are fitted with some slack, they are only
+// re-fitted once the camera moved far enough and otherwise re-rendered at a lower frequency (every 2^i frames).
+class CascadedShadowMap {
+public:
+    static const int MAX_CASCADES = 4;
+
+    struct CascadeStats {
+        unsigned int drawCalls = 0;
+        float cpuMs = 0.0f;
+        float gpuMs = 0.0f;
+        bool updated = false;
+    };
+
+    CascadedShadowMap(int cascadeCount = 3, unsigned int resolution = 2048, float shadowDistance = 40.0f)
+            : m_ShadowDistance(shadowDistance) {
+        glGenFramebuffers(1, &m_Fbo);
+        Configure(cascadeCount, resolution);
+    }
+    ~CascadedShadowMap() {
+        MemoryTracker::Instance().Untrack(MemoryTracker::Kind::Texture, m_DepthArray);
+        glDeleteFramebuffers(1, &m_Fbo);
+        glDeleteTextures(1, &m_DepthArray);
+    }
+    CascadedShadowMap(const CascadedShadowMap&) = delete;
+    CascadedShadowMap& operator=(const CascadedShadowMap&) = delete;
+
+    // (re)allocates the depth texture array when the cascade count or resolution changed
+    void Configure(int cascadeCount, unsigned int resolution) {
+        if (cascadeCount < 1)
+            cascadeCount = 1;
+        if (cascadeCount > MAX_CASCADES)
+            cascadeCount = MAX_CASCADES;
+        if (m_DepthArray != 0 && cascadeCount == m_CascadeCount && resolution == m_Resolution)
+            return;
+        m_CascadeCount = cascadeCount;
+        m_Resolution = resolution;
+
+        MemoryTracker::Instance().Untrack(MemoryTracker::Kind::Texture, m_DepthArray);
+        glDeleteTextures(1, &m_DepthArray);
+        glGenTextures(1, &m_DepthArray);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, m_DepthArray);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, resolution, resolution, cascadeCount, 0,
+                     GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+        GLDebug::Label(GL_TEXTURE, m_DepthArray, "Cascaded shadow depth");
+        MemoryTracker::Instance().Track(MemoryTracker::Kind::Texture, m_DepthArray, "Cascaded shadow depth",
+                                        MemoryTracker::TextureBytes(GL_DEPTH_COMPONENT24, resolution, resolution, cascadeCount),
+                                        "Cascaded shadows");
+        // hardware depth comparison, linear filtering gives 2x2 PCF for free
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+        const float borderColor[] = {1.0f, 1.0f, 1.0f, 1.0f};
+        glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, borderColor);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, m_Fbo);
+        GLDebug::Label(GL_FRAMEBUFFER, m_Fbo, "Cascaded shadow FBO");
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_DepthArray, 0, 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            LOG_ERROR(Render, "Cascaded shadow framebuffer not complete!");
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        for (int i = 0; i < MAX_CASCADES; i++)
+            m_Cascades[i].valid = false;
+    }
+
+    // splits the camera frustum, re-fits the cascades that need it and decides which ones get rendered this frame
+    void Update(const glm::mat4& view, float fovY, float aspect, float nearPlane, const glm::vec3& lightDirection) {
+        glm::vec3 lightDir = glm::normalize(lightDirection);
+        bool lightMoved = lightDir != m_LightDir;
+        m_LightDir = lightDir;
+
+        // practical split scheme, blend of logarithmic and uniform splits
+        const float lambda = 0.75f;
+        float farPlane = m_ShadowDistance;
+        glm::mat4 inverseView = glm::inverse(view);
+        float tanHalfFov = std::tan(fovY * 0.5f);
+        float sliceNear = nearPlane;
+        for (int i = 0; i < m_CascadeCount; i++) {
+            float p = (i + 1) / (float) m_CascadeCount;
+            float logSplit = nearPlane * std::pow(farPlane / nearPlane, p);
+            float uniformSplit = nearPlane + (farPlane - nearPlane) * p;
+            float sliceFar = lambda * logSplit + (1.0f - lambda) * uniformSplit;
+            m_Splits[i] = sliceFar;
+
+            // bounding sphere of the slice, its radius doesn't change when the camera turns
+            glm::vec3 corners[8];
+            glm::vec3 center(0.0f);
+            for (int c = 0; c < 8; c++) {
+                float z = (c & 4) ? sliceFar : sliceNear;
+                float x = ((c & 1) ? 1.0f : -1.0f) * z * tanHalfFov * aspect;
+                float y = ((c & 2) ? 1.0f : -1.0f) * z * tanHalfFov;
+                corners[c] = glm::vec3(inverseView * glm::vec4(x, y, -z, 1.0f));
+                center += corners[c];
+            }
+            center /= 8.0f;
+            float radius = 0.0f;
+            for (int c = 0; c < 8; c++)
+                radius = glm::max(radius, glm::length(corners[c] - center));
+            radius = std::ceil(radius * 16.0f) / 16.0f;
+
+            Cascade& cascade = m_Cascades[i];
+            float slack = i == 0 ? 0.0f : m_CacheSlack;
+            cascade.framesSinceRender++;
+            bool refit = !cascade.valid || lightMoved || glm::length(center - cascade.center) > radius * slack;
+            if (refit)
+                fit(cascade, center, radius * (1.0f + slack));
+            cascade.needsRender = refit || cascade.framesSinceRender >= (1u << i);
+            m_Stats[i].updated = false;
+            m_Stats[i].drawCalls = 0;
+            sliceNear = sliceFar;
+        }
+    }
+
+    int CascadeCount() const { return m_CascadeCount; }
+    unsigned int Resolution() const { return m_Resolution; }
+    bool NeedsRender(int cascade) const { return m_Cascades[cascade].needsRender; }
+    const CascadeStats& Stats(int cascade) const { return m_Stats[cascade]; }
+
+    // true when a caster with the given world space bounds can throw a shadow into the cascade
+    bool Intersects(int cascade, const Aabb& worldBounds) const {
+        Aabb box = transformAabb(worldBounds, m_Cascades[cascade].lightSpace);
+        // casters in front of the near plane are kept, depth clamping flattens them onto it
+        return box.max.x >= -1.0f && box.min.x <= 1.0f &&
+               box.max.y >= -1.0f && box.min.y <= 1.0f &&
+               box.min.z <= 1.0f;
+    }
+
+    void BeginCascade(int cascade, Shader& depthShader) {
+        m_CpuStart = std::chrono::steady_clock::now();
+        m_GpuTimers[cascade].Begin();
+        glGetIntegerv(GL_VIEWPORT, m_SavedViewport);
+        glBindFramebuffer(GL_FRAMEBUFFER, m_Fbo);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_DepthArray, 0, cascade);
+        glViewport(0, 0, m_Resolution, m_Resolution);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        glEnable(GL_DEPTH_CLAMP);
+        glEnable(GL_POLYGON_OFFSET_FILL);
+        glPolygonOffset(2.0f, 4.0f);
+        depthShader.use();
+        depthShader.setMat4("lightSpaceMatrix", m_Cascades[cascade].lightSpace);
+    }
+    void EndCascade(int cascade, unsigned int drawCalls) {
+        glDisable(GL_POLYGON_OFFSET_FILL);
+        glDisable(GL_DEPTH_CLAMP);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(m_SavedViewport[0], m_SavedViewport[1], m_SavedViewport[2], m_SavedViewport[3]);
+        m_GpuTimers[cascade].End();
+
+        Cascade& c = m_Cascades[cascade];
+        c.needsRender = false;
+        c.framesSinceRender = 0;
+        CascadeStats& stats = m_Stats[cascade];
+        stats.updated = true;
+        stats.drawCalls = drawCalls;
+        stats.cpuMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - m_CpuStart).count();
+        stats.gpuMs = m_GpuTimers[cascade].Milliseconds();
+    }
+
+    void Bind(unsigned int unit) const {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, m_DepthArray);
+        glActiveTexture(GL_TEXTURE0);
+    }
+    // uploads the matrices each cascade was last rendered with, so cached cascades stay consistent
+    void SetUniforms(Shader& shader) const {
+        static const char* lightSpaceNames[MAX_CASCADES] = {
+                "cascadeLightSpace[0]", "cascadeLightSpace[1]", "cascadeLightSpace[2]", "cascadeLightSpace[3]"
+        };
+        static const char* splitNames[MAX_CASCADES] = {
+                "cascadeSplits[0]", "cascadeSplits[1]", "cascadeSplits[2]", "cascadeSplits[3]"
+        };
+        shader.setInt("cascadeCount", m_CascadeCount);
+        for (int i = 0; i < m_CascadeCount; i++) {
+            shader.setMat4(lightSpaceNames[i], m_Cascades[i].lightSpace);
+            shader.setFloat(splitNames[i], m_Splits[i]);
+        }
+    }
+
+private:
+    struct Cascade {
+        glm::mat4 lightSpace = glm::mat4(1.0f);
+        glm::vec3 center = glm::vec3(0.0f);
+        unsigned int framesSinceRender = 0;
+        bool valid = false;
+        bool needsRender = true;
+    };
+
+    void fit(Cascade& cascade, const glm::vec3& center, float radius) {
+        glm::vec3 up = std::abs(m_LightDir.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+        glm::mat4 lightView = glm::lookAt(center - m_LightDir * radius, center, up);
+        glm::mat4 lightProjection = glm::ortho(-radius, radius, -radius, radius, 0.0f, 2.0f * radius);
+
+        // snap the projected world origin to a whole texel, the cascade then only moves in texel sized steps
+        glm::mat4 lightSpace = lightProjection * lightView;
+        float halfResolution = m_Resolution * 0.5f;
+        glm::vec4 origin = lightSpace * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        origin *= halfResolution;
+        glm::vec4 offset = (glm::round(origin) - origin) / halfResolution;
+        lightProjection[3][0] += offset.x;
+        lightProjection[3][1] += offset.y;
+
+        cascade.lightSpace = lightProjection * lightView;
+        cascade.center = center;
+        cascade.valid = true;
+    }
+
+    float m_ShadowDistance;
+    // fraction of the slice radius the distant cascades are padded with before they have to be re-fitted
+    float m_CacheSlack = 0.25f;
+    int m_CascadeCount = 0;
+    unsigned int m_Resolution = 0;
+    unsigned int m_Fbo = 0;
+    unsigned int m_DepthArray = 0;
+    glm::vec3 m_LightDir = glm::vec3(0.0f);
+    float m_Splits[MAX_CASCADES] = {0.0f};
+    Cascade m_Cascades[MAX_CASCADES];
+    CascadeStats m_Stats[MAX_CASCADES];
+    GpuTimer m_GpuTimers[MAX_CASCADES];
+    GLint m_SavedViewport[4] = {0, 0, 0, 0};
+    std::chrono::steady_clock::time_point m_CpuStart;
+};
+
+};
+
+#endif //PROJECT_BASE_CASCADEDSHADOWMAP_H
@@ -0,0 +1,169 @@
+#ifndef PROJECT_BASE_COMMANDBUFFER_H
+#define PROJECT_BASE_COMMANDBUFFER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <learnopengl/mesh.h>
+#include <learnopengl/shader.h>
+#include <rg/DrawDataRing.h>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace rg {
+
+// One recorded step of a pass, plain data: recording only reads the scene, it never touches GL or a shader.
+struct RenderCommand {
+    enum class Type : uint8_t {
+        BindProgram,  // shader.use()
+        BindMaterial, // permutation and textures of mesh
+        BindAlphaTest, // alpha test permutation and diffuse texture of mesh, for depth-only passes
+        SetModel,     // "model" of the bound program, first is the index of the matrix
+        SetInt,       // int uniform of the bound program, first is the value
+        DrawElements, // indexed triangles of vao, count indices
+        DrawArrays    // triangles of vao, count vertices starting at first
+    };
+    Type type;
+    unsigned int vao;
+    unsigned int first;
+    unsigned int count;
+    union {
+        Shader* shader;
+        const Mesh* mesh;
+        const UniformName* uniform;
+    };
+};
+
+// Commands of one pass or one range of objects. Deciding what to draw (culling, matrices, material lookups) can be
+// recorded on any thread, one buffer per thread or job; only Submit() has to run on the GL thread, where it replays
+// the commands in a tight loop. Clear() keeps the storage, buffers that are reused every frame stop allocating once
+// they reached their largest size.
+class CommandBuffer {
+public:
+    void Clear() {
+        m_Commands.clear();
+        m_Matrices.clear();
+        m_Draws = 0;
+    }
+
+    void BindProgram(Shader& shader) {
+        RenderCommand& command = push(RenderCommand::Type::BindProgram);
+        command.shader = &shader;
+    }
+    void BindMaterial(const Mesh& mesh) {
+        RenderCommand& command = push(RenderCommand::Type::BindMaterial);
+        command.mesh = &mesh;
+    }
+    void BindAlphaTest(const Mesh& mesh) {
+        RenderCommand& command = push(RenderCommand::Type::BindAlphaTest);
+        command.mesh = &mesh;
+    }
+    void SetModel(const glm::mat4& model) {
+        RenderCommand& command = push(RenderCommand::Type::SetModel);
+        command.first = (unsigned int) m_Matrices.size();
+        m_Matrices.push_back(model);
+    }
+    // the name has to outlive the buffer, a static UniformName
+    void SetInt(const UniformName& uniform, int value) {
+        RenderCommand& command = push(RenderCommand::Type::SetInt);
+        command.uniform = &uniform;
+        command.first = (unsigned int) value;
+    }
+    void DrawMesh(const Mesh& mesh) {
+        RenderCommand& command = push(RenderCommand::Type::DrawElements);
+        command.vao = mesh.VAO;
+        command.count = (unsigned int) mesh.indices.size();
+        m_Draws++;
+    }
+    // only what a depth-only pass reads: positions, plus texture coordinates for alpha tested meshes
+    void DrawMeshPositions(const Mesh& mesh) {
+        RenderCommand& command = push(RenderCommand::Type::DrawElements);
+        command.vao = mesh.alphaTested ? mesh.VAO : mesh.PositionVAO;
+        command.count = (unsigned int) mesh.indices.size();
+        m_Draws++;
+    }
+    void DrawArrays(unsigned int vao, unsigned int first, unsigned int count) {
+        RenderCommand& command = push(RenderCommand::Type::DrawArrays);
+        command.vao = vao;
+        command.first = first;
+        command.count = count;
+        m_Draws++;
+    }
+
+    size_t Size() const { return m_Commands.size(); }
+    unsigned int DrawCount() const { return m_Draws; }
+
+    // GL thread, the buffer has to bind its program before it sets uniforms or materials. With a ring, all matrices
+    // are written to it in one go and programs with a PerDraw block get theirs bound by range instead of a uniform.
+    void Submit(DrawDataRing* drawData = nullptr) const {
+        static const UniformName modelName("model");
+        size_t stride = 0, matrices = 0;
+        if (drawData && !m_Matrices.empty()) {
+            stride = drawData->Stride(sizeof(glm::mat4));
+            matrices = drawData->Allocate(stride * m_Matrices.size());
+            char* out = (char*) drawData->Pointer(matrices);
+            for (size_t i = 0; i < m_Matrices.size(); i++)
+                std::memcpy(out + i * stride, &m_Matrices[i], sizeof(glm::mat4));
+            drawData->Commit();
+        }
+        Shader* shader = nullptr;
+        bool perDraw = false;
+        unsigned int vao = 0;
+        for (const RenderCommand& command : m_Commands) {
+            switch (command.type) {
+                case RenderCommand::Type::BindProgram:
+                    shader = command.shader;
+                    shader->use();
+                    perDraw = stride && shader->HasBlock(UniformBlocks::PER_DRAW);
+                    break;
+                case RenderCommand::Type::BindMaterial:
+                    command.mesh->BindMaterial(*shader);
+                    break;
+                case RenderCommand::Type::BindAlphaTest:
+                    command.mesh->BindAlphaTest(*shader);
+                    break;
+                case RenderCommand::Type::SetModel:
+                    if (perDraw)
+                        drawData->Bind(UniformBlocks::PER_DRAW.binding, matrices + command.first * stride,
+                                       sizeof(glm::mat4));
+                    else
+                        shader->setMat4(modelName, m_Matrices[command.first]);
+                    break;
+                case RenderCommand::Type::SetInt:
+                    shader->setInt(*command.uniform, (int) command.first);
+                    break;
+                case RenderCommand::Type::DrawElements:
+                    if (command.vao != vao)
+                        glBindVertexArray(vao = command.vao);
+                    glDrawElements(GL_TRIANGLES, command.count, GL_UNSIGNED_INT, 0);
+                    break;
+                case RenderCommand::Type::DrawArrays:
+                    if (command.vao != vao)
+                        glBindVertexArray(vao = command.vao);
+                    glDrawArrays(GL_TRIANGLES, command.first, command.count);
+                    break;
+            }
+        }
+        // the last VAO and texture unit stay bound, like after Mesh::Draw: whoever draws next binds what it uses
+    }
+
+private:
+    RenderCommand& push(RenderCommand::Type type) {
+        m_Commands.emplace_back();
+        RenderCommand& command = m_Commands.back();
+        command.type = type;
+        command.vao = 0;
+        command.first = 0;
+        command.count = 0;
+        command.shader = nullptr;
+        return command;
+    }
+
+    std::vector<RenderCommand> m_Commands;
+    std::vector<glm::mat4> m_Matrices;
+    unsigned int m_Draws = 0;
+};
+
+};
+
+#endif //PROJECT_BASE_COMMANDBUFFER_H
@@ -0,0 +1,178 @@
+#ifndef PROJECT_BASE_DRAWDATARING_H
+#define PROJECT_BASE_DRAWDATARING_H
+
+#include <glad/glad.h>
+#include <rg/GLDebug.h>
+#include <rg/Log.h>
+#include <rg/MemoryTracker.h>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+namespace rg {
+
+// Uniform buffer for the data that changes with every draw (model matrices ...). The CPU writes all of a frame's
+// per-draw data into it once and every draw only binds its slice with glBindBufferRange, instead of going through
+// a glUniform call per value.
+// With GL_ARB_buffer_storage the buffer holds one region per frame in flight and stays persistently mapped, writes
+// go straight to the memory the GPU reads. A fence per region makes sure the CPU only overwrites a region once the
+// frame that used it is done. On plain 3.3 the data is staged on the CPU and uploaded with glBufferSubData into a
+// buffer that is orphaned at the start of every frame.
+// A frame that needs more than a region grows the buffer right away, the draws already submitted keep the old one,
+// so a block has to be bound before the next Allocate(): allocate what a batch of draws needs at once.
+// GL thread only.
+class DrawDataRing {
+public:
+    static const unsigned int FRAMES = 3;
+
+    explicit DrawDataRing(size_t frameBytes = 256 * 1024, bool allowPersistent = true) {
+        GLint alignment = 0;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        m_Alignment = alignment > 0 ? alignment : 256;
+        m_Persistent = allowPersistent && GLAD_GL_ARB_buffer_storage;
+        create(frameBytes);
+    }
+    ~DrawDataRing() {
+        destroy();
+    }
+    DrawDataRing(const DrawDataRing&) = delete;
+    DrawDataRing& operator=(const DrawDataRing&) = delete;
+
+    // waits until the GPU is done with the region of this frame, the fallback orphans the buffer instead
+    void BeginFrame() {
+        m_Region = (m_Region + 1) % FRAMES;
+        m_Used = 0;
+        m_Committed = 0;
+        if (m_Persistent) {
+            GLsync& fence = m_Fences[m_Region];
+            if (fence) {
+                GLenum result = glClientWaitSync(fence, 0, 0);
+                if (result == GL_TIMEOUT_EXPIRED) {
+                    m_Stalls++;
+                    while (result == GL_TIMEOUT_EXPIRED)
+                        result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+                }
+                glDeleteSync(fence);
+                fence = 0;
+            }
+        } else {
+            glBindBuffer(GL_UNIFORM_BUFFER, m_Buffer);
+            glBufferData(GL_UNIFORM_BUFFER, m_FrameBytes, NULL, GL_STREAM_DRAW);
+            glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        }
+    }
+    // after the last draw that reads this frame's data
+    void EndFrame() {
+        if (m_Persistent)
+            m_Fences[m_Region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        m_HighWater = m_Used > m_HighWater ? m_Used : m_HighWater;
+    }
+
+    // distance between consecutive blocks of bytes, every block starts at an offset glBindBufferRange accepts
+    size_t Stride(size_t bytes) const {
+        return (bytes + m_Alignment - 1) / m_Alignment * m_Alignment;
+    }
+    // space for bytes in this frame's data, returns its offset
+    size_t Allocate(size_t bytes) {
+        size_t offset = Stride(m_Used);
+        if (offset + bytes > m_FrameBytes) {
+            grow(offset + bytes);
+            offset = 0;
+        }
+        m_Used = offset + bytes;
+        return offset;
+    }
+    // where the CPU writes the data at offset, valid until the next Allocate()
+    void* Pointer(size_t offset) {
+        return (m_Persistent ? m_Mapped + m_Region * m_FrameBytes : m_Staging.data()) + offset;
+    }
+    size_t Push(const void* data, size_t bytes) {
+        size_t offset = Allocate(bytes);
+        std::memcpy(Pointer(offset), data, bytes);
+        return offset;
+    }
+    // makes everything written since the last Commit() visible to the following draws, the mapping is coherent
+    // so only the fallback has something to upload
+    void Commit() {
+        if (m_Persistent || m_Committed == m_Used)
+            return;
+        glBindBuffer(GL_UNIFORM_BUFFER, m_Buffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, m_Committed, m_Used - m_Committed, m_Staging.data() + m_Committed);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        m_Committed = m_Used;
+    }
+    void Bind(unsigned int binding, size_t offset, size_t bytes) const {
+        size_t base = m_Persistent ? m_Region * m_FrameBytes : 0;
+        glBindBufferRange(GL_UNIFORM_BUFFER, binding, m_Buffer, base + offset, bytes);
+    }
+
+    bool Persistent() const { return m_Persistent; }
+    size_t FrameBytes() const { return m_FrameBytes; }
+    size_t HighWater() const { return m_HighWater; }
+    // frames that had to wait for the GPU to release their region
+    unsigned long long Stalls() const { return m_Stalls; }
+
+private:
+    void create(size_t frameBytes) {
+        m_FrameBytes = Stride(frameBytes);
+        size_t bytes = m_Persistent ? FRAMES * m_FrameBytes : m_FrameBytes;
+        glGenBuffers(1, &m_Buffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, m_Buffer);
+        if (m_Persistent) {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_UNIFORM_BUFFER, bytes, NULL, flags);
+            m_Mapped = (char*) glMapBufferRange(GL_UNIFORM_BUFFER, 0, bytes, flags);
+        } else {
+            glBufferData(GL_UNIFORM_BUFFER, bytes, NULL, GL_STREAM_DRAW);
+            m_Staging.resize(m_FrameBytes);
+        }
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        GLDebug::Label(GL_BUFFER, m_Buffer, "Per-draw data");
+        MemoryTracker::Instance().Track(MemoryTracker::Kind::Buffer, m_Buffer, "Per-draw data", bytes, "Draw data ring");
+    }
+    void destroy() {
+        for (GLsync& fence : m_Fences) {
+            if (fence)
+                glDeleteSync(fence);
+            fence = 0;
+        }
+        if (m_Mapped) {
+            glBindBuffer(GL_UNIFORM_BUFFER, m_Buffer);
+            glUnmapBuffer(GL_UNIFORM_BUFFER);
+            glBindBuffer(GL_UNIFORM_BUFFER, 0);
+            m_Mapped = nullptr;
+        }
+        MemoryTracker::Instance().Untrack(MemoryTracker::Kind::Buffer, m_Buffer);
+        glDeleteBuffers(1, &m_Buffer);
+        m_Buffer = 0;
+    }
+    // the rest of the frame goes to a new buffer, deleting the old one is deferred until the GPU is done with it
+    void grow(size_t needed) {
+        Commit();
+        size_t frameBytes = 2 * (needed > m_FrameBytes ? needed : m_FrameBytes);
+        LOG_WARNING(Render, "Per-draw data overflowed its %zu KB region, growing it to %zu KB", m_FrameBytes / 1024,
+                    frameBytes / 1024);
+        m_HighWater = needed > m_HighWater ? needed : m_HighWater;
+        destroy();
+        create(frameBytes);
+        m_Used = 0;
+        m_Committed = 0;
+    }
+
+    bool m_Persistent = false;
+    size_t m_Alignment = 256;
+    unsigned int m_Buffer = 0;
+    char* m_Mapped = nullptr;
+    std::vector<char> m_Staging;
+    GLsync m_Fences[FRAMES] = {};
+    size_t m_FrameBytes = 0;
+    unsigned int m_Region = 0;
+    size_t m_Used = 0;
+    size_t m_Committed = 0;
+    size_t m_HighWater = 0;
+    unsigned long long m_Stalls = 0;
+};
+
+};
+
+#endif //PROJECT_BASE_DRAWDATARING_H
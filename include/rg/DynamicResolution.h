@@ -0,0 +1,86 @@
+#ifndef PROJECT_BASE_DYNAMICRESOLUTION_H
+#define PROJECT_BASE_DYNAMICRESOLUTION_H
+
+#include <rg/GpuTimer.h>
+#include <algorithm>
+#include <cmath>
+
+namespace rg {
+
+// Picks the render scale of the scene pass from the GPU frame time. The scene is drawn into the top left corner of
+// its full size targets through the viewport, so changing the scale never reallocates anything; the tonemap pass
+// upscales that corner to the output.
+// GPU time is assumed to grow with the pixel count, the scale with its square root. A frame over the target drops the
+// scale right away, so load spikes are absorbed within a few frames, while the scale only creeps back up once there
+// is headroom. Timer results arrive a few frames late, after a change the frames rendered at the old scale are
+// skipped instead of being corrected for twice.
+// GL thread only.
+class DynamicResolution {
+public:
+    struct Settings {
+        bool enabled = true;
+        float targetMs = 16.0f;
+        float minScale = 0.5f;
+        float maxScale = 1.0f;
+    };
+    // raising the scale waits until the frame is this much under the target, and moves at most this much per change
+    static constexpr float HEADROOM = 0.85f;
+    static constexpr float MAX_STEP_UP = 0.05f;
+
+    // around all GPU work of the frame
+    void BeginFrame() {
+        m_Timer.Begin();
+    }
+    void EndFrame(const Settings& settings) {
+        m_Timer.End();
+        float ms = m_Timer.Milliseconds();
+        if (!settings.enabled) {
+            m_Scale = settings.maxScale;
+            m_Cooldown = 0;
+        } else if (m_Timer.Samples() != m_Seen) {
+            m_Seen = m_Timer.Samples();
+            if (m_Cooldown > 0) {
+                m_Cooldown--;
+            } else {
+                float ideal = m_Scale * std::sqrt(settings.targetMs / std::max(ms, 0.01f));
+                float scale = m_Scale;
+                if (ms > settings.targetMs)
+                    scale = ideal;
+                else if (ms < settings.targetMs * HEADROOM)
+                    scale = std::min(ideal, m_Scale + MAX_STEP_UP);
+                change(clamp(scale, settings));
+            }
+        }
+        m_Scale = clamp(m_Scale, settings);
+        m_GpuMs = ms;
+    }
+
+    float Scale() const { return m_Scale; }
+    // latest GPU time of a whole frame
+    float GpuMilliseconds() const { return m_GpuMs; }
+    unsigned int Changes() const { return m_Changes; }
+
+private:
+    static float clamp(float scale, const Settings& settings) {
+        return std::min(std::max(scale, settings.minScale), settings.maxScale);
+    }
+    void change(float scale) {
+        // small corrections aren't worth the frames of latency they cost
+        if (std::abs(scale - m_Scale) < 0.01f)
+            return;
+        m_Scale = scale;
+        m_Cooldown = GpuTimer::LATENCY;
+        m_Changes++;
+    }
+
+    GpuTimer m_Timer;
+    unsigned long m_Seen = 0;
+    unsigned int m_Cooldown = 0;
+    float m_Scale = 1.0f;
+    float m_GpuMs = 0.0f;
+    unsigned int m_Changes = 0;
+};
+
+};
+
+#endif //PROJECT_BASE_DYNAMICRESOLUTION_H
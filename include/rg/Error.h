@@ -7,12 +7,19 @@
 
 #include <iostream>
 #include <glad/glad.h>
+#include <rg/Log.h>
+#include <rg/GLDebug.h>
 
 #define LOG(stream) stream << "[" << __FILE__ << ", " << __func__ << ", " << __LINE__ << "] "
 #define BREAK_IF_FALSE(x) if (!(x)) __builtin_trap()
 #define ASSERT(x, msg) do { if (!(x)) { std::cerr << msg << '\n'; BREAK_IF_FALSE(false); } } while(0)
+#ifdef NDEBUG
+#define GLCALL(x) x
+#else
+// with the KHR_debug callback installed errors arrive asynchronously, polling glGetError is only the fallback
 #define GLCALL(x) \
-do{ rg::clearAllOpenGlErrors(); x; BREAK_IF_FALSE(rg::wasPreviousOpenGLCallSuccessful(__FILE__, __LINE__, #x)); } while (0)
+do{ if (rg::GLDebug::CallbackActive()) { x; } else { rg::clearAllOpenGlErrors(); x; BREAK_IF_FALSE(rg::wasPreviousOpenGLCallSuccessful(__FILE__, __LINE__, #x)); } } while (0)
+#endif
 
 namespace rg {
 
@@ -40,11 +47,7 @@ bool wasPreviousOpenGLCallSuccessful(const char* file, int line, const char* cal
     bool wasPreviousOpenGLCallSuccessful(const char* file, int line, const char* call) {
         bool success = true;
         while (GLenum error = glGetError()) {
-            std::cerr << "[OpenGL error] " << error << " " << openGLErrorToString(error)
-            << "\nFile: " << file
-            << "\nLine: " << line
-            << "\nCall: " << call
-            << "\n\n";
+            LOG_ERROR(GL, "%u %s\nFile: %s\nLine: %d\nCall: %s", error, openGLErrorToString(error), file, line, call);
             success = false;
         }
         return success;
@@ -0,0 +1,70 @@
+#ifndef PROJECT_BASE_FRAGMENTCOUNTER_H
+#define PROJECT_BASE_FRAGMENTCOUNTER_H
+
+#include <glad/glad.h>
+
+namespace rg {
+
+// Counts the samples that pass the depth test between Begin() and End() with GL_SAMPLES_PASSED queries, read back
+// like GpuTimer a few frames later without stalling. Only one counter may be active at a time.
+class FragmentCounter {
+public:
+    static const unsigned int LATENCY = 4;
+
+    FragmentCounter() {
+        glGenQueries(LATENCY, m_Queries);
+    }
+    ~FragmentCounter() {
+        glDeleteQueries(LATENCY, m_Queries);
+    }
+    FragmentCounter(const FragmentCounter&) = delete;
+    FragmentCounter& operator=(const FragmentCounter&) = delete;
+
+    void Begin() {
+        resolve();
+        // every slot is still in flight, drop this count instead of waiting for the GPU
+        m_Skipped = m_Pending[m_Write];
+        if (!m_Skipped)
+            glBeginQuery(GL_SAMPLES_PASSED, m_Queries[m_Write]);
+    }
+    void End() {
+        if (m_Skipped)
+            return;
+        glEndQuery(GL_SAMPLES_PASSED);
+        m_Pending[m_Write] = true;
+        m_Write = (m_Write + 1) % LATENCY;
+    }
+
+    // latest count that has finished on the GPU
+    unsigned long long Fragments() {
+        resolve();
+        return m_Last;
+    }
+
+private:
+    void resolve() {
+        for (unsigned int i = 0; i < LATENCY; i++) {
+            unsigned int slot = (m_Write + i) % LATENCY; // oldest first
+            if (!m_Pending[slot])
+                continue;
+            GLint available = 0;
+            glGetQueryObjectiv(m_Queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                break;
+            GLuint64 samples = 0;
+            glGetQueryObjectui64v(m_Queries[slot], GL_QUERY_RESULT, &samples);
+            m_Last = samples;
+            m_Pending[slot] = false;
+        }
+    }
+
+    GLuint m_Queries[LATENCY];
+    bool m_Pending[LATENCY] = {false};
+    unsigned int m_Write = 0;
+    bool m_Skipped = false;
+    unsigned long long m_Last = 0;
+};
+
+};
+
+#endif //PROJECT_BASE_FRAGMENTCOUNTER_H
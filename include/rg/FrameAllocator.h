@@ -0,0 +1,129 @@
+#ifndef PROJECT_BASE_FRAMEALLOCATOR_H
+#define PROJECT_BASE_FRAMEALLOCATOR_H
+
+#include <rg/Log.h>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+namespace rg {
+
+// Linear allocator for data that only lives until the end of the frame (sorted lists, scratch arrays ...).
+// Allocating bumps an offset into one block, nothing is freed individually, Reset() at the start of every frame
+// releases everything at once. A frame that needs more than the block falls back to malloc and the block grows
+// to fit at the next Reset(), so only the frames before the high water mark is reached ever touch the heap.
+// Every thread has its own, the render thread resets it per frame and the main thread per UI frame.
+class FrameAllocator {
+public:
+    static FrameAllocator& Instance() {
+        static thread_local FrameAllocator allocator;
+        return allocator;
+    }
+    FrameAllocator(const FrameAllocator&) = delete;
+    FrameAllocator& operator=(const FrameAllocator&) = delete;
+    ~FrameAllocator() {
+        releaseOverflow();
+        std::free(m_Block);
+    }
+
+    void* Allocate(size_t bytes, size_t alignment = alignof(std::max_align_t)) {
+        uintptr_t base = (uintptr_t) m_Block;
+        uintptr_t start = (base + m_Used + alignment - 1) & ~(uintptr_t) (alignment - 1);
+        size_t end = start - base + bytes;
+        if (m_Block && end <= m_Capacity) {
+            m_Used = end;
+            m_HighWater = m_Used > m_HighWater ? m_Used : m_HighWater;
+            return (void*) start;
+        }
+        // out of space, served from the heap until the block has been resized. The blocks are chained through a
+        // header at their start instead of a container, so the overflow doesn't go through operator new, which
+        // the allocation tracker's strict mode would report
+        size_t header = sizeof(Overflow) > alignment ? sizeof(Overflow) : alignment;
+        Overflow* memory = (Overflow*) std::malloc(header + bytes + alignment);
+        if (!memory)
+            throw std::bad_alloc();
+        memory->next = m_Overflow;
+        m_Overflow = memory;
+        m_OverflowBytes += bytes + alignment;
+        return (void*) (((uintptr_t) memory + header + alignment - 1) & ~(uintptr_t) (alignment - 1));
+    }
+    template<typename T>
+    T* New(size_t count = 1) {
+        T* items = (T*) Allocate(count * sizeof(T), alignof(T));
+        for (size_t i = 0; i < count; i++)
+            new(items + i) T();
+        return items;
+    }
+
+    // everything allocated since the last Reset() is gone, destructors aren't run
+    void Reset() {
+        if (m_OverflowBytes) {
+            size_t capacity = 2 * (m_Used + m_OverflowBytes);
+            LOG_WARNING(General, "Frame allocator overflowed by %zu bytes, growing it to %zu KB", m_OverflowBytes,
+                        capacity / 1024);
+            releaseOverflow();
+            std::free(m_Block);
+            m_Block = (char*) std::malloc(capacity);
+            m_Capacity = m_Block ? capacity : 0;
+            m_HighWater = m_Used + m_OverflowBytes;
+            m_OverflowBytes = 0;
+        }
+        m_Used = 0;
+    }
+
+    size_t Used() const { return m_Used; }
+    size_t Capacity() const { return m_Capacity; }
+    size_t HighWater() const { return m_HighWater; }
+
+private:
+    FrameAllocator() : m_Block((char*) std::malloc(1024 * 1024)), m_Capacity(m_Block ? 1024 * 1024 : 0) {}
+
+    struct Overflow {
+        Overflow* next;
+    };
+
+    void releaseOverflow() {
+        while (m_Overflow) {
+            Overflow* next = m_Overflow->next;
+            std::free(m_Overflow);
+            m_Overflow = next;
+        }
+    }
+
+    char* m_Block;
+    size_t m_Capacity;
+    size_t m_Used = 0;
+    size_t m_HighWater = 0;
+    Overflow* m_Overflow = NULL;
+    size_t m_OverflowBytes = 0;
+};
+
+// lets standard containers live in frame memory, deallocate is a no-op
+template<typename T>
+struct FrameStlAllocator {
+    typedef T value_type;
+
+    FrameStlAllocator() = default;
+    template<typename U>
+    FrameStlAllocator(const FrameStlAllocator<U>&) {}
+
+    T* allocate(size_t count) {
+        return (T*) FrameAllocator::Instance().Allocate(count * sizeof(T), alignof(T));
+    }
+    void deallocate(T*, size_t) {}
+
+    template<typename U>
+    bool operator==(const FrameStlAllocator<U>&) const { return true; }
+    template<typename U>
+    bool operator!=(const FrameStlAllocator<U>&) const { return false; }
+};
+
+// reserve up front, every reallocation leaves the old storage behind until the end of the frame
+template<typename T>
+using FrameVector = std::vector<T, FrameStlAllocator<T>>;
+
+};
+
+#endif //PROJECT_BASE_FRAMEALLOCATOR_H
@@ -0,0 +1,104 @@
+#ifndef PROJECT_BASE_GLDEBUG_H
+#define PROJECT_BASE_GLDEBUG_H
+
+#include <glad/glad.h>
+#include <rg/Log.h>
+#include <string>
+
+#define GL_DEBUG_CONCAT_(a, b) a##b
+#define GL_DEBUG_CONCAT(a, b) GL_DEBUG_CONCAT_(a, b)
+#define GL_DEBUG_GROUP(name) rg::DebugGroup GL_DEBUG_CONCAT(debugGroup, __LINE__)(name)
+
+namespace rg {
+
+// Debug layer on top of GL_KHR_debug.
+// In debug builds the driver reports errors and warnings through an asynchronous callback that feeds the logger,
+// so GLCALL doesn't have to poll glGetError (which synchronises with the GPU on many drivers).
+// Object labels and debug groups are set whenever the extension is present, they show up in RenderDoc/apitrace captures.
+class GLDebug {
+public:
+    // call once after glad was loaded, returns whether the message callback is installed
+    static bool Init() {
+        if (!GLAD_GL_KHR_debug)
+            return false;
+#ifndef NDEBUG
+        glEnable(GL_DEBUG_OUTPUT);
+        // no GL_DEBUG_OUTPUT_SYNCHRONOUS, the callback may run on a driver thread, the logger is thread safe
+        glDebugMessageCallback(callback, NULL);
+        // notifications (buffer placement, group push/pop ...) are noise
+        glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_NOTIFICATION, 0, NULL, GL_FALSE);
+        callbackActive() = true;
+        LOG_INFO(GL, "KHR_debug message callback installed");
+#endif
+        return callbackActive();
+    }
+    static bool CallbackActive() { return callbackActive(); }
+
+    static void Label(GLenum identifier, GLuint name, const std::string& label) {
+        if (GLAD_GL_KHR_debug && name != 0)
+            glObjectLabel(identifier, name, -1, label.c_str());
+    }
+    static void PushGroup(const char* name) {
+        if (GLAD_GL_KHR_debug)
+            glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, name);
+    }
+    static void PopGroup() {
+        if (GLAD_GL_KHR_debug)
+            glPopDebugGroup();
+    }
+
+private:
+    static bool& callbackActive() {
+        static bool active = false;
+        return active;
+    }
+
+    static const char* sourceName(GLenum source) {
+        switch (source) {
+            case GL_DEBUG_SOURCE_API: return "API";
+            case GL_DEBUG_SOURCE_WINDOW_SYSTEM: return "window system";
+            case GL_DEBUG_SOURCE_SHADER_COMPILER: return "shader compiler";
+            case GL_DEBUG_SOURCE_THIRD_PARTY: return "third party";
+            case GL_DEBUG_SOURCE_APPLICATION: return "application";
+            default: return "other";
+        }
+    }
+    static const char* typeName(GLenum type) {
+        switch (type) {
+            case GL_DEBUG_TYPE_ERROR: return "error";
+            case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR: return "deprecated";
+            case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR: return "undefined behavior";
+            case GL_DEBUG_TYPE_PORTABILITY: return "portability";
+            case GL_DEBUG_TYPE_PERFORMANCE: return "performance";
+            case GL_DEBUG_TYPE_MARKER: return "marker";
+            default: return "other";
+        }
+    }
+
+    static void APIENTRY callback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length,
+                                  const GLchar* message, const void* userParam) {
+        if (type == GL_DEBUG_TYPE_ERROR || severity == GL_DEBUG_SEVERITY_HIGH)
+            LOG_ERROR(GL, "[%s, %s, %u] %s", sourceName(source), typeName(type), id, message);
+        else if (severity == GL_DEBUG_SEVERITY_MEDIUM)
+            LOG_WARNING(GL, "[%s, %s, %u] %s", sourceName(source), typeName(type), id, message);
+        else
+            LOG_DEBUG(GL, "[%s, %s, %u] %s", sourceName(source), typeName(type), id, message);
+    }
+};
+
+// names the GL commands of a scope in captures
+class DebugGroup {
+public:
+    explicit DebugGroup(const char* name) {
+        GLDebug::PushGroup(name);
+    }
+    ~DebugGroup() {
+        GLDebug::PopGroup();
+    }
+    DebugGroup(const DebugGroup&) = delete;
+    DebugGroup& operator=(const DebugGroup&) = delete;
+};
+
+};
+
+#endif //PROJECT_BASE_GLDEBUG_H
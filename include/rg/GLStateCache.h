@@ -0,0 +1,332 @@
+#ifndef PROJECT_BASE_GLSTATECACHE_H
+#define PROJECT_BASE_GLSTATECACHE_H
+
+#include <glad/glad.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ostream>
+
+namespace rg {
+
+// Shadows the GL state the frame changes the most (program, vertex array, texture units, framebuffers, blend, depth
+// and cull state) and drops every call that would set it to the value it already has.
+// Install() swaps the glad pointers of the setters like GLStats does, so Mesh, the passes and the ImGui backend all
+// go through it without changing their calls. Deleting an object forgets where it was bound, GL unbinds it and its
+// name may be handed out again. Until a value has been set once it is unknown and the call always goes through.
+// Disabled, every call reaches the driver but redundant ones are still counted, which is the "before" of the
+// numbers the enabled cache gives. One context, GL thread only.
+class GLStateCache {
+public:
+    enum Kind {
+        Program,
+        VertexArray,
+        Texture,     // glActiveTexture and glBindTexture
+        Framebuffer,
+        Blend,       // GL_BLEND and the blend function
+        Depth,       // GL_DEPTH_TEST, depth function and mask
+        Cull,        // GL_CULL_FACE and the culled face
+        KIND_COUNT
+    };
+    struct Counters {
+        unsigned long long calls[KIND_COUNT];
+        unsigned long long redundant[KIND_COUNT];
+    };
+    static const unsigned int MAX_UNITS = 32;
+
+    static GLStateCache& Instance() {
+        static GLStateCache cache;
+        return cache;
+    }
+    GLStateCache(const GLStateCache&) = delete;
+    GLStateCache& operator=(const GLStateCache&) = delete;
+
+    // after glad loaded the function pointers and after GLStats wrapped them, so GLStats counts what reaches the driver
+    void Install() {
+        hook(glad_glUseProgram, m_Original.useProgram, useProgram);
+        hook(glad_glBindVertexArray, m_Original.bindVertexArray, bindVertexArray);
+        hook(glad_glActiveTexture, m_Original.activeTexture, activeTexture);
+        hook(glad_glBindTexture, m_Original.bindTexture, bindTexture);
+        hook(glad_glBindFramebuffer, m_Original.bindFramebuffer, bindFramebuffer);
+        hook(glad_glEnable, m_Original.enable, enable);
+        hook(glad_glDisable, m_Original.disable, disable);
+        hook(glad_glBlendFunc, m_Original.blendFunc, blendFunc);
+        hook(glad_glBlendFuncSeparate, m_Original.blendFuncSeparate, blendFuncSeparate);
+        hook(glad_glDepthFunc, m_Original.depthFunc, depthFunc);
+        hook(glad_glDepthMask, m_Original.depthMask, depthMask);
+        hook(glad_glCullFace, m_Original.cullFace, cullFace);
+        hook(glad_glDeleteProgram, m_Original.deleteProgram, deleteProgram);
+        hook(glad_glDeleteVertexArrays, m_Original.deleteVertexArrays, deleteVertexArrays);
+        hook(glad_glDeleteTextures, m_Original.deleteTextures, deleteTextures);
+        hook(glad_glDeleteFramebuffers, m_Original.deleteFramebuffers, deleteFramebuffers);
+    }
+
+    void SetEnabled(bool enabled) { m_Enabled = enabled; }
+    bool Enabled() const { return m_Enabled; }
+    // forgets every value, for code that changes the state without going through glad
+    void Invalidate() { m_State = State(); }
+
+    void BeginFrame() {
+        std::memset(&m_Current, 0, sizeof(Counters));
+    }
+    void EndFrame() {
+        m_Last = m_Current;
+        m_Run.frames++;
+        for (unsigned int k = 0; k < KIND_COUNT; k++) {
+            m_Run.counters.calls[k] += m_Current.calls[k];
+            m_Run.counters.redundant[k] += m_Current.redundant[k];
+        }
+    }
+    // forgets the totals, the benchmark calls it after the warm-up
+    void ResetRun() {
+        m_Run = Run();
+    }
+    const Counters& LastFrame() const { return m_Last; }
+
+    static const char* KindName(Kind kind) {
+        static const char* names[] = {"program", "vertexArray", "texture", "framebuffer", "blend", "depth", "cull"};
+        return names[kind];
+    }
+
+    // "stateCache" object of the benchmark results, averages over the frames since ResetRun
+    void WriteJson(std::ostream& out) const {
+        double frames = std::max(m_Run.frames, 1ull);
+        char buffer[256];
+        out << "{\n    \"enabled\": " << (m_Enabled ? "true" : "false") << ",\n    \"kinds\": {";
+        for (unsigned int k = 0; k < KIND_COUNT; k++) {
+            std::snprintf(buffer, sizeof(buffer), "%s\n      \"%s\": {\"callsPerFrame\": %.2f, \"redundantPerFrame\": %.2f}",
+                          k ? "," : "", KindName((Kind) k), m_Run.counters.calls[k] / frames,
+                          m_Run.counters.redundant[k] / frames);
+            out << buffer;
+        }
+        out << "\n    }\n  }";
+    }
+
+private:
+    static const GLuint UNKNOWN = 0xFFFFFFFFu;
+    static const unsigned int TARGET_COUNT = 4;
+
+    struct State {
+        GLuint program = UNKNOWN;
+        GLuint vertexArray = UNKNOWN;
+        GLenum activeTexture = UNKNOWN;
+        GLuint textures[MAX_UNITS][TARGET_COUNT];
+        GLuint drawFramebuffer = UNKNOWN, readFramebuffer = UNKNOWN;
+        GLuint blend = UNKNOWN, depthTest = UNKNOWN, cullFace = UNKNOWN; // GL_TRUE, GL_FALSE or unknown
+        GLenum blendFunc[4] = {UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN};
+        GLenum depthFunc = UNKNOWN;
+        GLuint depthMask = UNKNOWN;
+        GLenum cullMode = UNKNOWN;
+
+        State() {
+            std::fill(&textures[0][0], &textures[0][0] + MAX_UNITS * TARGET_COUNT, GLuint(UNKNOWN));
+        }
+    };
+    struct Originals {
+        decltype(glad_glUseProgram) useProgram = NULL;
+        decltype(glad_glBindVertexArray) bindVertexArray = NULL;
+        decltype(glad_glActiveTexture) activeTexture = NULL;
+        decltype(glad_glBindTexture) bindTexture = NULL;
+        decltype(glad_glBindFramebuffer) bindFramebuffer = NULL;
+        decltype(glad_glEnable) enable = NULL;
+        decltype(glad_glDisable) disable = NULL;
+        decltype(glad_glBlendFunc) blendFunc = NULL;
+        decltype(glad_glBlendFuncSeparate) blendFuncSeparate = NULL;
+        decltype(glad_glDepthFunc) depthFunc = NULL;
+        decltype(glad_glDepthMask) depthMask = NULL;
+        decltype(glad_glCullFace) cullFace = NULL;
+        decltype(glad_glDeleteProgram) deleteProgram = NULL;
+        decltype(glad_glDeleteVertexArrays) deleteVertexArrays = NULL;
+        decltype(glad_glDeleteTextures) deleteTextures = NULL;
+        decltype(glad_glDeleteFramebuffers) deleteFramebuffers = NULL;
+    };
+    struct Run {
+        unsigned long long frames = 0;
+        Counters counters = {};
+    };
+
+    GLStateCache() {
+        std::memset(&m_Current, 0, sizeof(Counters));
+        std::memset(&m_Last, 0, sizeof(Counters));
+    }
+
+    template<typename F>
+    static void hook(F& pointer, F& original, F wrapper) {
+        if (!pointer || pointer == wrapper)
+            return;
+        original = pointer;
+        pointer = wrapper;
+    }
+
+    // counts the call and tells whether it has to reach the driver, the shadow value is updated either way
+    template<typename T>
+    bool set(Kind kind, T& shadow, T value) {
+        m_Current.calls[kind]++;
+        if (shadow == value) {
+            m_Current.redundant[kind]++;
+            return !m_Enabled;
+        }
+        shadow = value;
+        return true;
+    }
+    static int targetIndex(GLenum target) {
+        switch (target) {
+            case GL_TEXTURE_2D: return 0;
+            case GL_TEXTURE_CUBE_MAP: return 1;
+            case GL_TEXTURE_2D_ARRAY: return 2;
+            case GL_TEXTURE_2D_MULTISAMPLE: return 3;
+            default: return -1;
+        }
+    }
+    GLuint* capability(GLenum cap, Kind& kind) {
+        switch (cap) {
+            case GL_BLEND: kind = Blend; return &m_State.blend;
+            case GL_DEPTH_TEST: kind = Depth; return &m_State.depthTest;
+            case GL_CULL_FACE: kind = Cull; return &m_State.cullFace;
+            default: return NULL;
+        }
+    }
+
+    static void APIENTRY useProgram(GLuint program) {
+        GLStateCache& cache = Instance();
+        if (cache.set(Program, cache.m_State.program, program))
+            cache.m_Original.useProgram(program);
+    }
+    static void APIENTRY bindVertexArray(GLuint array) {
+        GLStateCache& cache = Instance();
+        if (cache.set(VertexArray, cache.m_State.vertexArray, array))
+            cache.m_Original.bindVertexArray(array);
+    }
+    static void APIENTRY activeTexture(GLenum unit) {
+        GLStateCache& cache = Instance();
+        if (cache.set(Texture, cache.m_State.activeTexture, unit))
+            cache.m_Original.activeTexture(unit);
+    }
+    static void APIENTRY bindTexture(GLenum target, GLuint texture) {
+        GLStateCache& cache = Instance();
+        GLuint unit = cache.m_State.activeTexture - GL_TEXTURE0;
+        int index = targetIndex(target);
+        // other targets and units aren't shadowed
+        if (index < 0 || cache.m_State.activeTexture == UNKNOWN || unit >= MAX_UNITS) {
+            cache.m_Current.calls[Texture]++;
+            cache.m_Original.bindTexture(target, texture);
+            return;
+        }
+        if (cache.set(Texture, cache.m_State.textures[unit][index], texture))
+            cache.m_Original.bindTexture(target, texture);
+    }
+    static void APIENTRY bindFramebuffer(GLenum target, GLuint framebuffer) {
+        GLStateCache& cache = Instance();
+        State& state = cache.m_State;
+        bool draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+        bool read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+        cache.m_Current.calls[Framebuffer]++;
+        if ((!draw || state.drawFramebuffer == framebuffer) && (!read || state.readFramebuffer == framebuffer)) {
+            cache.m_Current.redundant[Framebuffer]++;
+            if (cache.m_Enabled)
+                return;
+        }
+        if (draw)
+            state.drawFramebuffer = framebuffer;
+        if (read)
+            state.readFramebuffer = framebuffer;
+        cache.m_Original.bindFramebuffer(target, framebuffer);
+    }
+    static void APIENTRY enable(GLenum cap) {
+        GLStateCache& cache = Instance();
+        Kind kind;
+        GLuint* shadow = cache.capability(cap, kind);
+        if (!shadow || cache.set(kind, *shadow, (GLuint) GL_TRUE))
+            cache.m_Original.enable(cap);
+    }
+    static void APIENTRY disable(GLenum cap) {
+        GLStateCache& cache = Instance();
+        Kind kind;
+        GLuint* shadow = cache.capability(cap, kind);
+        if (!shadow || cache.set(kind, *shadow, (GLuint) GL_FALSE))
+            cache.m_Original.disable(cap);
+    }
+    static void APIENTRY blendFunc(GLenum source, GLenum destination) {
+        blendFuncSeparate(source, destination, source, destination);
+    }
+    static void APIENTRY blendFuncSeparate(GLenum sourceRgb, GLenum destinationRgb, GLenum sourceAlpha,
+                                           GLenum destinationAlpha) {
+        GLStateCache& cache = Instance();
+        GLenum* shadow = cache.m_State.blendFunc;
+        GLenum value[4] = {sourceRgb, destinationRgb, sourceAlpha, destinationAlpha};
+        cache.m_Current.calls[Blend]++;
+        if (std::equal(value, value + 4, shadow)) {
+            cache.m_Current.redundant[Blend]++;
+            if (cache.m_Enabled)
+                return;
+        }
+        std::copy(value, value + 4, shadow);
+        if (sourceRgb == sourceAlpha && destinationRgb == destinationAlpha)
+            cache.m_Original.blendFunc(sourceRgb, destinationRgb);
+        else
+            cache.m_Original.blendFuncSeparate(sourceRgb, destinationRgb, sourceAlpha, destinationAlpha);
+    }
+    static void APIENTRY depthFunc(GLenum function) {
+        GLStateCache& cache = Instance();
+        if (cache.set(Depth, cache.m_State.depthFunc, function))
+            cache.m_Original.depthFunc(function);
+    }
+    static void APIENTRY depthMask(GLboolean flag) {
+        GLStateCache& cache = Instance();
+        if (cache.set(Depth, cache.m_State.depthMask, (GLuint) (flag ? GL_TRUE : GL_FALSE)))
+            cache.m_Original.depthMask(flag);
+    }
+    static void APIENTRY cullFace(GLenum mode) {
+        GLStateCache& cache = Instance();
+        if (cache.set(Cull, cache.m_State.cullMode, mode))
+            cache.m_Original.cullFace(mode);
+    }
+
+    static void APIENTRY deleteProgram(GLuint program) {
+        GLStateCache& cache = Instance();
+        // a program in use is only flagged for deletion, but its name can't be trusted either way
+        if (program && cache.m_State.program == program)
+            cache.m_State.program = UNKNOWN;
+        cache.m_Original.deleteProgram(program);
+    }
+    static void APIENTRY deleteVertexArrays(GLsizei n, const GLuint* arrays) {
+        GLStateCache& cache = Instance();
+        for (GLsizei i = 0; i < n; i++) {
+            if (arrays[i] && cache.m_State.vertexArray == arrays[i])
+                cache.m_State.vertexArray = UNKNOWN;
+        }
+        cache.m_Original.deleteVertexArrays(n, arrays);
+    }
+    static void APIENTRY deleteTextures(GLsizei n, const GLuint* textures) {
+        GLStateCache& cache = Instance();
+        GLuint* bound = &cache.m_State.textures[0][0];
+        for (GLsizei i = 0; i < n; i++) {
+            if (textures[i])
+                std::replace(bound, bound + MAX_UNITS * TARGET_COUNT, textures[i], GLuint(UNKNOWN));
+        }
+        cache.m_Original.deleteTextures(n, textures);
+    }
+    static void APIENTRY deleteFramebuffers(GLsizei n, const GLuint* framebuffers) {
+        GLStateCache& cache = Instance();
+        for (GLsizei i = 0; i < n; i++) {
+            if (!framebuffers[i])
+                continue;
+            if (cache.m_State.drawFramebuffer == framebuffers[i])
+                cache.m_State.drawFramebuffer = UNKNOWN;
+            if (cache.m_State.readFramebuffer == framebuffers[i])
+                cache.m_State.readFramebuffer = UNKNOWN;
+        }
+        cache.m_Original.deleteFramebuffers(n, framebuffers);
+    }
+
+    bool m_Enabled = true;
+    State m_State;
+    Originals m_Original;
+    Counters m_Current;
+    Counters m_Last;
+    Run m_Run;
+};
+
+};
+
+#endif //PROJECT_BASE_GLSTATECACHE_H
@@ -0,0 +1,373 @@
+#ifndef PROJECT_BASE_GLSTATS_H
+#define PROJECT_BASE_GLSTATS_H
+
+#include <glad/glad.h>
+#include "imgui.h"
+#include <rg/FrameAllocator.h>
+#include <rg/Profiler.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+// every GL entry point the accounting layer wraps, with the category it is counted under
+#define GL_STATS_FUNCTIONS(X) \
+    X(glDrawArrays, Draw) \
+    X(glDrawElements, Draw) \
+    X(glDrawArraysInstanced, Draw) \
+    X(glDrawElementsInstanced, Draw) \
+    X(glUseProgram, Program) \
+    X(glBindTexture, Texture) \
+    X(glActiveTexture, Texture) \
+    X(glUniform1i, Uniform) \
+    X(glUniform1f, Uniform) \
+    X(glUniform2f, Uniform) \
+    X(glUniform2fv, Uniform) \
+    X(glUniform3f, Uniform) \
+    X(glUniform3fv, Uniform) \
+    X(glUniform4f, Uniform) \
+    X(glUniform4fv, Uniform) \
+    X(glUniformMatrix2fv, Uniform) \
+    X(glUniformMatrix3fv, Uniform) \
+    X(glUniformMatrix4fv, Uniform) \
+    X(glBufferData, Upload) \
+    X(glBufferSubData, Upload) \
+    X(glTexImage2D, Upload) \
+    X(glTexSubImage2D, Upload) \
+    X(glTexImage3D, Upload) \
+    X(glGenerateMipmap, Upload) \
+    X(glBindVertexArray, State) \
+    X(glBindBuffer, State) \
+    X(glBindBufferRange, State) \
+    X(glBindFramebuffer, State) \
+    X(glEnable, State) \
+    X(glDisable, State) \
+    X(glViewport, State) \
+    X(glClear, State) \
+    X(glDepthFunc, State) \
+    X(glCullFace, State) \
+    X(glBlendFunc, State) \
+    X(glDrawBuffer, State) \
+    X(glReadBuffer, State) \
+    X(glGetUniformLocation, Query) \
+    X(glGetIntegerv, Query) \
+    X(glGetError, Query)
+
+namespace rg {
+
+// GL call accounting for the instrumentation build (cmake -DGL_STATS=ON).
+// Install() swaps the glad function pointers listed in GL_STATS_FUNCTIONS for wrappers that count and time every
+// call, so calls made inside Mesh, the shadow maps and the ImGui backend are seen as well. A call site is the
+// innermost profiler scope the call was made from. In normal builds everything here is a no-op.
+// Counting happens on the GL thread, DrawWindow() may run on another one and shows the frame EndFrame() published.
+class GLStats {
+public:
+    enum Category {
+        Draw,
+        Program,
+        Texture,
+        Uniform,
+        Upload,
+        State,
+        Query,
+        CATEGORY_COUNT
+    };
+#define GL_STATS_ID(function, category) function##Id,
+    enum FunctionId {
+        GL_STATS_FUNCTIONS(GL_STATS_ID)
+        FUNCTION_COUNT
+    };
+#undef GL_STATS_ID
+    static const unsigned int MAX_SITES = 32;
+    static const unsigned int TOP_SITES = 10;
+
+    static GLStats& Instance() {
+        static GLStats stats;
+        return stats;
+    }
+    GLStats(const GLStats&) = delete;
+    GLStats& operator=(const GLStats&) = delete;
+
+#ifdef GL_STATS
+    static bool Enabled() { return true; }
+#else
+    static bool Enabled() { return false; }
+#endif
+
+    // has to be called right after glad loaded the function pointers
+    void Install() {
+#ifdef GL_STATS
+#define GL_STATS_INSTALL(function, category) install<function##Id>(glad_##function, #function, category);
+        GL_STATS_FUNCTIONS(GL_STATS_INSTALL)
+#undef GL_STATS_INSTALL
+#endif
+    }
+
+    void BeginFrame() {
+        std::memset(&m_Current, 0, sizeof(Counters));
+    }
+    void EndFrame() {
+        if (!Enabled())
+            return;
+        m_Last = m_Current;
+        {
+            std::lock_guard<std::mutex> lock(m_ShownMutex);
+            m_Shown.counters = m_Last;
+            for (unsigned int s = 0; s < MAX_SITES; s++)
+                m_Shown.scopes[s] = s < m_Scopes.size() + 1 ? scopeName(s) : NULL;
+        }
+        m_Run.frames++;
+        for (unsigned int f = 0; f < FUNCTION_COUNT; f++) {
+            m_Run.calls[f] += m_Current.calls[f];
+            m_Run.nanoseconds[f] += m_Current.nanoseconds[f];
+        }
+        for (unsigned int c = 0; c < CATEGORY_COUNT; c++) {
+            unsigned long long calls = categoryCalls(m_Current, (Category) c);
+            m_Run.categoryCalls[c] += calls;
+            m_Run.categoryMax[c] = std::max(m_Run.categoryMax[c], calls);
+        }
+        for (unsigned int s = 0; s < MAX_SITES; s++) {
+            for (unsigned int f = 0; f < FUNCTION_COUNT; f++)
+                m_Run.sites[s][f] += m_Current.sites[s][f];
+        }
+    }
+    // forgets the totals, the benchmark calls it after the warm-up
+    void ResetRun() {
+        m_Run = Run();
+    }
+
+    // calls of the last frame per category, the busiest functions and the top call sites
+    void DrawWindow() {
+        if (!Enabled()) {
+            ImGui::Text("Build with -DGL_STATS=ON to count GL calls");
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_ShownMutex);
+            m_Drawn = m_Shown;
+        }
+        const Counters& last = m_Drawn.counters;
+        ImGui::Columns(2, "glStatsCategories");
+        for (unsigned int c = 0; c < CATEGORY_COUNT; c++) {
+            ImGui::Text("%s", categoryName((Category) c));
+            ImGui::NextColumn();
+            ImGui::Text("%llu", categoryCalls(last, (Category) c));
+            ImGui::NextColumn();
+        }
+        ImGui::Columns(1);
+        ImGui::Separator();
+
+        ImGui::Columns(3, "glStatsFunctions");
+        ImGui::Text("Function");
+        ImGui::NextColumn();
+        ImGui::Text("Calls");
+        ImGui::NextColumn();
+        ImGui::Text("CPU us");
+        ImGui::NextColumn();
+        for (unsigned int f : sortedFunctions(last.calls)) {
+            ImGui::Text("%s", functions()[f].name);
+            ImGui::NextColumn();
+            ImGui::Text("%llu", last.calls[f]);
+            ImGui::NextColumn();
+            ImGui::Text("%.1f", last.nanoseconds[f] / 1000.0);
+            ImGui::NextColumn();
+        }
+        ImGui::Columns(1);
+        ImGui::Separator();
+
+        ImGui::Text("Top call sites");
+        for (const Site& site : topSites(last.sites))
+            ImGui::Text("%6llu  %s / %s", site.calls, m_Drawn.scopes[site.scope], functions()[site.function].name);
+    }
+
+    // "glCalls" object of the benchmark results, averages over the frames since ResetRun
+    void WriteJson(std::ostream& out) const {
+        double frames = std::max(m_Run.frames, 1ull);
+        char buffer[256];
+        out << "{\n    \"frames\": " << m_Run.frames << ",\n    \"categories\": {";
+        for (unsigned int c = 0; c < CATEGORY_COUNT; c++) {
+            std::snprintf(buffer, sizeof(buffer), "%s\n      \"%s\": {\"mean\": %.2f, \"max\": %llu}", c ? "," : "",
+                          categoryName((Category) c), m_Run.categoryCalls[c] / frames, m_Run.categoryMax[c]);
+            out << buffer;
+        }
+        out << "\n    },\n    \"functions\": [";
+        bool first = true;
+        for (unsigned int f : sortedFunctions(m_Run.calls)) {
+            std::snprintf(buffer, sizeof(buffer), "%s\n      {\"name\": \"%s\", \"callsPerFrame\": %.2f, \"usPerCall\": %.4f}",
+                          first ? "" : ",", functions()[f].name, m_Run.calls[f] / frames,
+                          m_Run.nanoseconds[f] / 1000.0 / m_Run.calls[f]);
+            out << buffer;
+            first = false;
+        }
+        out << "\n    ],\n    \"topCallSites\": [";
+        first = true;
+        for (const Site& site : topSites(m_Run.sites)) {
+            std::snprintf(buffer, sizeof(buffer), "%s\n      {\"scope\": \"%s\", \"function\": \"%s\", \"callsPerFrame\": %.2f}",
+                          first ? "" : ",", scopeName(site.scope), functions()[site.function].name, site.calls / frames);
+            out << buffer;
+            first = false;
+        }
+        out << "\n    ]\n  }";
+    }
+
+private:
+    struct Function {
+        const char* name = "";
+        Category category = Query;
+    };
+    struct Counters {
+        unsigned long long calls[FUNCTION_COUNT];
+        unsigned long long nanoseconds[FUNCTION_COUNT];
+        unsigned long long sites[MAX_SITES][FUNCTION_COUNT];
+    };
+    struct Run {
+        unsigned long long frames = 0;
+        unsigned long long calls[FUNCTION_COUNT] = {};
+        unsigned long long nanoseconds[FUNCTION_COUNT] = {};
+        unsigned long long categoryCalls[CATEGORY_COUNT] = {};
+        unsigned long long categoryMax[CATEGORY_COUNT] = {};
+        unsigned long long sites[MAX_SITES][FUNCTION_COUNT] = {};
+    };
+    // the last frame as DrawWindow() shows it, with the scope names of its call sites
+    struct Shown {
+        Counters counters;
+        const char* scopes[MAX_SITES];
+    };
+    struct Site {
+        unsigned int scope;
+        unsigned int function;
+        unsigned long long calls;
+    };
+
+    GLStats() {
+        std::memset(&m_Current, 0, sizeof(Counters));
+        std::memset(&m_Last, 0, sizeof(Counters));
+        std::memset(&m_Shown, 0, sizeof(Shown));
+        std::memset(&m_Drawn, 0, sizeof(Shown));
+    }
+
+    static Function* functions() {
+        static Function table[FUNCTION_COUNT];
+        return table;
+    }
+    static const char* categoryName(Category category) {
+        static const char* names[] = {"draws", "programs", "textureBinds", "uniforms", "uploads", "state", "queries"};
+        return names[category];
+    }
+
+    // the wrapper of one entry point, the original pointer lives in a function local static of each instantiation
+    template<int Id, typename F>
+    struct Hook;
+    template<int Id, typename R, typename... A>
+    struct Hook<Id, R (APIENTRYP)(A...)> {
+        typedef R (APIENTRYP Pointer)(A...);
+        static Pointer& original() {
+            static Pointer pointer = NULL;
+            return pointer;
+        }
+        static R APIENTRY call(A... args) {
+            Timer timer(Id);
+            return original()(args...);
+        }
+    };
+    template<int Id, typename F>
+    void install(F& pointer, const char* name, Category category) {
+        if (!pointer)
+            return;
+        functions()[Id].name = name;
+        functions()[Id].category = category;
+        Hook<Id, F>::original() = pointer;
+        pointer = Hook<Id, F>::call;
+    }
+
+    // counts the call when it returns, attributed to the profiler scope it was made from
+    class Timer {
+    public:
+        explicit Timer(unsigned int function)
+                : m_Function(function), m_Start(std::chrono::steady_clock::now()) {}
+        ~Timer() {
+            GLStats& stats = Instance();
+            stats.m_Current.calls[m_Function]++;
+            stats.m_Current.nanoseconds[m_Function] += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - m_Start).count();
+            stats.m_Current.sites[stats.site()][m_Function]++;
+        }
+    private:
+        unsigned int m_Function;
+        std::chrono::steady_clock::time_point m_Start;
+    };
+
+    // scope names are string literals, so the pointer identifies them, site 0 collects calls outside of any scope
+    unsigned int site() {
+        const char* scope = Profiler::Instance().CurrentScope();
+        if (scope == m_CachedScope)
+            return m_CachedSite;
+        unsigned int index = 0;
+        if (scope) {
+            auto it = std::find(m_Scopes.begin(), m_Scopes.end(), scope);
+            if (it != m_Scopes.end()) {
+                index = (unsigned int) (it - m_Scopes.begin()) + 1;
+            } else if (m_Scopes.size() + 1 < MAX_SITES) {
+                m_Scopes.push_back(scope);
+                index = (unsigned int) m_Scopes.size();
+            }
+        }
+        m_CachedScope = scope;
+        m_CachedSite = index;
+        return index;
+    }
+    const char* scopeName(unsigned int site) const {
+        return site == 0 ? "(no scope)" : m_Scopes[site - 1];
+    }
+
+    static unsigned long long categoryCalls(const Counters& counters, Category category) {
+        unsigned long long calls = 0;
+        for (unsigned int f = 0; f < FUNCTION_COUNT; f++) {
+            if (functions()[f].category == category)
+                calls += counters.calls[f];
+        }
+        return calls;
+    }
+    // frame memory, drawing the window every frame doesn't allocate
+    static FrameVector<unsigned int> sortedFunctions(const unsigned long long (&calls)[FUNCTION_COUNT]) {
+        FrameVector<unsigned int> sorted;
+        sorted.reserve(FUNCTION_COUNT);
+        for (unsigned int f = 0; f < FUNCTION_COUNT; f++) {
+            if (calls[f])
+                sorted.push_back(f);
+        }
+        std::sort(sorted.begin(), sorted.end(), [&](unsigned int a, unsigned int b) { return calls[a] > calls[b]; });
+        return sorted;
+    }
+    static FrameVector<Site> topSites(const unsigned long long (&sites)[MAX_SITES][FUNCTION_COUNT]) {
+        FrameVector<Site> top;
+        top.reserve(MAX_SITES * FUNCTION_COUNT);
+        for (unsigned int s = 0; s < MAX_SITES; s++) {
+            for (unsigned int f = 0; f < FUNCTION_COUNT; f++) {
+                if (sites[s][f])
+                    top.push_back(Site{s, f, sites[s][f]});
+            }
+        }
+        std::sort(top.begin(), top.end(), [](const Site& a, const Site& b) { return a.calls > b.calls; });
+        if (top.size() > TOP_SITES)
+            top.resize(TOP_SITES);
+        return top;
+    }
+
+    Counters m_Current;
+    Counters m_Last;
+    Run m_Run;
+    std::mutex m_ShownMutex;
+    Shown m_Shown;
+    Shown m_Drawn; // the drawing thread's copy of m_Shown
+    std::vector<const char*> m_Scopes;
+    const char* m_CachedScope = NULL;
+    unsigned int m_CachedSite = 0;
+};
+
+};
+
+#endif //PROJECT_BASE_GLSTATS_H
@@ -0,0 +1,76 @@
+#ifndef PROJECT_BASE_GPUTIMER_H
+#define PROJECT_BASE_GPUTIMER_H
+
+#include <glad/glad.h>
+
+namespace rg {
+
+// Measures GPU time between Begin() and End() with GL_TIMESTAMP queries.
+// Results are read back a few frames later, only when the driver reports them as available,
+// so measuring never stalls the pipeline. Timestamps (unlike GL_TIME_ELAPSED) may be nested.
+class GpuTimer {
+public:
+    static const unsigned int LATENCY = 4;
+
+    GpuTimer() {
+        glGenQueries(2 * LATENCY, m_Queries);
+    }
+    ~GpuTimer() {
+        glDeleteQueries(2 * LATENCY, m_Queries);
+    }
+    GpuTimer(const GpuTimer&) = delete;
+    GpuTimer& operator=(const GpuTimer&) = delete;
+
+    void Begin() {
+        resolve();
+        // every slot is still in flight, drop this measurement instead of waiting for the GPU
+        m_Skipped = m_Pending[m_Write];
+        if (!m_Skipped)
+            glQueryCounter(m_Queries[2 * m_Write], GL_TIMESTAMP);
+    }
+    void End() {
+        if (m_Skipped)
+            return;
+        glQueryCounter(m_Queries[2 * m_Write + 1], GL_TIMESTAMP);
+        m_Pending[m_Write] = true;
+        m_Write = (m_Write + 1) % LATENCY;
+    }
+
+    // latest measurement that has finished on the GPU
+    float Milliseconds() {
+        resolve();
+        return m_LastMs;
+    }
+    // measurements read back so far, tells whether Milliseconds() is a new one
+    unsigned long Samples() const { return m_Samples; }
+
+private:
+    void resolve() {
+        for (unsigned int i = 0; i < LATENCY; i++) {
+            unsigned int slot = (m_Write + i) % LATENCY; // oldest first
+            if (!m_Pending[slot])
+                continue;
+            GLint available = 0;
+            glGetQueryObjectiv(m_Queries[2 * slot + 1], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                break;
+            GLuint64 start = 0, end = 0;
+            glGetQueryObjectui64v(m_Queries[2 * slot], GL_QUERY_RESULT, &start);
+            glGetQueryObjectui64v(m_Queries[2 * slot + 1], GL_QUERY_RESULT, &end);
+            m_LastMs = (end - start) / 1000000.0f;
+            m_Samples++;
+            m_Pending[slot] = false;
+        }
+    }
+
+    GLuint m_Queries[2 * LATENCY];
+    bool m_Pending[LATENCY] = {false};
+    unsigned int m_Write = 0;
+    bool m_Skipped = false;
+    float m_LastMs = 0.0f;
+    unsigned long m_Samples = 0;
+};
+
+};
+
+#endif //PROJECT_BASE_GPUTIMER_H
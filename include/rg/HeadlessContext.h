@@ -0,0 +1,112 @@
+#ifndef PROJECT_BASE_HEADLESSCONTEXT_H
+#define PROJECT_BASE_HEADLESSCONTEXT_H
+
+#include <glad/glad.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <rg/Log.h>
+#include <cstring>
+
+namespace rg {
+
+// OpenGL 3.3 core context without a window, used by the benchmark mode.
+// Prefers Mesa's surfaceless platform (works on llvmpipe without X or a GPU) and falls back to the default
+// display with a small pbuffer. Everything is rendered into framebuffer objects, so the surface is never drawn to.
+class HeadlessContext {
+public:
+    HeadlessContext() = default;
+    HeadlessContext(const HeadlessContext&) = delete;
+    HeadlessContext& operator=(const HeadlessContext&) = delete;
+    ~HeadlessContext() {
+        Destroy();
+    }
+
+    bool Create() {
+        m_Display = getDisplay();
+        if (m_Display == EGL_NO_DISPLAY || !eglInitialize(m_Display, NULL, NULL)) {
+            LOG_ERROR(GL, "Failed to initialize an EGL display");
+            return false;
+        }
+        if (!eglBindAPI(EGL_OPENGL_API)) {
+            LOG_ERROR(GL, "EGL display doesn't support desktop OpenGL");
+            return false;
+        }
+        const EGLint configAttributes[] = {
+                EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+                EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+                EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+                EGL_DEPTH_SIZE, 24,
+                EGL_NONE
+        };
+        EGLConfig config;
+        EGLint configCount = 0;
+        if (!eglChooseConfig(m_Display, configAttributes, &config, 1, &configCount) || configCount == 0) {
+            // the surfaceless platform doesn't have to expose pbuffer configs, any GL config does there
+            const EGLint anyAttributes[] = {EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+            if (!eglChooseConfig(m_Display, anyAttributes, &config, 1, &configCount) || configCount == 0) {
+                LOG_ERROR(GL, "No EGL config with OpenGL support");
+                return false;
+            }
+        }
+        const EGLint contextAttributes[] = {
+                EGL_CONTEXT_MAJOR_VERSION, 3,
+                EGL_CONTEXT_MINOR_VERSION, 3,
+                EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+#ifndef NDEBUG
+                EGL_CONTEXT_OPENGL_DEBUG, EGL_TRUE,
+#endif
+                EGL_NONE
+        };
+        m_Context = eglCreateContext(m_Display, config, EGL_NO_CONTEXT, contextAttributes);
+        if (m_Context == EGL_NO_CONTEXT) {
+            LOG_ERROR(GL, "Failed to create an OpenGL 3.3 core context");
+            return false;
+        }
+        // EGL_KHR_surfaceless_context lets us skip the surface entirely
+        if (!eglMakeCurrent(m_Display, EGL_NO_SURFACE, EGL_NO_SURFACE, m_Context)) {
+            const EGLint pbufferAttributes[] = {EGL_WIDTH, 16, EGL_HEIGHT, 16, EGL_NONE};
+            m_Surface = eglCreatePbufferSurface(m_Display, config, pbufferAttributes);
+            if (m_Surface == EGL_NO_SURFACE || !eglMakeCurrent(m_Display, m_Surface, m_Surface, m_Context)) {
+                LOG_ERROR(GL, "Failed to make the headless context current");
+                return false;
+            }
+        }
+        return gladLoadGLLoader((GLADloadproc) eglGetProcAddress) != 0;
+    }
+
+    void Destroy() {
+        if (m_Display == EGL_NO_DISPLAY)
+            return;
+        eglMakeCurrent(m_Display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (m_Surface != EGL_NO_SURFACE)
+            eglDestroySurface(m_Display, m_Surface);
+        if (m_Context != EGL_NO_CONTEXT)
+            eglDestroyContext(m_Display, m_Context);
+        eglTerminate(m_Display);
+        m_Display = EGL_NO_DISPLAY;
+        m_Surface = EGL_NO_SURFACE;
+        m_Context = EGL_NO_CONTEXT;
+    }
+
+private:
+    static EGLDisplay getDisplay() {
+        const char* extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+        if (extensions && std::strstr(extensions, "EGL_MESA_platform_surfaceless")) {
+            auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+            if (getPlatformDisplay) {
+                EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+                if (display != EGL_NO_DISPLAY)
+                    return display;
+            }
+        }
+        return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+
+    EGLDisplay m_Display = EGL_NO_DISPLAY;
+    EGLSurface m_Surface = EGL_NO_SURFACE;
+    EGLContext m_Context = EGL_NO_CONTEXT;
+};
+
+};
+
+#endif //PROJECT_BASE_HEADLESSCONTEXT_H
@@ -0,0 +1,313 @@
+#ifndef PROJECT_BASE_INPUTRECORDER_H
+#define PROJECT_BASE_INPUTRECORDER_H
+
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#include <learnopengl/camera.h>
+#include <rg/Log.h>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <string>
+
+namespace rg {
+
+// Records everything that drives the simulation into a compact binary file and feeds it back on replay.
+// The stream is a sequence of tagged events, every frame starts with a FRAME marker:
+//   FRAME, KEY_STATE* (polled keys that changed), GAME* (shuffle seeds, picked cards),
+//   CHECKPOINT (camera and game state after the frame), KEY/MOUSE/SCROLL* (callbacks from glfwPollEvents)
+// Recording and replay both run the simulation with a fixed time step, so a replay reproduces the
+// recorded session exactly. Every checkpoint is compared on replay and divergent frames are reported.
+class InputRecorder {
+public:
+    enum class Mode {
+        Off,
+        Record,
+        Replay
+    };
+    enum GameEvent : uint8_t {
+        SHUFFLE = 0,
+        PICK = 1
+    };
+
+    InputRecorder() = default;
+    InputRecorder(const InputRecorder&) = delete;
+    InputRecorder& operator=(const InputRecorder&) = delete;
+    ~InputRecorder() {
+        Close();
+    }
+
+    bool StartRecording(const std::string& path, float timestep) {
+        m_Out.open(path, std::ios::binary | std::ios::trunc);
+        if (!m_Out)
+            return false;
+        Header header;
+        header.timestep = timestep;
+        write(header);
+        m_Mode = Mode::Record;
+        return true;
+    }
+    bool StartReplay(const std::string& path) {
+        m_In.open(path, std::ios::binary);
+        Header header;
+        if (!m_In || !read(header) || header.magic != MAGIC || header.version != VERSION) {
+            LOG_ERROR(Input, "Not a recording: %s", path.c_str());
+            return false;
+        }
+        if (header.frames == 0) {
+            LOG_ERROR(Input, "Recording wasn't finished: %s", path.c_str());
+            return false;
+        }
+        m_Frames = header.frames;
+        m_Timestep = header.timestep;
+        m_Mode = Mode::Replay;
+        return true;
+    }
+    // writes the frame count into the header of a recording, or reports how a replay went
+    void Close() {
+        if (m_Mode == Mode::Record) {
+            m_Out.seekp(offsetof(Header, frames));
+            write(m_Frame);
+            m_Out.close();
+            LOG_INFO(Input, "Recorded %u frames", m_Frame);
+        } else if (m_Mode == Mode::Replay) {
+            m_In.close();
+            LOG_INFO(Input, "Replayed %u of %u frames, %u diverged", m_Frame, m_Frames, m_DivergedFrames);
+        }
+        m_Mode = Mode::Off;
+    }
+
+    Mode GetMode() const { return m_Mode; }
+    bool Recording() const { return m_Mode == Mode::Record; }
+    bool Replaying() const { return m_Mode == Mode::Replay; }
+    unsigned int Frames() const { return m_Frames; }
+    float Timestep() const { return m_Timestep; }
+
+    // called before the input of a frame is processed, returns false once a replay ran out of frames
+    bool BeginFrame(GLFWwindow* window) {
+        if (m_Mode == Mode::Record) {
+            put(FRAME);
+            write(m_Frame);
+        } else if (m_Mode == Mode::Replay) {
+            // callbacks that arrived before the first frame (while the shaders were compiling)
+            dispatchCallbacks(window);
+            uint32_t frame;
+            if (m_In.peek() != FRAME || !skip(1) || !read(frame))
+                return false;
+            m_PendingSeeds.clear();
+            for (int type = m_In.peek(); type == KEY_STATE || type == GAME; type = m_In.peek()) {
+                skip(1);
+                if (type == KEY_STATE) {
+                    KeyState state;
+                    if (!read(state) || state.key < 0 || state.key > GLFW_KEY_LAST) {
+                        LOG_ERROR(Input, "Invalid key state in frame %u of the recording, stopping the replay", frame);
+                        return false;
+                    }
+                    m_Keys[state.key] = state.down != 0;
+                } else {
+                    Game game;
+                    read(game);
+                    if (game.kind == SHUFFLE)
+                        m_PendingSeeds.push_back(game.value);
+                }
+            }
+        }
+        return true;
+    }
+    // called after the frame was simulated, before the window events are polled
+    void EndFrame(const Camera& camera, uint32_t gameHash) {
+        Checkpoint checkpoint;
+        checkpoint.position = camera.Position;
+        checkpoint.yaw = camera.Yaw;
+        checkpoint.pitch = camera.Pitch;
+        checkpoint.zoom = camera.Zoom;
+        checkpoint.gameHash = gameHash;
+        if (m_Mode == Mode::Record) {
+            put(CHECKPOINT);
+            write(checkpoint);
+        } else if (m_Mode == Mode::Replay) {
+            Checkpoint recorded;
+            if (m_In.peek() == CHECKPOINT && skip(1) && read(recorded) &&
+                std::memcmp(&recorded, &checkpoint, sizeof(Checkpoint)) != 0) {
+                if (m_DivergedFrames == 0)
+                    LOG_WARNING(Input, "Replay diverged at frame %u", m_Frame);
+                m_DivergedFrames++;
+            }
+        }
+        if (m_Mode != Mode::Off)
+            m_Frame++;
+    }
+    // on replay hands the recorded window events of this frame to the callbacks, takes the place of glfwPollEvents
+    void Poll(GLFWwindow* window) {
+        if (m_Mode == Mode::Replay)
+            dispatchCallbacks(window);
+    }
+
+    // replaces glfwGetKey(window, key) == GLFW_PRESS for keys that drive the simulation
+    bool KeyDown(GLFWwindow* window, int key) {
+        if (m_Mode == Mode::Replay)
+            return m_Keys[key];
+        bool down = glfwGetKey(window, key) == GLFW_PRESS;
+        if (m_Mode == Mode::Record && down != m_Keys[key]) {
+            put(KEY_STATE);
+            write(KeyState{(int16_t) key, (uint8_t) down});
+        }
+        m_Keys[key] = down;
+        return down;
+    }
+
+    // the callbacks call these first and return when they get false: live events are ignored during a replay
+    bool OnKey(int key, int scancode, int action, int mods) {
+        if (m_Mode == Mode::Record) {
+            put(KEY);
+            write(Key{(int16_t) key, (int16_t) scancode, (uint8_t) action, (uint8_t) mods});
+        }
+        return m_Mode != Mode::Replay || m_Dispatching;
+    }
+    bool OnMouse(double x, double y) {
+        if (m_Mode == Mode::Record) {
+            put(MOUSE);
+            write(Vec2{x, y});
+        }
+        return m_Mode != Mode::Replay || m_Dispatching;
+    }
+    bool OnScroll(double x, double y) {
+        if (m_Mode == Mode::Record) {
+            put(SCROLL);
+            write(Vec2{x, y});
+        }
+        return m_Mode != Mode::Replay || m_Dispatching;
+    }
+
+    // seed for the card shuffle, a replay gets the recorded one back
+    unsigned int ShuffleSeed(unsigned int seed) {
+        if (m_Mode == Mode::Replay && !m_PendingSeeds.empty()) {
+            seed = m_PendingSeeds.front();
+            m_PendingSeeds.pop_front();
+        }
+        Event(SHUFFLE, seed);
+        return seed;
+    }
+    void Event(GameEvent kind, uint32_t value) {
+        if (m_Mode == Mode::Record) {
+            put(GAME);
+            write(Game{kind, value});
+        }
+    }
+
+    void SetCallbacks(GLFWkeyfun key, GLFWcursorposfun mouse, GLFWscrollfun scroll) {
+        m_KeyCallback = key;
+        m_MouseCallback = mouse;
+        m_ScrollCallback = scroll;
+    }
+
+    // 32 bit FNV-1a, used to fingerprint the game state in the checkpoints
+    static uint32_t Hash(const void* data, size_t size, uint32_t seed = 2166136261u) {
+        const unsigned char* bytes = (const unsigned char*) data;
+        for (size_t i = 0; i < size; i++) {
+            seed ^= bytes[i];
+            seed *= 16777619u;
+        }
+        return seed;
+    }
+
+private:
+    static const uint32_t MAGIC = 0x43455247; // "GREC"
+    static const uint32_t VERSION = 1;
+
+    enum Type : uint8_t {
+        FRAME = 0,
+        KEY_STATE,
+        KEY,
+        MOUSE,
+        SCROLL,
+        GAME,
+        CHECKPOINT
+    };
+
+#pragma pack(push, 1)
+    struct Header {
+        uint32_t magic = MAGIC;
+        uint32_t version = VERSION;
+        uint32_t frames = 0;
+        float timestep = 0.0f;
+    };
+    struct KeyState {
+        int16_t key;
+        uint8_t down;
+    };
+    struct Key {
+        int16_t key;
+        int16_t scancode;
+        uint8_t action;
+        uint8_t mods;
+    };
+    struct Vec2 {
+        double x, y;
+    };
+    struct Game {
+        uint8_t kind;
+        uint32_t value;
+    };
+    struct Checkpoint {
+        glm::vec3 position;
+        float yaw, pitch, zoom;
+        uint32_t gameHash;
+    };
+#pragma pack(pop)
+
+    void dispatchCallbacks(GLFWwindow* window) {
+        m_Dispatching = true;
+        for (int type = m_In.peek(); type == KEY || type == MOUSE || type == SCROLL; type = m_In.peek()) {
+            skip(1);
+            if (type == KEY) {
+                Key key;
+                read(key);
+                if (m_KeyCallback)
+                    m_KeyCallback(window, key.key, key.scancode, key.action, key.mods);
+            } else {
+                Vec2 value;
+                read(value);
+                GLFWcursorposfun callback = type == MOUSE ? m_MouseCallback : m_ScrollCallback;
+                if (callback)
+                    callback(window, value.x, value.y);
+            }
+        }
+        m_Dispatching = false;
+    }
+
+    void put(Type type) {
+        m_Out.put((char) type);
+    }
+    template<typename T>
+    void write(const T& value) {
+        m_Out.write((const char*) &value, sizeof(T));
+    }
+    template<typename T>
+    bool read(T& value) {
+        return (bool) m_In.read((char*) &value, sizeof(T));
+    }
+    bool skip(std::streamsize bytes) {
+        return (bool) m_In.ignore(bytes);
+    }
+
+    Mode m_Mode = Mode::Off;
+    std::ofstream m_Out;
+    std::ifstream m_In;
+    uint32_t m_Frame = 0;
+    uint32_t m_Frames = 0;
+    float m_Timestep = 0.0f;
+    unsigned int m_DivergedFrames = 0;
+    bool m_Keys[GLFW_KEY_LAST + 1] = {};
+    std::deque<uint32_t> m_PendingSeeds;
+    bool m_Dispatching = false;
+    GLFWkeyfun m_KeyCallback = NULL;
+    GLFWcursorposfun m_MouseCallback = NULL;
+    GLFWscrollfun m_ScrollCallback = NULL;
+};
+
+};
+
+#endif //PROJECT_BASE_INPUTRECORDER_H
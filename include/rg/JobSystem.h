@@ -0,0 +1,430 @@
+#ifndef PROJECT_BASE_JOBSYSTEM_H
+#define PROJECT_BASE_JOBSYSTEM_H
+
+#include <rg/AllocationTracker.h>
+#include <rg/Log.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace rg {
+
+class JobSystem;
+struct Job;
+
+// Counts the unfinished jobs it was passed to. Jobs can be made to wait for a counter, they are scheduled when it
+// drops to zero. Call JobSystem::Wait before a counter goes out of scope.
+class JobCounter {
+public:
+    JobCounter() = default;
+    JobCounter(const JobCounter&) = delete;
+    JobCounter& operator=(const JobCounter&) = delete;
+
+    bool Done() const { return m_Pending.load(std::memory_order_acquire) == 0; }
+
+private:
+    friend class JobSystem;
+    std::atomic<int> m_Pending{0};
+    // guards the list of waiting jobs and the last decrement
+    std::mutex m_Mutex;
+    Job* m_Waiting = nullptr;
+};
+
+// A unit of work: the callable is stored inline, so scheduling a job never allocates.
+struct Job {
+    static const size_t DATA_SIZE = 88;
+
+    void (*function)(Job&);
+    JobCounter* counter;
+    Job* next;
+    bool glThread;
+    // from submit until execute is done with it, the slot can't be reused before
+    std::atomic<bool> busy{false};
+    alignas(std::max_align_t) unsigned char data[DATA_SIZE];
+};
+
+// Work stealing job system shared by the loaders and the CPU side of the frame.
+// Every worker, the main thread and attached threads (the render thread) own a fixed size deque (Chase-Lev): the
+// owner pushes and pops at the bottom, idle threads steal from the top of a random victim. Jobs that touch GL are
+// queued for the GL thread, the one the context is current on (the main thread until another one calls
+// SetGLThread), which runs them from RunGLThreadJobs() and while it waits on a counter. Threads that aren't part of
+// the system run the jobs they submit inline. With no workers (single core) everything runs inline.
+class JobSystem {
+public:
+    static const unsigned int MAX_WORKERS = 31;
+    static const unsigned int MAX_ATTACHED = 2;
+
+    static JobSystem& Instance() {
+        static JobSystem jobs;
+        return jobs;
+    }
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+    ~JobSystem() {
+        Shutdown();
+    }
+
+    // on the main thread, -1 uses a worker per core besides the main thread
+    void Start(int workers = -1) {
+        Shutdown();
+        if (workers < 0)
+            workers = (int) std::thread::hardware_concurrency() - 1;
+        workers = workers < 0 ? 0 : workers > (int) MAX_WORKERS ? (int) MAX_WORKERS : workers;
+        m_Threads.reset(new ThreadData[workers + 1 + MAX_ATTACHED]);
+        m_ThreadCount = workers + 1 + MAX_ATTACHED;
+        m_WorkerCount = workers;
+        m_Attached.store(0);
+        m_GLThread.store(0);
+        threadIndex() = 0;
+        m_Stop.store(false);
+        for (int i = 1; i <= workers; i++)
+            m_Workers.emplace_back(&JobSystem::workerLoop, this, i);
+        m_Started = true;
+        LOG_INFO(General, "Job system started with %d workers", workers);
+    }
+    void Shutdown() {
+        if (!m_Started)
+            return;
+        {
+            std::lock_guard<std::mutex> lock(m_SleepMutex);
+            m_Stop.store(true);
+        }
+        m_Wake.notify_all();
+        for (std::thread& worker : m_Workers)
+            worker.join();
+        m_Workers.clear();
+        // whatever is still queued for the GL thread runs now, the caller has to have the context
+        RunGLThreadJobs();
+        m_Threads.reset();
+        m_ThreadCount = 0;
+        m_WorkerCount = 0;
+        m_Started = false;
+    }
+
+    unsigned int WorkerCount() const { return m_WorkerCount; }
+
+    // makes the calling thread part of the system, so it can wait on counters and split work with ParallelFor.
+    // False when all MAX_ATTACHED slots are taken, the thread then keeps running its jobs inline.
+    bool AttachThread() {
+        if (!m_Started || threadIndex() >= 0)
+            return threadIndex() >= 0;
+        unsigned int slot = m_Attached.fetch_add(1);
+        if (slot >= MAX_ATTACHED)
+            return false;
+        threadIndex() = (int) (m_WorkerCount + 1 + slot);
+        return true;
+    }
+    // the calling thread (main or attached) runs the GL jobs from now on, call it after making the context current
+    void SetGLThread() {
+        if (threadIndex() >= 0)
+            m_GLThread.store(threadIndex());
+    }
+
+    // schedules f(), counter (optional) counts it as pending, the job starts once after (optional) is done
+    template<typename F>
+    void Run(F&& f, JobCounter* counter = nullptr, JobCounter* after = nullptr) {
+        submit(std::forward<F>(f), counter, after, false);
+    }
+    // f() runs on the GL thread, for everything that touches GL
+    template<typename F>
+    void RunOnGLThread(F&& f, JobCounter* counter = nullptr, JobCounter* after = nullptr) {
+        submit(std::forward<F>(f), counter, after, true);
+    }
+
+    // runs other jobs until the counter is done, the GL thread also runs its own queue meanwhile
+    void Wait(JobCounter& counter) {
+        while (!counter.Done()) {
+            if (!runOne())
+                std::this_thread::yield();
+        }
+        // the last job may still be releasing its dependents, after this it's done with the counter
+        std::lock_guard<std::mutex> lock(counter.m_Mutex);
+    }
+
+    // f(begin, end) over [0, count) in chunks of grain elements, returns when all of them are done.
+    // Runs inline when the range fits into one chunk.
+    template<typename F>
+    void ParallelFor(size_t count, size_t grain, const F& f) {
+        if (grain == 0)
+            grain = 1;
+        if (count <= grain || WorkerCount() == 0 || threadIndex() < 0) {
+            f((size_t) 0, count);
+            return;
+        }
+        JobCounter counter;
+        for (size_t begin = 0; begin < count; begin += grain) {
+            size_t end = begin + grain < count ? begin + grain : count;
+            Run([&f, begin, end]() { f(begin, end); }, &counter);
+        }
+        Wait(counter);
+    }
+
+    // GL thread, runs the GL jobs queued so far
+    void RunGLThreadJobs() {
+        while (Job* job = popGLThread())
+            execute(job);
+    }
+
+private:
+    static const size_t CAPACITY = 4096; // power of two, jobs in flight per thread
+    static const size_t MASK = CAPACITY - 1;
+
+    // Chase-Lev deque with a fixed capacity, see "Correct and Efficient Work-Stealing for Weak Memory Models"
+    class Deque {
+    public:
+        // owner only, false when full
+        bool Push(Job* job) {
+            int64_t bottom = m_Bottom.load(std::memory_order_relaxed);
+            int64_t top = m_Top.load(std::memory_order_acquire);
+            if (bottom - top >= (int64_t) CAPACITY)
+                return false;
+            m_Jobs[bottom & MASK].store(job, std::memory_order_relaxed);
+            m_Bottom.store(bottom + 1, std::memory_order_release);
+            return true;
+        }
+        // owner only
+        Job* Pop() {
+            int64_t bottom = m_Bottom.load(std::memory_order_relaxed) - 1;
+            m_Bottom.store(bottom, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t top = m_Top.load(std::memory_order_relaxed);
+            if (top > bottom) {
+                m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+                return nullptr;
+            }
+            Job* job = m_Jobs[bottom & MASK].load(std::memory_order_relaxed);
+            if (top == bottom) {
+                // last job, race the thieves for it
+                if (!m_Top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                    job = nullptr;
+                m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+            }
+            return job;
+        }
+        // any thread
+        Job* Steal() {
+            int64_t top = m_Top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t bottom = m_Bottom.load(std::memory_order_acquire);
+            if (top >= bottom)
+                return nullptr;
+            Job* job = m_Jobs[top & MASK].load(std::memory_order_relaxed);
+            if (!m_Top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                return nullptr;
+            return job;
+        }
+
+    private:
+        std::atomic<int64_t> m_Top{0};
+        // thieves and the owner write different cache lines
+        char m_Padding[64];
+        std::atomic<int64_t> m_Bottom{0};
+        std::atomic<Job*> m_Jobs[CAPACITY];
+    };
+
+    struct ThreadData {
+        Deque deque;
+        // jobs are taken round robin, a slot is reused after CAPACITY newer jobs of the same thread
+        Job pool[CAPACITY];
+        size_t next = 0;
+        uint32_t random = 0;
+    };
+
+    JobSystem() = default;
+
+    // -1 for threads that aren't part of the system, 0 for the main thread, attached threads come after the workers
+    static int& threadIndex() {
+        thread_local int index = -1;
+        return index;
+    }
+
+    template<typename F>
+    static void invoke(Job& job) {
+        F& f = *reinterpret_cast<F*>(job.data);
+        f();
+        f.~F();
+    }
+
+    template<typename F>
+    void submit(F&& f, JobCounter* counter, JobCounter* after, bool glThread) {
+        typedef typename std::decay<F>::type Callable;
+        static_assert(sizeof(Callable) <= Job::DATA_SIZE, "job captures too much, capture a pointer instead");
+        int index = threadIndex();
+        if (index < 0 || !m_Started) {
+            // not one of ours, runs right here
+            if (after)
+                Wait(*after);
+            f();
+            return;
+        }
+        ThreadData& thread = m_Threads[index];
+        Job* job = &thread.pool[thread.next & MASK];
+        if (job->busy.load(std::memory_order_acquire)) {
+            // the job CAPACITY submissions ago still waits, is queued or runs, it keeps its slot and this one runs here
+            if (after)
+                Wait(*after);
+            f();
+            return;
+        }
+        thread.next++;
+        job->busy.store(true, std::memory_order_relaxed);
+        new(job->data) Callable(std::forward<F>(f));
+        job->function = &invoke<Callable>;
+        job->counter = counter;
+        job->next = nullptr;
+        job->glThread = glThread;
+        if (counter)
+            counter->m_Pending.fetch_add(1, std::memory_order_relaxed);
+        if (after) {
+            std::lock_guard<std::mutex> lock(after->m_Mutex);
+            if (!after->Done()) {
+                job->next = after->m_Waiting;
+                after->m_Waiting = job;
+                return;
+            }
+        }
+        schedule(job);
+    }
+
+    void schedule(Job* job) {
+        if (job->glThread) {
+            pushGLThread(job);
+        } else if (!m_Threads[threadIndex()].deque.Push(job)) {
+            // deque full, no point in queueing it behind CAPACITY others
+            execute(job);
+            return;
+        }
+        m_Work.fetch_add(1);
+        if (m_Sleeping.load() > 0) {
+            std::lock_guard<std::mutex> lock(m_SleepMutex);
+            m_Wake.notify_one();
+        }
+    }
+
+    void execute(Job* job) {
+        job->function(*job);
+        JobCounter* counter = job->counter;
+        job->busy.store(false, std::memory_order_release);
+        if (!counter)
+            return;
+        int pending = counter->m_Pending.load(std::memory_order_relaxed);
+        while (pending > 1) {
+            if (counter->m_Pending.compare_exchange_weak(pending, pending - 1, std::memory_order_acq_rel))
+                return;
+        }
+        // the last one, under the lock so Wait() can't return before the dependents are taken off the counter
+        Job* waiting;
+        {
+            std::lock_guard<std::mutex> lock(counter->m_Mutex);
+            waiting = counter->m_Waiting;
+            counter->m_Waiting = nullptr;
+            counter->m_Pending.fetch_sub(1, std::memory_order_release);
+        }
+        while (waiting) {
+            Job* next = waiting->next;
+            schedule(waiting);
+            waiting = next;
+        }
+    }
+
+    // one job from the GL thread queue (GL thread only), the own deque or a random victim
+    bool runOne() {
+        int index = threadIndex();
+        if (index < 0)
+            return false;
+        Job* job = index == m_GLThread.load(std::memory_order_relaxed) ? popGLThread() : nullptr;
+        if (!job)
+            job = m_Threads[index].deque.Pop();
+        if (!job)
+            job = steal(index);
+        if (!job)
+            return false;
+        execute(job);
+        return true;
+    }
+    Job* steal(int thief) {
+        if (m_ThreadCount < 2)
+            return nullptr;
+        // xorshift, a fixed order would make every thief start at the same victim
+        uint32_t& random = m_Threads[thief].random;
+        random = random ? random : 2463534242u + thief;
+        random ^= random << 13;
+        random ^= random >> 17;
+        random ^= random << 5;
+        unsigned int start = random % m_ThreadCount;
+        for (unsigned int i = 0; i < m_ThreadCount; i++) {
+            unsigned int victim = (start + i) % m_ThreadCount;
+            if ((int) victim == thief)
+                continue;
+            if (Job* job = m_Threads[victim].deque.Steal())
+                return job;
+        }
+        return nullptr;
+    }
+
+    void pushGLThread(Job* job) {
+        for (;;) {
+            {
+                std::lock_guard<std::mutex> lock(m_GLMutex);
+                if (m_GLTail - m_GLHead < CAPACITY) {
+                    m_GLJobs[m_GLTail++ & MASK] = job;
+                    return;
+                }
+            }
+            // full, the GL thread has to catch up first
+            std::this_thread::yield();
+        }
+    }
+    Job* popGLThread() {
+        std::lock_guard<std::mutex> lock(m_GLMutex);
+        if (m_GLHead == m_GLTail)
+            return nullptr;
+        return m_GLJobs[m_GLHead++ & MASK];
+    }
+
+    void workerLoop(int index) {
+        threadIndex() = index;
+        AllocationTracker::NameThread("Job worker");
+        while (!m_Stop.load()) {
+            unsigned long long work = m_Work.load();
+            if (runOne())
+                continue;
+            // nothing to run or steal, sleep until something gets scheduled
+            std::unique_lock<std::mutex> lock(m_SleepMutex);
+            m_Sleeping.fetch_add(1);
+            m_Wake.wait(lock, [&]() { return m_Work.load() != work || m_Stop.load(); });
+            m_Sleeping.fetch_sub(1);
+        }
+    }
+
+    std::unique_ptr<ThreadData[]> m_Threads;
+    unsigned int m_ThreadCount = 0;
+    unsigned int m_WorkerCount = 0;
+    bool m_Started = false;
+    std::vector<std::thread> m_Workers;
+    std::atomic<unsigned int> m_Attached{0};
+
+    std::atomic<int> m_GLThread{0};
+    std::mutex m_GLMutex;
+    Job* m_GLJobs[CAPACITY];
+    size_t m_GLHead = 0;
+    size_t m_GLTail = 0;
+
+    std::atomic<unsigned long long> m_Work{0};
+    std::atomic<int> m_Sleeping{0};
+    std::atomic<bool> m_Stop{false};
+    std::mutex m_SleepMutex;
+    std::condition_variable m_Wake;
+};
+
+};
+
+#endif //PROJECT_BASE_JOBSYSTEM_H
@@ -0,0 +1,337 @@
+#ifndef PROJECT_BASE_LOG_H
+#define PROJECT_BASE_LOG_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// compile time filtering, everything below LOG_LEVEL compiles to nothing
+#define LOG_LEVEL_TRACE 0
+#define LOG_LEVEL_DEBUG 1
+#define LOG_LEVEL_INFO 2
+#define LOG_LEVEL_WARNING 3
+#define LOG_LEVEL_ERROR 4
+#define LOG_LEVEL_OFF 5
+#ifndef LOG_LEVEL
+#ifdef NDEBUG
+#define LOG_LEVEL LOG_LEVEL_INFO
+#else
+#define LOG_LEVEL LOG_LEVEL_DEBUG
+#endif
+#endif
+
+// LOG_INFO(Shader, "compiled %s", name): the category is a name from rg::LogCategory, the rest is printf style.
+// Every call site owns a rate limiter, so info and below issued every frame can't flood the output;
+// warnings and errors always pass.
+#define LOG_AT(level, category, ...) \
+do { static rg::LogSite logSite_; rg::Logger::Instance().Write(logSite_, level, rg::LogCategory::category, __FILE__, __LINE__, __VA_ARGS__); } while (0)
+
+#if LOG_LEVEL <= LOG_LEVEL_TRACE
+#define LOG_TRACE(category, ...) LOG_AT(rg::LogLevel::Trace, category, __VA_ARGS__)
+#else
+#define LOG_TRACE(category, ...) do {} while (0)
+#endif
+#if LOG_LEVEL <= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(category, ...) LOG_AT(rg::LogLevel::Debug, category, __VA_ARGS__)
+#else
+#define LOG_DEBUG(category, ...) do {} while (0)
+#endif
+#if LOG_LEVEL <= LOG_LEVEL_INFO
+#define LOG_INFO(category, ...) LOG_AT(rg::LogLevel::Info, category, __VA_ARGS__)
+// info without the rate limit, for reports that print a table from one call site
+#define LOG_REPORT(category, ...) \
+do { static rg::LogSite logSite_(UINT32_MAX); rg::Logger::Instance().Write(logSite_, rg::LogLevel::Info, rg::LogCategory::category, __FILE__, __LINE__, __VA_ARGS__); } while (0)
+#else
+#define LOG_INFO(category, ...) do {} while (0)
+#define LOG_REPORT(category, ...) do {} while (0)
+#endif
+#if LOG_LEVEL <= LOG_LEVEL_WARNING
+#define LOG_WARNING(category, ...) LOG_AT(rg::LogLevel::Warning, category, __VA_ARGS__)
+#else
+#define LOG_WARNING(category, ...) do {} while (0)
+#endif
+#if LOG_LEVEL <= LOG_LEVEL_ERROR
+#define LOG_ERROR(category, ...) LOG_AT(rg::LogLevel::Error, category, __VA_ARGS__)
+#else
+#define LOG_ERROR(category, ...) do {} while (0)
+#endif
+
+namespace rg {
+
+enum class LogLevel : uint8_t {
+    Trace,
+    Debug,
+    Info,
+    Warning,
+    Error
+};
+
+enum class LogCategory : uint8_t {
+    General,
+    GL,
+    Shader,
+    Assets,
+    Render,
+    Input,
+    Benchmark,
+    Startup,
+    Count
+};
+
+// rate limiter of one call site: LIMIT messages per second pass, the rest is counted and reported with the next one
+struct LogSite {
+    static const uint32_t LIMIT = 5;
+    constexpr explicit LogSite(uint32_t limit = LIMIT) : limit(limit) {}
+    const uint32_t limit;
+    std::atomic<int64_t> windowStart{0};
+    std::atomic<uint32_t> count{0};
+    std::atomic<uint32_t> suppressed{0};
+};
+
+// Asynchronous logger. Producers format the message text into a slot of a bounded lock-free ring buffer
+// (multiple producers, one consumer) and return, a background thread adds the decoration and does the I/O.
+// When the ring is full the message is dropped and counted instead of blocking the frame.
+class Logger {
+public:
+    static Logger& Instance() {
+        static Logger logger;
+        return logger;
+    }
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+    ~Logger() {
+        Shutdown();
+    }
+
+    // runtime filter on top of LOG_LEVEL
+    void SetLevel(LogLevel level) { m_Level.store((uint8_t) level, std::memory_order_relaxed); }
+    // also append everything to a file
+    void SetFile(const std::string& path) {
+        std::lock_guard<std::mutex> lock(m_FileMutex);
+        m_File.close();
+        m_File.open(path, std::ios::trunc);
+    }
+
+#ifdef __GNUC__
+    __attribute__((format(printf, 7, 8)))
+#endif
+    void Write(LogSite& site, LogLevel level, LogCategory category, const char* file, int line, const char* format, ...) {
+        if ((uint8_t) level < m_Level.load(std::memory_order_relaxed))
+            return;
+        int64_t now = microseconds();
+        uint32_t suppressed = 0;
+        if (level < LogLevel::Warning && !passRateLimit(site, now, suppressed))
+            return;
+        Cell* cell = acquire();
+        if (!cell) {
+            m_Dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        Record& record = cell->record;
+        record.time = now;
+        record.level = level;
+        record.category = category;
+        record.thread = threadIndex();
+        record.file = file;
+        record.line = line;
+        record.suppressed = suppressed;
+        record.longMessage = NULL;
+        va_list args, retry;
+        va_start(args, format);
+        va_copy(retry, args);
+        int length = std::vsnprintf(record.message, sizeof(record.message), format, args);
+        // text that doesn't fit the slot (shader info logs) goes to the heap, the consumer frees it
+        if (length >= (int) sizeof(record.message)) {
+            record.longMessage = new char[length + 1];
+            std::vsnprintf(record.longMessage, length + 1, format, retry);
+        }
+        va_end(retry);
+        va_end(args);
+        publish(cell);
+        if (!m_Running.load(std::memory_order_acquire))
+            start();
+    }
+
+    // drains the queue and stops the background thread, later messages start it again
+    void Shutdown() {
+        std::thread worker;
+        {
+            std::lock_guard<std::mutex> lock(m_StartMutex);
+            if (!m_Running.load(std::memory_order_acquire))
+                return;
+            m_Stop.store(true, std::memory_order_release);
+            worker.swap(m_Worker);
+        }
+        worker.join();
+        m_Running.store(false, std::memory_order_release);
+    }
+
+    unsigned long long Dropped() const { return m_Dropped.load(std::memory_order_relaxed); }
+
+private:
+    static const size_t CAPACITY = 1024; // power of two
+    static const size_t MESSAGE_SIZE = 224;
+
+    struct Record {
+        int64_t time;
+        LogLevel level;
+        LogCategory category;
+        uint16_t thread;
+        uint32_t suppressed;
+        const char* file;
+        int line;
+        char* longMessage; // owned, replaces message when set
+        char message[MESSAGE_SIZE];
+    };
+    struct Cell {
+        std::atomic<size_t> sequence;
+        Record record;
+    };
+
+    Logger() : m_Epoch(std::chrono::steady_clock::now()) {
+        for (size_t i = 0; i < CAPACITY; i++)
+            m_Cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    int64_t microseconds() const {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_Epoch).count();
+    }
+    static uint16_t threadIndex() {
+        static std::atomic<uint16_t> next{0};
+        thread_local uint16_t index = next.fetch_add(1, std::memory_order_relaxed);
+        return index;
+    }
+
+    static bool passRateLimit(LogSite& site, int64_t now, uint32_t& suppressed) {
+        int64_t start = site.windowStart.load(std::memory_order_relaxed);
+        if (now - start >= 1000000 && site.windowStart.compare_exchange_strong(start, now, std::memory_order_relaxed)) {
+            site.count.store(0, std::memory_order_relaxed);
+            suppressed = site.suppressed.exchange(0, std::memory_order_relaxed);
+        }
+        if (site.count.fetch_add(1, std::memory_order_relaxed) < site.limit)
+            return true;
+        site.suppressed.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // bounded queue after Dmitry Vyukov, the producer claims a cell, fills it and publishes it by bumping its sequence
+    Cell* acquire() {
+        size_t position = m_Tail.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = m_Cells[position & (CAPACITY - 1)];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            intptr_t difference = (intptr_t) sequence - (intptr_t) position;
+            if (difference == 0) {
+                if (m_Tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    return &cell;
+            } else if (difference < 0) {
+                return NULL; // full
+            } else {
+                position = m_Tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+    void publish(Cell* cell) {
+        size_t position = cell->sequence.load(std::memory_order_relaxed);
+        cell->sequence.store(position + 1, std::memory_order_release);
+    }
+    bool pop(Record& record) {
+        Cell& cell = m_Cells[m_Head & (CAPACITY - 1)];
+        if (cell.sequence.load(std::memory_order_acquire) != m_Head + 1)
+            return false;
+        record = cell.record;
+        cell.sequence.store(m_Head + CAPACITY, std::memory_order_release);
+        m_Head++;
+        return true;
+    }
+
+    void start() {
+        std::lock_guard<std::mutex> lock(m_StartMutex);
+        if (m_Running.load(std::memory_order_acquire))
+            return;
+        m_Stop.store(false, std::memory_order_release);
+        m_Worker = std::thread(&Logger::run, this);
+        m_Running.store(true, std::memory_order_release);
+    }
+
+    void run() {
+        Record record;
+        unsigned long long reportedDrops = 0;
+        for (;;) {
+            bool stopping = m_Stop.load(std::memory_order_acquire);
+            bool wrote = false;
+            while (pop(record)) {
+                output(record);
+                wrote = true;
+            }
+            unsigned long long dropped = Dropped();
+            if (dropped != reportedDrops) {
+                std::fprintf(stdout, "[LOG] %llu messages dropped, the queue was full\n", dropped - reportedDrops);
+                reportedDrops = dropped;
+                wrote = true;
+            }
+            if (wrote) {
+                std::fflush(stdout);
+                std::lock_guard<std::mutex> lock(m_FileMutex);
+                if (m_File.is_open())
+                    m_File.flush();
+            }
+            if (stopping)
+                return;
+            if (!wrote)
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+    }
+
+    void output(const Record& record) {
+        static const char* levels[] = {"TRACE", "DEBUG", "INFO", "WARN", "ERROR"};
+        static const char* categories[] = {"General", "GL", "Shader", "Assets", "Render", "Input", "Benchmark", "Startup"};
+        char prefix[96];
+        std::snprintf(prefix, sizeof(prefix), "[%10.3f][%-5s][%s][t%u] ", record.time / 1000000.0,
+                      levels[(int) record.level], categories[(int) record.category], record.thread);
+        char suffix[192];
+        int length = 0;
+        suffix[0] = '\0';
+        if (record.level >= LogLevel::Warning) {
+            const char* name = std::strrchr(record.file, '/');
+            length = std::snprintf(suffix, sizeof(suffix), " (%s:%d)", name ? name + 1 : record.file, record.line);
+        }
+        if (record.suppressed && length >= 0 && (size_t) length < sizeof(suffix))
+            std::snprintf(suffix + length, sizeof(suffix) - length, " [%u similar suppressed]", record.suppressed);
+        const char* message = record.longMessage ? record.longMessage : record.message;
+        std::fputs(prefix, stdout);
+        std::fputs(message, stdout);
+        std::fputs(suffix, stdout);
+        std::fputc('\n', stdout);
+        {
+            std::lock_guard<std::mutex> lock(m_FileMutex);
+            if (m_File.is_open())
+                m_File << prefix << message << suffix << '\n';
+        }
+        delete[] record.longMessage;
+    }
+
+    Cell m_Cells[CAPACITY];
+    std::atomic<size_t> m_Tail{0};
+    size_t m_Head = 0;
+    std::atomic<uint8_t> m_Level{0};
+    std::atomic<unsigned long long> m_Dropped{0};
+    std::atomic<bool> m_Running{false};
+    std::atomic<bool> m_Stop{false};
+    std::mutex m_StartMutex;
+    std::mutex m_FileMutex;
+    std::thread m_Worker;
+    std::ofstream m_File;
+    std::chrono::steady_clock::time_point m_Epoch;
+};
+
+};
+
+#endif //PROJECT_BASE_LOG_H
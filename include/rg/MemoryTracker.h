@@ -0,0 +1,305 @@
+#ifndef PROJECT_BASE_MEMORYTRACKER_H
+#define PROJECT_BASE_MEMORYTRACKER_H
+
+#include <glad/glad.h>
+#include "imgui.h"
+#include <rg/FrameAllocator.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace rg {
+
+// Bookkeeping of the memory held by assets and render targets.
+// Every allocation site reports the bytes of the resource it creates (textures with their whole mip chain,
+// renderbuffers, vertex/index buffers and the CPU side copies meshes keep), keyed by kind and GL name.
+// Resources are grouped by owner: a model, a framebuffer or a subsystem. GL doesn't expose how much memory a
+// driver really uses, so GPU sizes are computed from formats, 3 channel formats are counted padded to 4.
+class MemoryTracker {
+public:
+    enum class Kind : uint8_t {
+        Texture,
+        Renderbuffer,
+        Buffer,
+        Cpu
+    };
+    struct Resource {
+        Kind kind;
+        unsigned int id;
+        std::string name;
+        std::string owner;
+        size_t bytes;
+    };
+
+    static MemoryTracker& Instance() {
+        static MemoryTracker tracker;
+        return tracker;
+    }
+    MemoryTracker(const MemoryTracker&) = delete;
+    MemoryTracker& operator=(const MemoryTracker&) = delete;
+
+    // tracking the same kind and id again replaces the entry (reallocated storage)
+    void Track(Kind kind, unsigned int id, const std::string& name, size_t bytes, const std::string& owner = "") {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        Resource& resource = m_Resources[key(kind, id)];
+        resource.kind = kind;
+        resource.id = id;
+        resource.name = name;
+        resource.owner = !owner.empty() ? owner : !m_Owner.empty() ? m_Owner : name;
+        resource.bytes = bytes;
+    }
+    void Untrack(Kind kind, unsigned int id) {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Resources.erase(key(kind, id));
+    }
+
+    // resources tracked without an explicit owner until EndOwner belong to this one, see MemoryOwner
+    void BeginOwner(const std::string& owner) { m_Owner = owner; }
+    void EndOwner() { m_Owner.clear(); }
+    const std::string& Owner() const { return m_Owner; }
+
+    size_t GpuBytes() const { return total(false); }
+    size_t CpuBytes() const { return total(true); }
+
+    // resident set size of the process, 0 where it can't be read.
+    // Plain read() into a stack buffer, the window calls this every frame.
+    static size_t ProcessRss() {
+#ifdef __linux__
+        int file = ::open("/proc/self/statm", O_RDONLY);
+        if (file < 0)
+            return 0;
+        char buffer[128];
+        ssize_t length = ::read(file, buffer, sizeof(buffer) - 1);
+        ::close(file);
+        unsigned long long pages = 0, resident = 0;
+        if (length > 0) {
+            buffer[length] = '\0';
+            if (std::sscanf(buffer, "%llu %llu", &pages, &resident) == 2)
+                return (size_t) resident * (size_t) sysconf(_SC_PAGESIZE);
+        }
+#endif
+        return 0;
+    }
+
+    // size of a texture with the given internal format, layers are array layers or cube faces
+    static size_t TextureBytes(GLenum internalFormat, int width, int height, int layers = 1, bool mipmaps = false) {
+        size_t texels = 0;
+        for (;;) {
+            texels += (size_t) width * height;
+            if (!mipmaps || (width == 1 && height == 1))
+                break;
+            width = std::max(1, width / 2);
+            height = std::max(1, height / 2);
+        }
+        return texels * layers * BytesPerTexel(internalFormat);
+    }
+    static size_t BytesPerTexel(GLenum internalFormat) {
+        switch (internalFormat) {
+            case GL_RED:
+            case GL_R8:
+                return 1;
+            case GL_RG:
+            case GL_RG8:
+            case GL_R16F:
+            case GL_DEPTH_COMPONENT16:
+                return 2;
+            case GL_RGB16F:
+            case GL_RGBA16F:
+            case GL_RG32F:
+                return 8;
+            case GL_RGB32F:
+            case GL_RGBA32F:
+                return 16;
+            default:
+                // RGB(A)8, sRGB, R11G11B10, R32F and the 24/32 bit depth formats
+                return 4;
+        }
+    }
+
+    // all resources sorted by size, plus the totals per owner.
+    // Works on pointers into the map in frame memory, drawing the window every frame doesn't allocate.
+    void DrawWindow() {
+        bool dump = false;
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            FrameVector<const Resource*> resources;
+            resources.reserve(m_Resources.size());
+            size_t gpu = 0, cpu = 0;
+            for (const auto& entry : m_Resources) {
+                resources.push_back(&entry.second);
+                (entry.second.kind == Kind::Cpu ? cpu : gpu) += entry.second.bytes;
+            }
+            std::sort(resources.begin(), resources.end(),
+                      [](const Resource* a, const Resource* b) { return a->bytes > b->bytes; });
+            FrameVector<std::pair<const std::string*, size_t>> owners;
+            owners.reserve(resources.size());
+            for (const Resource* resource : resources) {
+                auto owner = std::find_if(owners.begin(), owners.end(), [&](const std::pair<const std::string*, size_t>& o) {
+                    return *o.first == resource->owner;
+                });
+                if (owner == owners.end())
+                    owners.emplace_back(&resource->owner, resource->bytes);
+                else
+                    owner->second += resource->bytes;
+            }
+            std::sort(owners.begin(), owners.end(),
+                      [](const std::pair<const std::string*, size_t>& a, const std::pair<const std::string*, size_t>& b) {
+                          return a.second > b.second;
+                      });
+
+            ImGui::Text("GPU %.2f MB, CPU copies %.2f MB, process RSS %.2f MB", megabytes(gpu), megabytes(cpu),
+                        megabytes(ProcessRss()));
+            dump = ImGui::Button("Dump memory.json");
+
+            if (ImGui::CollapsingHeader("Owners", ImGuiTreeNodeFlags_DefaultOpen)) {
+                ImGui::Columns(2, "memoryOwners");
+                for (const auto& owner : owners) {
+                    ImGui::Text("%s", owner.first->c_str());
+                    ImGui::NextColumn();
+                    ImGui::Text("%.2f MB", megabytes(owner.second));
+                    ImGui::NextColumn();
+                }
+                ImGui::Columns(1);
+            }
+            if (ImGui::CollapsingHeader("Resources")) {
+                ImGui::Columns(4, "memoryResources");
+                ImGui::Text("Resource");
+                ImGui::NextColumn();
+                ImGui::Text("Owner");
+                ImGui::NextColumn();
+                ImGui::Text("Kind");
+                ImGui::NextColumn();
+                ImGui::Text("KB");
+                ImGui::NextColumn();
+                ImGui::Separator();
+                for (const Resource* resource : resources) {
+                    ImGui::Text("%s", resource->name.c_str());
+                    ImGui::NextColumn();
+                    ImGui::Text("%s", resource->owner.c_str());
+                    ImGui::NextColumn();
+                    ImGui::Text("%s", kindName(resource->kind));
+                    ImGui::NextColumn();
+                    ImGui::Text("%.1f", resource->bytes / 1024.0);
+                    ImGui::NextColumn();
+                }
+                ImGui::Columns(1);
+            }
+        }
+        if (dump)
+            WriteJson("memory.json");
+    }
+
+    // every resource, for diffing two runs
+    bool WriteJson(const std::string& path) const {
+        std::ofstream out(path);
+        if (!out)
+            return false;
+        std::vector<Resource> resources = sorted();
+        out << "{\n  \"summary\": ";
+        WriteSummaryJson(out);
+        out << ",\n  \"resources\": [";
+        for (size_t i = 0; i < resources.size(); i++) {
+            const Resource& resource = resources[i];
+            out << (i ? ",\n" : "\n") << "    {\"name\": \"" << escape(resource.name) << "\", \"owner\": \""
+                << escape(resource.owner) << "\", \"kind\": \"" << kindName(resource.kind) << "\", \"bytes\": "
+                << resource.bytes << "}";
+        }
+        out << "\n  ]\n}\n";
+        return (bool) out;
+    }
+    // totals and bytes per owner, also part of the benchmark results
+    void WriteSummaryJson(std::ostream& out) const {
+        std::vector<std::pair<std::string, size_t>> owners = byOwner(sorted());
+        out << "{\"gpuBytes\": " << GpuBytes() << ", \"cpuBytes\": " << CpuBytes() << ", \"rssBytes\": "
+            << ProcessRss() << ", \"owners\": {";
+        for (size_t i = 0; i < owners.size(); i++)
+            out << (i ? ", " : "") << "\"" << escape(owners[i].first) << "\": " << owners[i].second;
+        out << "}}";
+    }
+
+private:
+    MemoryTracker() = default;
+
+    static uint64_t key(Kind kind, unsigned int id) {
+        return ((uint64_t) kind << 32) | id;
+    }
+    static const char* kindName(Kind kind) {
+        static const char* names[] = {"texture", "renderbuffer", "buffer", "cpu"};
+        return names[(int) kind];
+    }
+    static double megabytes(size_t bytes) {
+        return bytes / (1024.0 * 1024.0);
+    }
+    static std::string escape(const std::string& text) {
+        std::string result;
+        for (char c : text) {
+            if (c == '"' || c == '\\')
+                result += '\\';
+            result += c;
+        }
+        return result;
+    }
+
+    size_t total(bool cpu) const {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        size_t bytes = 0;
+        for (const auto& entry : m_Resources) {
+            if ((entry.second.kind == Kind::Cpu) == cpu)
+                bytes += entry.second.bytes;
+        }
+        return bytes;
+    }
+    std::vector<Resource> sorted() const {
+        std::vector<Resource> resources;
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            for (const auto& entry : m_Resources)
+                resources.push_back(entry.second);
+        }
+        std::sort(resources.begin(), resources.end(),
+                  [](const Resource& a, const Resource& b) { return a.bytes > b.bytes; });
+        return resources;
+    }
+    static std::vector<std::pair<std::string, size_t>> byOwner(const std::vector<Resource>& resources) {
+        std::map<std::string, size_t> totals;
+        for (const Resource& resource : resources)
+            totals[resource.owner] += resource.bytes;
+        std::vector<std::pair<std::string, size_t>> owners(totals.begin(), totals.end());
+        std::sort(owners.begin(), owners.end(),
+                  [](const std::pair<std::string, size_t>& a, const std::pair<std::string, size_t>& b) {
+                      return a.second > b.second;
+                  });
+        return owners;
+    }
+
+    mutable std::mutex m_Mutex;
+    std::map<uint64_t, Resource> m_Resources;
+    std::string m_Owner;
+};
+
+// everything tracked during the lifetime of the object without an explicit owner belongs to this one
+class MemoryOwner {
+public:
+    explicit MemoryOwner(const std::string& owner) {
+        MemoryTracker::Instance().BeginOwner(owner);
+    }
+    ~MemoryOwner() {
+        MemoryTracker::Instance().EndOwner();
+    }
+    MemoryOwner(const MemoryOwner&) = delete;
+    MemoryOwner& operator=(const MemoryOwner&) = delete;
+};
+
+};
+
+#endif //PROJECT_BASE_MEMORYTRACKER_H
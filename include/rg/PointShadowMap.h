@@ -0,0 +1,144 @@
+#ifndef PROJECT_BASE_POINTSHADOWMAP_H
+#define PROJECT_BASE_POINTSHADOWMAP_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <learnopengl/shader.h>
+#include <rg/Log.h>
+#include <rg/GLDebug.h>
+#include <rg/MemoryTracker.h>
+
+namespace rg {
+
+// Omnidirectional shadow map for a single point light.
+// Depth is rendered into a cube map in one pass, the geometry shader routes every triangle to all six
+// faces through gl_Layer. Static casters live in their own cube map which is only re-rendered when the
+// light or the static geometry moves, dynamic casters are re-rendered every frame into a second cube map
+// and the lighting shader takes the closer of the two depths.
+class PointShadowMap {
+public:
+    PointShadowMap(unsigned int resolution = 1024, float nearPlane = 0.1f, float farPlane = 40.0f)
+            : m_Resolution(resolution), m_Near(nearPlane), m_Far(farPlane) {
+        glGenFramebuffers(2, m_Fbo);
+        glGenTextures(2, m_DepthCubemap);
+        for (unsigned int i = 0; i < 2; i++) {
+            glBindTexture(GL_TEXTURE_CUBE_MAP, m_DepthCubemap[i]);
+            GLDebug::Label(GL_TEXTURE, m_DepthCubemap[i], i == 0 ? "Point shadow static depth" : "Point shadow dynamic depth");
+            for (unsigned int face = 0; face < 6; face++)
+                glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_DEPTH_COMPONENT24, resolution, resolution, 0,
+                             GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+            MemoryTracker::Instance().Track(MemoryTracker::Kind::Texture, m_DepthCubemap[i],
+                                            i == 0 ? "Point shadow static depth" : "Point shadow dynamic depth",
+                                            MemoryTracker::TextureBytes(GL_DEPTH_COMPONENT24, resolution, resolution, 6),
+                                            "Point shadows");
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+            // attach the whole cube map as a layered depth attachment
+            glBindFramebuffer(GL_FRAMEBUFFER, m_Fbo[i]);
+            GLDebug::Label(GL_FRAMEBUFFER, m_Fbo[i], i == 0 ? "Point shadow static FBO" : "Point shadow dynamic FBO");
+            glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_DepthCubemap[i], 0);
+            glDrawBuffer(GL_NONE);
+            glReadBuffer(GL_NONE);
+            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+                LOG_ERROR(Render, "Point shadow framebuffer not complete!");
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    ~PointShadowMap() {
+        for (unsigned int i = 0; i < 2; i++)
+            MemoryTracker::Instance().Untrack(MemoryTracker::Kind::Texture, m_DepthCubemap[i]);
+        glDeleteFramebuffers(2, m_Fbo);
+        glDeleteTextures(2, m_DepthCubemap);
+    }
+
+    PointShadowMap(const PointShadowMap&) = delete;
+    PointShadowMap& operator=(const PointShadowMap&) = delete;
+
+    // moving the light invalidates the cached static map
+    void SetLightPosition(const glm::vec3& position) {
+        if (position != m_LightPos) {
+            m_LightPos = position;
+            m_StaticDirty = true;
+        }
+    }
+    // has to be called whenever a static caster is added, removed or moved
+    void InvalidateStatic() { m_StaticDirty = true; }
+    bool StaticDirty() const { return m_StaticDirty; }
+
+    // binds the static cube map as render target, the caller draws static casters afterwards
+    void BeginStatic(Shader& depthShader) {
+        begin(STATIC, depthShader);
+        m_StaticDirty = false;
+        m_StaticRebuilds++;
+    }
+    // binds the dynamic cube map as render target, the caller draws dynamic casters afterwards
+    void BeginDynamic(Shader& depthShader) {
+        begin(DYNAMIC, depthShader);
+    }
+    void End() {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(m_SavedViewport[0], m_SavedViewport[1], m_SavedViewport[2], m_SavedViewport[3]);
+    }
+
+    // binds both depth cube maps for sampling in the lighting pass
+    void Bind(unsigned int staticUnit, unsigned int dynamicUnit) const {
+        glActiveTexture(GL_TEXTURE0 + staticUnit);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, m_DepthCubemap[STATIC]);
+        glActiveTexture(GL_TEXTURE0 + dynamicUnit);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, m_DepthCubemap[DYNAMIC]);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    float FarPlane() const { return m_Far; }
+    unsigned int Resolution() const { return m_Resolution; }
+    unsigned int StaticRebuilds() const { return m_StaticRebuilds; }
+
+private:
+    enum { STATIC = 0, DYNAMIC = 1 };
+
+    void begin(int map, Shader& depthShader) {
+        static const char* matrixNames[6] = {
+                "shadowMatrices[0]", "shadowMatrices[1]", "shadowMatrices[2]",
+                "shadowMatrices[3]", "shadowMatrices[4]", "shadowMatrices[5]"
+        };
+        glm::mat4 shadowProj = glm::perspective(glm::radians(90.0f), 1.0f, m_Near, m_Far);
+        glm::mat4 shadowTransforms[6] = {
+                shadowProj * glm::lookAt(m_LightPos, m_LightPos + glm::vec3( 1.0f,  0.0f,  0.0f), glm::vec3(0.0f, -1.0f,  0.0f)),
+                shadowProj * glm::lookAt(m_LightPos, m_LightPos + glm::vec3(-1.0f,  0.0f,  0.0f), glm::vec3(0.0f, -1.0f,  0.0f)),
+                shadowProj * glm::lookAt(m_LightPos, m_LightPos + glm::vec3( 0.0f,  1.0f,  0.0f), glm::vec3(0.0f,  0.0f,  1.0f)),
+                shadowProj * glm::lookAt(m_LightPos, m_LightPos + glm::vec3( 0.0f, -1.0f,  0.0f), glm::vec3(0.0f,  0.0f, -1.0f)),
+                shadowProj * glm::lookAt(m_LightPos, m_LightPos + glm::vec3( 0.0f,  0.0f,  1.0f), glm::vec3(0.0f, -1.0f,  0.0f)),
+                shadowProj * glm::lookAt(m_LightPos, m_LightPos + glm::vec3( 0.0f,  0.0f, -1.0f), glm::vec3(0.0f, -1.0f,  0.0f))
+        };
+
+        glGetIntegerv(GL_VIEWPORT, m_SavedViewport);
+        glViewport(0, 0, m_Resolution, m_Resolution);
+        glBindFramebuffer(GL_FRAMEBUFFER, m_Fbo[map]);
+        glClear(GL_DEPTH_BUFFER_BIT);
+
+        depthShader.use();
+        for (unsigned int i = 0; i < 6; ++i)
+            depthShader.setMat4(matrixNames[i], shadowTransforms[i]);
+        depthShader.setFloat("farPlane", m_Far);
+        depthShader.setVec3("lightPos", m_LightPos);
+    }
+
+    unsigned int m_Resolution;
+    float m_Near;
+    float m_Far;
+    unsigned int m_Fbo[2] = {0, 0};
+    unsigned int m_DepthCubemap[2] = {0, 0};
+    GLint m_SavedViewport[4] = {0, 0, 0, 0};
+    glm::vec3 m_LightPos = glm::vec3(0.0f);
+    bool m_StaticDirty = true;
+    unsigned int m_StaticRebuilds = 0;
+};
+
+};
+
+#endif //PROJECT_BASE_POINTSHADOWMAP_H
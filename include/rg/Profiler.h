@@ -0,0 +1,383 @@
+#ifndef PROJECT_BASE_PROFILER_H
+#define PROJECT_BASE_PROFILER_H
+
+#include <glad/glad.h>
+#include "imgui.h"
+#include <rg/GLDebug.h>
+#include <rg/Log.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(name) rg::ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+
+namespace rg {
+
+// Hierarchical CPU/GPU frame profiler.
+// Every scope records CPU time and a pair of GL_TIMESTAMP queries (unlike GL_TIME_ELAPSED they can nest).
+// Each frame owns its own set of queries, they are read back LATENCY frames later and only once the driver
+// reports them as available, so profiling never stalls the pipeline. If the GPU falls further behind, the
+// frame is recorded with CPU times only.
+// Recording happens on the render thread. DrawTimeline() and RequestCapture() may run on another thread, they only
+// see the frame results and capture progress published at the end of every frame.
+class Profiler {
+public:
+    static const unsigned int MAX_SCOPES = 64;
+    static const unsigned int LATENCY = 4;
+
+    // all times are in microseconds on the CPU clock, GPU timestamps are converted with a calibrated offset
+    struct Scope {
+        const char* name;
+        unsigned int depth;
+        double cpuStart, cpuEnd;
+        double gpuStart, gpuEnd;
+    };
+    struct FrameResult {
+        unsigned long frameIndex = 0;
+        unsigned int count = 0;
+        bool hasGpu = false;
+        Scope scopes[MAX_SCOPES];
+    };
+
+    static Profiler& Instance() {
+        static Profiler profiler;
+        return profiler;
+    }
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+
+    void BeginFrame() {
+        if (!m_Initialized)
+            initialize();
+        takeCaptureRequest();
+        resolve();
+        FrameSlot& slot = m_Slots[m_FrameIndex % LATENCY];
+        // still waiting for this slot's queries, drop its GPU times instead of waiting
+        slot.gpu = !slot.queued;
+        slot.queued = false;
+        slot.result.frameIndex = m_FrameIndex;
+        slot.result.count = 0;
+        slot.result.hasGpu = slot.gpu;
+        m_Depth = 0;
+        Push("Frame");
+    }
+    void EndFrame() {
+        Pop();
+        FrameSlot& slot = m_Slots[m_FrameIndex % LATENCY];
+        if (slot.gpu)
+            slot.queued = true;
+        else
+            publish(slot.result);
+        m_FrameIndex++;
+        std::lock_guard<std::mutex> lock(m_ShownMutex);
+        m_Shown.latest = m_Latest;
+        m_Shown.captured = (unsigned int) m_Captured.size();
+        m_Shown.captureFrames = m_CaptureFrames;
+        std::snprintf(m_Shown.lastTrace, sizeof(m_Shown.lastTrace), "%s", m_LastTrace.c_str());
+    }
+
+    void Push(const char* name) {
+        // every scope is also a debug group, so captures show the same structure
+        GLDebug::PushGroup(name);
+        FrameSlot& slot = m_Slots[m_FrameIndex % LATENCY];
+        if (m_Depth < MAX_SCOPES) {
+            m_Stack[m_Depth] = slot.result.count < MAX_SCOPES ? slot.result.count : MAX_SCOPES;
+            m_Names[m_Depth] = name;
+        }
+        if (m_Depth < MAX_SCOPES && slot.result.count < MAX_SCOPES) {
+            Scope& scope = slot.result.scopes[slot.result.count++];
+            scope.name = name;
+            scope.depth = m_Depth;
+            scope.cpuStart = now();
+            scope.cpuEnd = scope.cpuStart;
+            scope.gpuStart = scope.gpuEnd = 0.0;
+            if (slot.gpu)
+                glQueryCounter(slot.queries[2 * (slot.result.count - 1)], GL_TIMESTAMP);
+        }
+        m_Depth++;
+    }
+    void Pop() {
+        if (m_Depth == 0)
+            return;
+        GLDebug::PopGroup();
+        m_Depth--;
+        if (m_Depth >= MAX_SCOPES || m_Stack[m_Depth] >= MAX_SCOPES)
+            return;
+        FrameSlot& slot = m_Slots[m_FrameIndex % LATENCY];
+        unsigned int index = m_Stack[m_Depth];
+        slot.result.scopes[index].cpuEnd = now();
+        if (slot.gpu)
+            glQueryCounter(slot.queries[2 * index + 1], GL_TIMESTAMP);
+    }
+
+    // releases the queries, has to be called while the GL context is still alive
+    void Shutdown() {
+        if (!m_Initialized)
+            return;
+        for (FrameSlot& slot : m_Slots)
+            glDeleteQueries(2 * MAX_SCOPES, slot.queries);
+        m_Initialized = false;
+    }
+
+    // innermost open scope, NULL outside of a frame
+    const char* CurrentScope() const {
+        if (m_Depth == 0)
+            return NULL;
+        return m_Names[(m_Depth < MAX_SCOPES ? m_Depth : MAX_SCOPES) - 1];
+    }
+
+    // latest frame whose results are complete
+    const FrameResult& Latest() const { return m_Latest; }
+
+    // records the next frames and writes them as a Chrome trace (chrome://tracing, ui.perfetto.dev)
+    void Capture(unsigned int frames, const std::string& path) {
+        m_Captured.clear();
+        m_Captured.reserve(frames);
+        m_CaptureFrames = frames;
+        m_CapturePath = path;
+    }
+    bool Capturing() const { return m_CaptureFrames > 0; }
+    // Capture() from another thread, the buffer is reserved here so the render thread doesn't allocate for it
+    void RequestCapture(unsigned int frames, const std::string& path) {
+        std::vector<FrameResult> buffer;
+        buffer.reserve(frames);
+        std::string requestPath = path;
+        std::lock_guard<std::mutex> lock(m_ShownMutex);
+        m_Request.buffer.swap(buffer);
+        m_Request.path.swap(requestPath);
+        m_Request.frames = frames;
+    }
+
+    // timeline of the latest published frame, one lane per nesting level for the CPU and for the GPU
+    void DrawTimeline() {
+        {
+            std::lock_guard<std::mutex> lock(m_ShownMutex);
+            m_Drawn = m_Shown;
+        }
+        const Shown& shown = m_Drawn;
+        const FrameResult& frame = shown.latest;
+        if (frame.count == 0) {
+            ImGui::Text("No frames profiled yet");
+            return;
+        }
+        const Scope& root = frame.scopes[0];
+        double cpuMs = (root.cpuEnd - root.cpuStart) / 1000.0;
+        double gpuMs = frame.hasGpu ? (root.gpuEnd - root.gpuStart) / 1000.0 : 0.0;
+        if (frame.hasGpu)
+            ImGui::Text("Frame %lu: cpu %.3f ms, gpu %.3f ms", frame.frameIndex, cpuMs, gpuMs);
+        else
+            ImGui::Text("Frame %lu: cpu %.3f ms, gpu n/a", frame.frameIndex, cpuMs);
+        if (shown.captureFrames > 0) {
+            ImGui::Text("Capturing %u/%u frames...", shown.captured, shown.captureFrames);
+        } else if (ImGui::Button("Capture 120 frames")) {
+            RequestCapture(120, "frame_trace.json");
+        }
+        if (shown.lastTrace[0])
+            ImGui::Text("Last trace: %s", shown.lastTrace);
+
+        unsigned int maxDepth = 0;
+        for (unsigned int i = 0; i < frame.count; i++)
+            maxDepth = std::max(maxDepth, frame.scopes[i].depth);
+        double span = std::max(cpuMs, gpuMs) * 1000.0;
+        drawLane("CPU", frame, false, span, maxDepth);
+        if (frame.hasGpu)
+            drawLane("GPU", frame, true, span, maxDepth);
+
+        ImGui::Columns(3, "profilerScopes");
+        ImGui::Text("Scope");
+        ImGui::NextColumn();
+        ImGui::Text("CPU ms");
+        ImGui::NextColumn();
+        ImGui::Text("GPU ms");
+        ImGui::NextColumn();
+        ImGui::Separator();
+        for (unsigned int i = 0; i < frame.count; i++) {
+            const Scope& scope = frame.scopes[i];
+            ImGui::Text("%*s%s", 2 * scope.depth, "", scope.name);
+            ImGui::NextColumn();
+            ImGui::Text("%.3f", (scope.cpuEnd - scope.cpuStart) / 1000.0);
+            ImGui::NextColumn();
+            if (frame.hasGpu)
+                ImGui::Text("%.3f", (scope.gpuEnd - scope.gpuStart) / 1000.0);
+            else
+                ImGui::Text("-");
+            ImGui::NextColumn();
+        }
+        ImGui::Columns(1);
+    }
+
+private:
+    struct FrameSlot {
+        GLuint queries[2 * MAX_SCOPES];
+        FrameResult result;
+        // GPU timestamps are recorded for this frame
+        bool gpu = false;
+        // ended and waiting for its queries
+        bool queued = false;
+    };
+    // what DrawTimeline() shows
+    struct Shown {
+        FrameResult latest;
+        unsigned int captured = 0;
+        unsigned int captureFrames = 0;
+        char lastTrace[128] = {};
+    };
+    struct CaptureRequest {
+        std::vector<FrameResult> buffer;
+        std::string path;
+        unsigned int frames = 0;
+    };
+
+    Profiler() : m_Epoch(std::chrono::steady_clock::now()) {}
+
+    // starts a capture requested from another thread, swaps the prepared buffer in instead of allocating
+    void takeCaptureRequest() {
+        std::lock_guard<std::mutex> lock(m_ShownMutex);
+        if (!m_Request.frames)
+            return;
+        m_Captured.swap(m_Request.buffer);
+        m_Captured.clear();
+        m_CapturePath.swap(m_Request.path);
+        m_CaptureFrames = m_Request.frames;
+        m_Request.frames = 0;
+    }
+
+    void initialize() {
+        for (FrameSlot& slot : m_Slots)
+            glGenQueries(2 * MAX_SCOPES, slot.queries);
+        // line up the GPU clock with the CPU clock, needed to put both into one trace
+        GLint64 gpuNow = 0;
+        glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+        m_GpuOffset = now() - gpuNow / 1000.0;
+        m_Initialized = true;
+    }
+
+    double now() const {
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - m_Epoch).count();
+    }
+
+    // reads back finished frames, oldest first, without ever waiting for the GPU
+    void resolve() {
+        for (unsigned int i = 0; i < LATENCY; i++) {
+            FrameSlot& slot = m_Slots[(m_FrameIndex + i) % LATENCY];
+            if (!slot.queued)
+                continue;
+            GLint available = 0;
+            glGetQueryObjectiv(slot.queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                break;
+            for (unsigned int s = 0; s < slot.result.count; s++) {
+                GLuint64 start = 0, end = 0;
+                glGetQueryObjectui64v(slot.queries[2 * s], GL_QUERY_RESULT, &start);
+                glGetQueryObjectui64v(slot.queries[2 * s + 1], GL_QUERY_RESULT, &end);
+                slot.result.scopes[s].gpuStart = start / 1000.0 + m_GpuOffset;
+                slot.result.scopes[s].gpuEnd = end / 1000.0 + m_GpuOffset;
+            }
+            slot.queued = false;
+            publish(slot.result);
+        }
+    }
+
+    void publish(const FrameResult& result) {
+        m_Latest = result;
+        if (!Capturing())
+            return;
+        m_Captured.push_back(result);
+        if (m_Captured.size() >= m_CaptureFrames) {
+            writeChromeTrace();
+            m_CaptureFrames = 0;
+            m_Captured.clear();
+        }
+    }
+
+    void writeChromeTrace() {
+        FILE* out = std::fopen(m_CapturePath.c_str(), "w");
+        if (!out) {
+            LOG_ERROR(General, "Failed to write profiler capture %s", m_CapturePath.c_str());
+            return;
+        }
+        std::fprintf(out, "{\"traceEvents\":[\n");
+        std::fprintf(out, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n");
+        std::fprintf(out, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}");
+        for (const FrameResult& frame : m_Captured) {
+            for (unsigned int i = 0; i < frame.count; i++) {
+                const Scope& scope = frame.scopes[i];
+                std::fprintf(out, ",\n{\"name\":\"%s\",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,"
+                                  "\"dur\":%.3f,\"args\":{\"frame\":%lu}}",
+                             scope.name, scope.cpuStart, scope.cpuEnd - scope.cpuStart, frame.frameIndex);
+                if (frame.hasGpu)
+                    std::fprintf(out, ",\n{\"name\":\"%s\",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":1,\"tid\":2,\"ts\":%.3f,"
+                                      "\"dur\":%.3f,\"args\":{\"frame\":%lu}}",
+                                 scope.name, scope.gpuStart, scope.gpuEnd - scope.gpuStart, frame.frameIndex);
+            }
+        }
+        std::fprintf(out, "\n]}\n");
+        std::fclose(out);
+        m_LastTrace = m_CapturePath;
+    }
+
+    void drawLane(const char* label, const FrameResult& frame, bool gpu, double span, unsigned int maxDepth) {
+        const float laneHeight = 18.0f;
+        ImGui::Text("%s", label);
+        float width = ImGui::GetContentRegionAvail().x;
+        ImVec2 origin = ImGui::GetCursorScreenPos();
+        ImDrawList* drawList = ImGui::GetWindowDrawList();
+        double frameStart = gpu ? frame.scopes[0].gpuStart : frame.scopes[0].cpuStart;
+        for (unsigned int i = 0; i < frame.count; i++) {
+            const Scope& scope = frame.scopes[i];
+            double start = (gpu ? scope.gpuStart : scope.cpuStart) - frameStart;
+            double end = (gpu ? scope.gpuEnd : scope.cpuEnd) - frameStart;
+            ImVec2 min(origin.x + (float) (start / span) * width, origin.y + scope.depth * laneHeight);
+            ImVec2 max(origin.x + (float) (end / span) * width, min.y + laneHeight - 1.0f);
+            if (max.x - min.x < 1.0f)
+                max.x = min.x + 1.0f;
+            // stable color per scope name
+            unsigned int hash = 2166136261u;
+            for (const char* c = scope.name; *c; c++)
+                hash = (hash ^ (unsigned char) *c) * 16777619u;
+            ImU32 color = IM_COL32(80 + hash % 150, 80 + (hash >> 8) % 150, 80 + (hash >> 16) % 150, 255);
+            drawList->AddRectFilled(min, max, color);
+            if (ImGui::CalcTextSize(scope.name).x < max.x - min.x - 4.0f)
+                drawList->AddText(ImVec2(min.x + 2.0f, min.y + 2.0f), IM_COL32(0, 0, 0, 255), scope.name);
+            if (ImGui::IsMouseHoveringRect(min, max))
+                ImGui::SetTooltip("%s: %.3f ms", scope.name, (end - start) / 1000.0);
+        }
+        ImGui::Dummy(ImVec2(width, (maxDepth + 1) * laneHeight));
+    }
+
+    std::chrono::steady_clock::time_point m_Epoch;
+    bool m_Initialized = false;
+    double m_GpuOffset = 0.0;
+    unsigned long m_FrameIndex = 0;
+    FrameSlot m_Slots[LATENCY];
+    unsigned int m_Stack[MAX_SCOPES];
+    const char* m_Names[MAX_SCOPES];
+    unsigned int m_Depth = 0;
+    FrameResult m_Latest;
+    std::vector<FrameResult> m_Captured;
+    unsigned int m_CaptureFrames = 0;
+    std::string m_CapturePath;
+    std::string m_LastTrace;
+    std::mutex m_ShownMutex;
+    Shown m_Shown;
+    CaptureRequest m_Request;
+    Shown m_Drawn; // the drawing thread's copy of m_Shown
+};
+
+// pushes a profiler scope for the lifetime of the object
+class ProfileScope {
+public:
+    explicit ProfileScope(const char* name) { Profiler::Instance().Push(name); }
+    ~ProfileScope() { Profiler::Instance().Pop(); }
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+};
+
+};
+
+#endif //PROJECT_BASE_PROFILER_H
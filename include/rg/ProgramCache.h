@@ -0,0 +1,166 @@
+#ifndef PROJECT_BASE_PROGRAMCACHE_H
+#define PROJECT_BASE_PROGRAMCACHE_H
+
+#include <glad/glad.h>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+namespace rg {
+
+// On-disk cache of linked program binaries (GL_ARB_get_program_binary).
+// Every program permutation owns one file in the cache directory. The file stores a hash of the sources,
+// the injected defines and the GL vendor/renderer/version next to the binary, so editing a shader or
+// updating the driver simply makes the stored entry miss and it gets overwritten after the next compile.
+class ProgramCache {
+public:
+    static ProgramCache& Instance() {
+        static ProgramCache cache("shader_cache");
+        return cache;
+    }
+    ProgramCache(const ProgramCache&) = delete;
+    ProgramCache& operator=(const ProgramCache&) = delete;
+
+    // 64 bit FNV-1a, chain calls by passing the previous hash as seed
+    static uint64_t Hash(const std::string& data, uint64_t seed = 14695981039346656037ull) {
+        uint64_t hash = seed;
+        for (unsigned char c : data) {
+            hash ^= c;
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    bool Enabled() const { return m_Enabled; }
+    // hash that identifies a program built from the given text on this driver
+    uint64_t Key(const std::string& programText) const { return Hash(programText, m_DriverHash); }
+
+    // creates the program from the cached binary, returns 0 when there is no valid entry for the key
+    unsigned int Load(const std::string& slot, uint64_t key) {
+        if (!m_Enabled)
+            return 0;
+        std::ifstream in(path(slot), std::ios::binary | std::ios::ate);
+        std::streamoff size = in ? (std::streamoff) in.tellg() : 0;
+        Header header;
+        if (!in || !in.seekg(0) || !in.read((char*) &header, sizeof(header)) || header.magic != MAGIC ||
+            header.key != key) {
+            m_Misses++;
+            return 0;
+        }
+        // a damaged or foreign file must not make us allocate whatever its length field says
+        if (header.length == 0 || header.length > MAX_BINARY_BYTES ||
+            (std::streamoff) header.length > size - (std::streamoff) sizeof(header)) {
+            m_Misses++;
+            return 0;
+        }
+        std::vector<char> binary(header.length);
+        if (!in.read(binary.data(), header.length)) {
+            m_Misses++;
+            return 0;
+        }
+        unsigned int program = glCreateProgram();
+        glProgramBinary(program, header.format, binary.data(), header.length);
+        // the driver may still reject a binary, e.g. after an update that kept the version string
+        GLint success = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success) {
+            glDeleteProgram(program);
+            m_Misses++;
+            return 0;
+        }
+        m_Hits++;
+        return program;
+    }
+
+    // has to be called before linking, otherwise the driver may not keep the binary around
+    void PrepareForStore(unsigned int program) const {
+        if (m_Enabled)
+            glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+    void Store(const std::string& slot, uint64_t key, unsigned int program) {
+        if (!m_Enabled)
+            return;
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return;
+        std::vector<char> binary(length);
+        Header header;
+        header.key = key;
+        glGetProgramBinary(program, length, NULL, &header.format, binary.data());
+        header.length = length;
+        // write to a temporary file first, a crash mid-write must not leave a truncated entry behind
+        std::string target = path(slot);
+        std::string temporary = target + ".tmp";
+        {
+            std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+            if (!out)
+                return;
+            out.write((const char*) &header, sizeof(header));
+            out.write(binary.data(), length);
+            if (!out)
+                return;
+        }
+        std::remove(target.c_str());
+        std::rename(temporary.c_str(), target.c_str());
+    }
+
+    unsigned int Hits() const { return m_Hits; }
+    unsigned int Misses() const { return m_Misses; }
+
+private:
+    static const uint32_t MAGIC = 0x42505247; // "GRPB"
+    // far above any real program binary
+    static const uint32_t MAX_BINARY_BYTES = 64 * 1024 * 1024;
+
+    struct Header {
+        uint32_t magic = MAGIC;
+        GLenum format = 0;
+        uint64_t key = 0;
+        uint32_t length = 0;
+        uint32_t padding = 0;
+    };
+
+    explicit ProgramCache(const std::string& directory) : m_Directory(directory) {
+        GLint formats = 0;
+        if (GLAD_GL_ARB_get_program_binary)
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        m_Enabled = formats > 0;
+        if (!m_Enabled)
+            return;
+#ifdef _WIN32
+        _mkdir(directory.c_str());
+#else
+        mkdir(directory.c_str(), 0755);
+#endif
+        std::string driver;
+        for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION}) {
+            const char* value = (const char*) glGetString(name);
+            driver += value ? value : "";
+            driver += '\n';
+        }
+        m_DriverHash = Hash(driver);
+    }
+
+    std::string path(const std::string& slot) const {
+        char name[17];
+        std::snprintf(name, sizeof(name), "%016llx", (unsigned long long) Hash(slot));
+        return m_Directory + "/" + name + ".bin";
+    }
+
+    std::string m_Directory;
+    bool m_Enabled = false;
+    uint64_t m_DriverHash = 0;
+    unsigned int m_Hits = 0;
+    unsigned int m_Misses = 0;
+};
+
+};
+
+#endif //PROJECT_BASE_PROGRAMCACHE_H
@@ -0,0 +1,350 @@
+#ifndef PROJECT_BASE_RENDERTARGETPOOL_H
+#define PROJECT_BASE_RENDERTARGETPOOL_H
+
+#include <glad/glad.h>
+#include <rg/GLDebug.h>
+#include <rg/Log.h>
+#include <rg/MemoryTracker.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <initializer_list>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace rg {
+
+struct RenderTargetDesc {
+    GLenum internalFormat;
+    int width, height;
+    int samples;
+
+    bool operator==(const RenderTargetDesc& other) const {
+        return internalFormat == other.internalFormat && width == other.width && height == other.height &&
+               samples == other.samples;
+    }
+};
+
+// Textures the passes render into, keyed by format, size and sample count. A pass acquires its targets for as long
+// as it needs them and releases them afterwards, so a later pass (or the next frame) gets the same texture back
+// instead of a new one. Nothing is allocated up front: a target is created by the first Acquire() that finds no free
+// texture of its kind, and deleted once it hasn't been acquired for KEEP_FRAMES frames, so after a resize the
+// targets of the old size go away on their own. Framebuffers are cached per combination of attachments and deleted
+// together with their targets.
+// A free texture that was acquired under the same name in the previous frame is preferred, that keeps the assignment
+// of textures to passes (and with it the cached framebuffers) the same from frame to frame. Names have to outlive
+// the pool, string literals.
+// GL thread only.
+class RenderTargetPool {
+public:
+    static const unsigned int KEEP_FRAMES = 3;
+    static const int MAX_COLOR_ATTACHMENTS = 4;
+
+    RenderTargetPool() = default;
+    ~RenderTargetPool() {
+        Clear();
+    }
+    RenderTargetPool(const RenderTargetPool&) = delete;
+    RenderTargetPool& operator=(const RenderTargetPool&) = delete;
+
+    // deletes the targets that weren't used for a while, targets still acquired from the last frame stay
+    void BeginFrame() {
+        m_Frame++;
+        for (size_t i = 0; i < m_Targets.size();) {
+            Target& target = m_Targets[i];
+            if (!target.names.empty()) {
+                if (target.names != target.previousNames)
+                    relabel(target);
+                std::swap(target.names, target.previousNames);
+                target.names.clear();
+            }
+            if (!target.acquired && m_Frame - target.lastFrame > KEEP_FRAMES) {
+                destroy(target);
+                m_Targets.erase(m_Targets.begin() + i);
+            } else {
+                i++;
+            }
+        }
+    }
+
+    // a texture of desc that no one else holds until Release()
+    unsigned int Acquire(const RenderTargetDesc& desc, const char* name) {
+        Target* found = nullptr;
+        for (Target& target : m_Targets) {
+            if (target.acquired || !(target.desc == desc))
+                continue;
+            if (!found)
+                found = &target;
+            if (contains(target.previousNames, name)) {
+                found = &target;
+                break;
+            }
+        }
+        if (!found)
+            found = create(desc, name);
+        found->acquired = true;
+        found->lastFrame = m_Frame;
+        if (!contains(found->names, name))
+            found->names.push_back(name);
+        return found->texture;
+    }
+    void Release(unsigned int texture) {
+        if (Target* target = find(texture))
+            target->acquired = false;
+    }
+
+    // framebuffer with the given targets attached, all color attachments are drawn to
+    unsigned int Framebuffer(std::initializer_list<unsigned int> colors, unsigned int depth = 0) {
+        for (CachedFramebuffer& cached : m_Framebuffers) {
+            if (cached.depth == depth && cached.colorCount == (int) colors.size() &&
+                std::equal(colors.begin(), colors.end(), cached.colors))
+                return cached.fbo;
+        }
+        CachedFramebuffer cached;
+        cached.colorCount = std::min((int) colors.size(), MAX_COLOR_ATTACHMENTS);
+        std::copy(colors.begin(), colors.begin() + cached.colorCount, cached.colors);
+        cached.depth = depth;
+        glGenFramebuffers(1, &cached.fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, cached.fbo);
+        GLenum drawBuffers[MAX_COLOR_ATTACHMENTS];
+        for (int i = 0; i < cached.colorCount; i++) {
+            attach(GL_COLOR_ATTACHMENT0 + i, cached.colors[i]);
+            drawBuffers[i] = GL_COLOR_ATTACHMENT0 + i;
+        }
+        if (depth) {
+            const Target* target = find(depth);
+            bool stencil = target && isDepthStencil(target->desc.internalFormat);
+            attach(stencil ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT, depth);
+        }
+        if (cached.colorCount > 0) {
+            glDrawBuffers(cached.colorCount, drawBuffers);
+        } else {
+            glDrawBuffer(GL_NONE);
+            glReadBuffer(GL_NONE);
+        }
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            LOG_ERROR(Render, "Framebuffer not complete!");
+        m_Framebuffers.push_back(cached);
+        return cached.fbo;
+    }
+
+    void Clear() {
+        for (Target& target : m_Targets)
+            destroy(target);
+        m_Targets.clear();
+    }
+
+    // preferred if the driver can render to it, fallback otherwise. GL 3.3 only guarantees a few formats to be color
+    // renderable (RGB16F isn't one of them), the answer is cached per format.
+    GLenum RenderableFormat(GLenum preferred, GLenum fallback) {
+        for (const std::pair<GLenum, bool>& known : m_Renderable) {
+            if (known.first == preferred)
+                return known.second ? preferred : fallback;
+        }
+        bool renderable = ColorRenderable(preferred);
+        if (!renderable)
+            LOG_WARNING(Render, "%s isn't color renderable, render targets use %s instead", FormatName(preferred),
+                        FormatName(fallback));
+        m_Renderable.emplace_back(preferred, renderable);
+        return renderable ? preferred : fallback;
+    }
+    // whether a framebuffer with a texture of internalFormat as its only attachment is complete
+    static bool ColorRenderable(GLenum internalFormat) {
+        GLint previous = 0;
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous);
+        unsigned int texture, fbo;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, 4, 4, 0, GL_RGBA, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+        bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+        glBindFramebuffer(GL_FRAMEBUFFER, previous);
+        glDeleteFramebuffers(1, &fbo);
+        glDeleteTextures(1, &texture);
+        return complete;
+    }
+    static const char* FormatName(GLenum internalFormat) {
+        switch (internalFormat) {
+            case GL_RGBA8: return "RGBA8";
+            case GL_RGB16F: return "RGB16F";
+            case GL_RGBA16F: return "RGBA16F";
+            case GL_R11F_G11F_B10F: return "R11F_G11F_B10F";
+            case GL_RGBA32F: return "RGBA32F";
+            case GL_DEPTH_COMPONENT24: return "DEPTH24";
+            case GL_DEPTH_COMPONENT32F: return "DEPTH32F";
+            case GL_DEPTH24_STENCIL8: return "DEPTH24_STENCIL8";
+            default: return "?";
+        }
+    }
+
+    size_t TargetCount() const { return m_Targets.size(); }
+    size_t ResidentBytes() const { return m_Resident; }
+    size_t PeakBytes() const { return m_Peak; }
+    unsigned long long Allocations() const { return m_Allocations; }
+    unsigned long long Frees() const { return m_Frees; }
+
+private:
+    struct Target {
+        RenderTargetDesc desc;
+        unsigned int texture = 0;
+        size_t bytes = 0;
+        bool acquired = false;
+        unsigned long long lastFrame = 0;
+        std::vector<const char*> names;         // acquired under in this frame
+        std::vector<const char*> previousNames; // and in the last one
+        std::string label;
+    };
+    struct CachedFramebuffer {
+        unsigned int fbo = 0;
+        unsigned int colors[MAX_COLOR_ATTACHMENTS] = {};
+        int colorCount = 0;
+        unsigned int depth = 0;
+    };
+
+    static bool contains(const std::vector<const char*>& names, const char* name) {
+        for (const char* other : names) {
+            if (other == name || std::strcmp(other, name) == 0)
+                return true;
+        }
+        return false;
+    }
+    static bool isDepth(GLenum internalFormat) {
+        return internalFormat == GL_DEPTH_COMPONENT || internalFormat == GL_DEPTH_COMPONENT16 ||
+               internalFormat == GL_DEPTH_COMPONENT24 || internalFormat == GL_DEPTH_COMPONENT32F ||
+               isDepthStencil(internalFormat);
+    }
+    static bool isDepthStencil(GLenum internalFormat) {
+        return internalFormat == GL_DEPTH24_STENCIL8 || internalFormat == GL_DEPTH32F_STENCIL8;
+    }
+    Target* find(unsigned int texture) {
+        for (Target& target : m_Targets) {
+            if (target.texture == texture)
+                return &target;
+        }
+        return nullptr;
+    }
+    void attach(GLenum attachment, unsigned int texture) {
+        const Target* target = find(texture);
+        GLenum textureTarget = target && target->desc.samples > 1 ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D;
+        glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, textureTarget, texture, 0);
+    }
+
+    Target* create(const RenderTargetDesc& desc, const char* name) {
+        Target target;
+        target.desc = desc;
+        target.label = name;
+        glGenTextures(1, &target.texture);
+        if (desc.samples > 1) {
+            glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, target.texture);
+            glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, desc.samples, desc.internalFormat, desc.width,
+                                    desc.height, GL_TRUE);
+            glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);
+        } else {
+            glBindTexture(GL_TEXTURE_2D, target.texture);
+            GLenum format = isDepthStencil(desc.internalFormat) ? GL_DEPTH_STENCIL
+                            : isDepth(desc.internalFormat) ? GL_DEPTH_COMPONENT : GL_RGBA;
+            GLenum type = isDepthStencil(desc.internalFormat) ? GL_UNSIGNED_INT_24_8 : GL_FLOAT;
+            glTexImage2D(GL_TEXTURE_2D, 0, desc.internalFormat, desc.width, desc.height, 0, format, type, NULL);
+            GLint filter = isDepth(desc.internalFormat) ? GL_NEAREST : GL_LINEAR;
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+            // post-processing filters sample past the edges, clamping keeps them from wrapping around
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glBindTexture(GL_TEXTURE_2D, 0);
+        }
+        target.bytes = MemoryTracker::TextureBytes(desc.internalFormat, desc.width, desc.height) * desc.samples;
+        GLDebug::Label(GL_TEXTURE, target.texture, target.label);
+        MemoryTracker::Instance().Track(MemoryTracker::Kind::Texture, target.texture, target.label, target.bytes,
+                                        "Render target pool");
+        m_Resident += target.bytes;
+        m_Peak = std::max(m_Peak, m_Resident);
+        m_Allocations++;
+        LOG_INFO(Render, "Render target %s: %dx%d %s x%d", name, desc.width, desc.height,
+                 FormatName(desc.internalFormat), desc.samples);
+        m_Targets.push_back(target);
+        return &m_Targets.back();
+    }
+    void destroy(Target& target) {
+        for (size_t i = 0; i < m_Framebuffers.size();) {
+            const CachedFramebuffer& cached = m_Framebuffers[i];
+            bool uses = cached.depth == target.texture ||
+                        std::find(cached.colors, cached.colors + cached.colorCount, target.texture) !=
+                        cached.colors + cached.colorCount;
+            if (uses) {
+                glDeleteFramebuffers(1, &cached.fbo);
+                m_Framebuffers.erase(m_Framebuffers.begin() + i);
+            } else {
+                i++;
+            }
+        }
+        MemoryTracker::Instance().Untrack(MemoryTracker::Kind::Texture, target.texture);
+        glDeleteTextures(1, &target.texture);
+        m_Resident -= target.bytes;
+        m_Frees++;
+    }
+    // names the texture after every pass that used it in the last frame
+    void relabel(Target& target) {
+        std::string label;
+        for (const char* name : target.names)
+            label += (label.empty() ? "" : " / ") + std::string(name);
+        target.label = label;
+        GLDebug::Label(GL_TEXTURE, target.texture, target.label);
+        MemoryTracker::Instance().Track(MemoryTracker::Kind::Texture, target.texture, target.label, target.bytes,
+                                        "Render target pool");
+    }
+
+    std::vector<Target> m_Targets;
+    std::vector<CachedFramebuffer> m_Framebuffers;
+    std::vector<std::pair<GLenum, bool>> m_Renderable;
+    unsigned long long m_Frame = 0;
+    size_t m_Resident = 0;
+    size_t m_Peak = 0;
+    unsigned long long m_Allocations = 0;
+    unsigned long long m_Frees = 0;
+};
+
+// Follows the window size for the render targets. While a window is being dragged its size changes every frame,
+// a new size is only taken over once it stayed the same for a while. A minimized window (size 0) keeps the last one.
+class SettledSize {
+public:
+    SettledSize(int width, int height, float settleSeconds = 0.2f)
+            : m_Width(std::max(width, 1)), m_Height(std::max(height, 1)), m_PendingWidth(m_Width),
+              m_PendingHeight(m_Height), m_SettleSeconds(settleSeconds) {}
+
+    // true when the settled size changed
+    bool Update(int width, int height) {
+        if (width <= 0 || height <= 0)
+            return false;
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (width != m_PendingWidth || height != m_PendingHeight) {
+            m_PendingWidth = width;
+            m_PendingHeight = height;
+            m_Changed = now;
+        }
+        if ((m_PendingWidth == m_Width && m_PendingHeight == m_Height) ||
+            std::chrono::duration<float>(now - m_Changed).count() < m_SettleSeconds)
+            return false;
+        m_Width = m_PendingWidth;
+        m_Height = m_PendingHeight;
+        return true;
+    }
+
+    int Width() const { return m_Width; }
+    int Height() const { return m_Height; }
+
+private:
+    int m_Width, m_Height;
+    int m_PendingWidth, m_PendingHeight;
+    float m_SettleSeconds;
+    std::chrono::steady_clock::time_point m_Changed;
+};
+
+};
+
+#endif //PROJECT_BASE_RENDERTARGETPOOL_H
@@ -0,0 +1,126 @@
+#ifndef PROJECT_BASE_RENDERTHREAD_H
+#define PROJECT_BASE_RENDERTHREAD_H
+
+#include "imgui.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+namespace rg {
+
+// Hands frames from the simulation (main thread) to the render thread through three packets: one the simulation
+// fills, one the render thread draws and the newest published one in between. Publishing and acquiring swap the
+// packet indices with a single atomic exchange, the handoff itself never takes a lock. The simulation stays at most
+// one packet ahead: Publish() waits while the previous packet hasn't been picked up, so no frame is dropped and the
+// input latency is bounded. Waiting sleeps on a condition variable, the mutex is only touched when a side sleeps.
+// Simulation and render thread may also be the same thread (Publish, then Acquire).
+template<typename Packet>
+class FrameHandoff {
+public:
+    FrameHandoff() = default;
+    FrameHandoff(const FrameHandoff&) = delete;
+    FrameHandoff& operator=(const FrameHandoff&) = delete;
+
+    // simulation: the packet to fill, it belongs to the simulation until Publish()
+    Packet& Write() { return m_Packets[m_Write]; }
+    // simulation: hands the written packet to the render thread
+    void Publish() {
+        waitFor([this]() { return !(m_Ready.load() & FRESH) || m_Closed.load(); });
+        m_Write = m_Ready.exchange(m_Write | FRESH) & INDEX;
+        wake();
+    }
+    // simulation: Acquire() returns nullptr from now on
+    void Close() {
+        m_Closed.store(true);
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Wake.notify_all();
+    }
+    bool Closed() const { return m_Closed.load(); }
+
+    // render thread: the newest published packet, waits for one; nullptr once the handoff is closed
+    Packet* Acquire() {
+        waitFor([this]() { return (m_Ready.load() & FRESH) || m_Closed.load(); });
+        if (m_Closed.load())
+            return nullptr;
+        m_Read = m_Ready.exchange(m_Read) & INDEX;
+        wake();
+        return &m_Packets[m_Read];
+    }
+    // render thread: done with the packet of the last Acquire()
+    void Release() {
+        m_Rendered.fetch_add(1);
+        wake();
+    }
+    unsigned long long Rendered() const { return m_Rendered.load(); }
+
+private:
+    static const unsigned int INDEX = 3;
+    static const unsigned int FRESH = 4; // set while the middle packet hasn't been acquired yet
+
+    // sequentially consistent on both sides: either the waker sees the sleeper or the sleeper sees the new state
+    template<typename Condition>
+    void waitFor(const Condition& condition) {
+        if (condition())
+            return;
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_Sleeping.fetch_add(1);
+        m_Wake.wait(lock, condition);
+        m_Sleeping.fetch_sub(1);
+    }
+    void wake() {
+        if (m_Sleeping.load() > 0) {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Wake.notify_all();
+        }
+    }
+
+    Packet m_Packets[3];
+    unsigned int m_Write = 0;          // simulation only
+    unsigned int m_Read = 2;           // render thread only
+    std::atomic<unsigned int> m_Ready{1};
+    std::atomic<unsigned long long> m_Rendered{0};
+    std::atomic<bool> m_Closed{false};
+    std::atomic<int> m_Sleeping{0};
+    std::mutex m_Mutex;
+    std::condition_variable m_Wake;
+};
+
+// A copy of ImGui's draw data that survives the next NewFrame(), the UI is built on the main thread and drawn on
+// the render thread. ImGui allocates the copies through malloc.
+class ImGuiFrame {
+public:
+    ImGuiFrame() = default;
+    ImGuiFrame(const ImGuiFrame&) = delete;
+    ImGuiFrame& operator=(const ImGuiFrame&) = delete;
+    ~ImGuiFrame() {
+        Clear();
+    }
+
+    // after ImGui::Render()
+    void Capture(const ImDrawData* drawData) {
+        Clear();
+        if (!drawData || !drawData->Valid)
+            return;
+        m_Data = *drawData;
+        m_Lists.resize(drawData->CmdListsCount);
+        for (int i = 0; i < drawData->CmdListsCount; i++)
+            m_Lists[i] = drawData->CmdLists[i]->CloneOutput();
+        m_Data.CmdLists = m_Lists.Data;
+    }
+    void Clear() {
+        for (ImDrawList* list : m_Lists)
+            IM_DELETE(list);
+        m_Lists.resize(0);
+        m_Data.Clear();
+    }
+    // nullptr when nothing was captured
+    ImDrawData* Data() { return m_Data.Valid ? &m_Data : nullptr; }
+
+private:
+    ImDrawData m_Data;
+    ImVector<ImDrawList*> m_Lists;
+};
+
+};
+
+#endif //PROJECT_BASE_RENDERTHREAD_H
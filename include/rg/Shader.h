@@ -35,7 +35,7 @@ public:
         if (!success)
         {
             glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
-            std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
+            LOG_ERROR(Shader, "Vertex shader compilation failed\n%s", infoLog);
         }
         // fragment shader
         int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
@@ -49,7 +49,7 @@ public:
         if (!success)
         {
             glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
-            std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
+            LOG_ERROR(Shader, "Fragment shader compilation failed\n%s", infoLog);
         }
         // link shaders
         int shaderProgram = glCreateProgram();
@@ -60,7 +60,7 @@ public:
         glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
         if (!success) {
             glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
-            std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+            LOG_ERROR(Shader, "Program linking failed\n%s", infoLog);
         }
         glDeleteShader(vertexShader);
         glDeleteShader(fragmentShader);
@@ -0,0 +1,271 @@
+#ifndef PROJECT_BASE_STARTUPTRACER_H
+#define PROJECT_BASE_STARTUPTRACER_H
+
+#include <rg/Log.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#define STARTUP_CONCAT_(a, b) a##b
+#define STARTUP_CONCAT(a, b) STARTUP_CONCAT_(a, b)
+#define STARTUP_SCOPE(name) rg::StartupScope STARTUP_CONCAT(startupScope, __LINE__)(name)
+
+namespace rg {
+
+// Timeline of the cold start, from the first line of main until the first frame is on screen.
+// Startup is a sequence of phases (Phase() ends the previous one), asset loaders open nested scopes, and work
+// that overlaps the phases (shader compilation) is recorded as an async span. Every span gets wall time,
+// process CPU time and the bytes the process read meanwhile (rchar of /proc/self/io, 0 where not available).
+// Finish() logs a summary, flags phases over their budget and writes a Chrome trace. Main thread only,
+// after Finish() nothing is recorded any more.
+class StartupTracer {
+public:
+    static StartupTracer& Instance() {
+        static StartupTracer tracer;
+        return tracer;
+    }
+    StartupTracer(const StartupTracer&) = delete;
+    StartupTracer& operator=(const StartupTracer&) = delete;
+
+    // total cold start budget, phases without their own budget get a quarter of it
+    void SetTotalBudget(double ms) { m_TotalBudgetMs = ms; }
+    void SetBudget(const std::string& phase, double ms) { m_Budgets[phase] = ms; }
+    // "<ms>" sets the total budget, "<phase>=<ms>" the budget of one phase
+    void ParseBudget(const std::string& value) {
+        size_t split = value.find('=');
+        if (split == std::string::npos)
+            SetTotalBudget(std::atof(value.c_str()));
+        else
+            SetBudget(value.substr(0, split), std::atof(value.c_str() + split + 1));
+    }
+
+    void Phase(const std::string& name) {
+        if (m_Finished)
+            return;
+        endPhase();
+        m_Phase = open(name, 0, false);
+    }
+    // nested under whatever is open, returns the span to pass to End
+    int Begin(const std::string& name) {
+        if (m_Finished)
+            return -1;
+        int index = open(name, (unsigned int) m_Open.size() + (m_Phase >= 0 ? 1 : 0), false);
+        m_Open.push_back(index);
+        return index;
+    }
+    // runs next to the phases, it is shown on its own track
+    int BeginAsync(const std::string& name) {
+        if (m_Finished)
+            return -1;
+        return open(name, 0, true);
+    }
+    void End(int index) {
+        if (index < 0 || m_Finished)
+            return;
+        close(m_Spans[index]);
+        if (!m_Open.empty() && m_Open.back() == index)
+            m_Open.pop_back();
+    }
+
+    bool Finished() const { return m_Finished; }
+    // startup is over: closes what's still open, reports and writes the trace
+    void Finish(const std::string& tracePath) {
+        if (m_Finished)
+            return;
+        endPhase();
+        for (Span& span : m_Spans) {
+            if (span.open)
+                close(span);
+        }
+        m_TotalMs = now() / 1000.0;
+        m_Finished = true;
+        report();
+        if (writeTrace(tracePath))
+            LOG_INFO(Startup, "Startup trace written to %s", tracePath.c_str());
+    }
+
+    // total and per phase times, also part of the benchmark results
+    void WriteSummaryJson(std::ostream& out) const {
+        char buffer[256];
+        std::snprintf(buffer, sizeof(buffer), "{\"totalMs\": %.2f, \"budgetMs\": %.2f, \"phases\": [", m_TotalMs,
+                      m_TotalBudgetMs);
+        out << buffer;
+        bool first = true;
+        for (const Span& span : m_Spans) {
+            if (span.depth != 0)
+                continue;
+            std::snprintf(buffer, sizeof(buffer),
+                          "%s\n    {\"name\": \"%s\", \"wallMs\": %.2f, \"cpuMs\": %.2f, \"bytesRead\": %lld, \"overBudget\": %s}",
+                          first ? "" : ",", escape(span.name).c_str(), wallMs(span), span.cpuEnd - span.cpuStart,
+                          span.bytesEnd - span.bytesStart, overBudget(span) ? "true" : "false");
+            out << buffer;
+            first = false;
+        }
+        out << "\n  ]}";
+    }
+
+private:
+    struct Span {
+        std::string name;
+        unsigned int depth;
+        bool async;
+        bool open;
+        double wallStart, wallEnd; // microseconds since the tracer was created
+        double cpuStart, cpuEnd;   // milliseconds of process CPU time
+        long long bytesStart, bytesEnd;
+    };
+
+    StartupTracer() : m_Epoch(std::chrono::steady_clock::now()) {}
+
+    double now() const {
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - m_Epoch).count();
+    }
+    static double cpuMs() {
+        return 1000.0 * std::clock() / CLOCKS_PER_SEC;
+    }
+    // bytes passed to read() and friends so far, page cache hits included
+    static long long bytesRead() {
+#ifdef __linux__
+        std::ifstream io("/proc/self/io");
+        std::string key;
+        long long value;
+        while (io >> key >> value) {
+            if (key == "rchar:")
+                return value;
+        }
+#endif
+        return 0;
+    }
+
+    int open(const std::string& name, unsigned int depth, bool async) {
+        Span span;
+        span.name = name;
+        span.depth = depth;
+        span.async = async;
+        span.open = true;
+        span.wallStart = span.wallEnd = now();
+        span.cpuStart = span.cpuEnd = cpuMs();
+        span.bytesStart = span.bytesEnd = bytesRead();
+        m_Spans.push_back(span);
+        return (int) m_Spans.size() - 1;
+    }
+    void close(Span& span) {
+        span.wallEnd = now();
+        span.cpuEnd = cpuMs();
+        span.bytesEnd = bytesRead();
+        span.open = false;
+    }
+    void endPhase() {
+        if (m_Phase < 0)
+            return;
+        // scopes left open inside the phase end with it
+        for (int index : m_Open)
+            close(m_Spans[index]);
+        m_Open.clear();
+        close(m_Spans[m_Phase]);
+        m_Phase = -1;
+    }
+
+    static std::string escape(const std::string& text) {
+        std::string result;
+        for (char c : text) {
+            if (c == '"' || c == '\\')
+                result += '\\';
+            result += c;
+        }
+        return result;
+    }
+    static double wallMs(const Span& span) {
+        return (span.wallEnd - span.wallStart) / 1000.0;
+    }
+    double budget(const Span& span) const {
+        auto it = m_Budgets.find(span.name);
+        if (it != m_Budgets.end())
+            return it->second;
+        return span.depth == 0 ? m_TotalBudgetMs / 4.0 : 0.0;
+    }
+    bool overBudget(const Span& span) const {
+        double limit = budget(span);
+        return limit > 0.0 && wallMs(span) > limit;
+    }
+
+    void report() const {
+        LOG_REPORT(Startup, "%-40s %9s %9s %9s", "Phase / asset", "wall ms", "cpu ms", "KB read");
+        for (const Span& span : m_Spans) {
+            std::string name = std::string(2 * span.depth, ' ') + (span.async ? "[async] " : "") + span.name;
+            if (name.size() > 40)
+                name = "..." + name.substr(name.size() - 37);
+            LOG_REPORT(Startup, "%-40s %9.2f %9.2f %9.1f%s", name.c_str(), wallMs(span), span.cpuEnd - span.cpuStart,
+                     (span.bytesEnd - span.bytesStart) / 1024.0, overBudget(span) ? "  OVER BUDGET" : "");
+        }
+        // one warning, then the phases from an unlimited site, however many there are
+        unsigned int over = 0;
+        for (const Span& span : m_Spans)
+            over += overBudget(span);
+        if (over)
+            LOG_WARNING(Startup, "%u phases / assets over budget:", over);
+        for (const Span& span : m_Spans) {
+            if (overBudget(span))
+                LOG_REPORT(Startup, "  %s took %.1f ms, budget %.1f ms", span.name.c_str(), wallMs(span), budget(span));
+        }
+        if (m_TotalMs > m_TotalBudgetMs)
+            LOG_WARNING(Startup, "Cold start took %.1f ms, budget %.1f ms", m_TotalMs, m_TotalBudgetMs);
+        else
+            LOG_INFO(Startup, "Cold start took %.1f ms (budget %.1f ms)", m_TotalMs, m_TotalBudgetMs);
+    }
+
+    // Chrome trace (chrome://tracing, ui.perfetto.dev), phases on the main track, async spans on the second
+    bool writeTrace(const std::string& path) const {
+        std::ofstream out(path);
+        if (!out)
+            return false;
+        char buffer[512];
+        out << "{\"traceEvents\": [\n";
+        out << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 1, \"args\": {\"name\": \"Startup\"}},\n";
+        out << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 2, \"args\": {\"name\": \"Async\"}}";
+        for (const Span& span : m_Spans) {
+            std::snprintf(buffer, sizeof(buffer),
+                          ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f, "
+                          "\"args\": {\"cpuMs\": %.3f, \"bytesRead\": %lld, \"overBudget\": %s}}",
+                          escape(span.name).c_str(), span.async ? 2 : 1, span.wallStart, span.wallEnd - span.wallStart,
+                          span.cpuEnd - span.cpuStart, span.bytesEnd - span.bytesStart,
+                          overBudget(span) ? "true" : "false");
+            out << buffer;
+        }
+        out << "\n]}\n";
+        return (bool) out;
+    }
+
+    std::chrono::steady_clock::time_point m_Epoch;
+    std::vector<Span> m_Spans;
+    std::vector<int> m_Open;
+    int m_Phase = -1;
+    bool m_Finished = false;
+    double m_TotalMs = 0.0;
+    double m_TotalBudgetMs = 1000.0;
+    std::map<std::string, double> m_Budgets;
+};
+
+// times an asset or sub step of the current startup phase
+class StartupScope {
+public:
+    explicit StartupScope(const std::string& name)
+            : m_Index(StartupTracer::Instance().Begin(name)) {}
+    ~StartupScope() {
+        StartupTracer::Instance().End(m_Index);
+    }
+    StartupScope(const StartupScope&) = delete;
+    StartupScope& operator=(const StartupScope&) = delete;
+private:
+    int m_Index;
+};
+
+};
+
+#endif //PROJECT_BASE_STARTUPTRACER_H
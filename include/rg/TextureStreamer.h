@@ -0,0 +1,370 @@
+#ifndef PROJECT_BASE_TEXTURESTREAMER_H
+#define PROJECT_BASE_TEXTURESTREAMER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "imgui.h"
+#include <rg/Bounds.h>
+#include <rg/GLDebug.h>
+#include <rg/MemoryTracker.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace rg {
+
+// Mip level streaming of the model textures. The whole mip chain is built on the CPU at load time, but only the
+// small levels are uploaded then. Every frame the renderer reports how many pixels each texture covers on screen
+// and the finer levels are streamed in coarse to fine, a few megabytes per frame, as an object gets closer.
+// GL_TEXTURE_BASE_LEVEL clamps sampling to the finest resident level, so the texture name never changes.
+// When the resident levels would exceed the VRAM budget, the finest levels of the textures that were needed least
+// recently are evicted first; textures in view only give up levels they don't need or when the budget was lowered.
+// GL thread only, except DrawWindow(), which shows the state Update() published and may run on any thread.
+class TextureStreamer {
+public:
+    // levels of this size and smaller are uploaded at load time and never evicted
+    static const int RESIDENT_SIZE = 64;
+    // streaming uploads at most this much per frame, but always at least one level
+    static const size_t UPLOAD_BYTES_PER_FRAME = 8 * 1024 * 1024;
+
+    static TextureStreamer& Instance() {
+        static TextureStreamer streamer;
+        return streamer;
+    }
+    TextureStreamer(const TextureStreamer&) = delete;
+    TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+    // creates a texture from tightly packed 8 bit pixels with 1 to 4 components and keeps a copy of its mip chain,
+    // the pixels aren't referenced afterwards
+    unsigned int Create(const std::string& name, const unsigned char* pixels, int width, int height, int components) {
+        Entry entry;
+        entry.name = name;
+        entry.owner = MemoryTracker::Instance().Owner();
+        const GLenum formats[] = {GL_RED, GL_RG, GL_RGB, GL_RGBA};
+        entry.format = formats[std::min(std::max(components, 1), 4) - 1];
+        entry.cutout = components == 4 && hasCutout(pixels, (size_t) width * height);
+        buildLevels(entry, pixels, width, height, components);
+        entry.tail = 0;
+        while (std::max(entry.levels[entry.tail].width, entry.levels[entry.tail].height) > RESIDENT_SIZE)
+            entry.tail++;
+        entry.base = entry.levels.size();
+        entry.wanted = entry.tail;
+
+        glGenTextures(1, &entry.texture);
+        glBindTexture(GL_TEXTURE_2D, entry.texture);
+        GLDebug::Label(GL_TEXTURE, entry.texture, name);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, entry.levels.size() - 1);
+        while (entry.base > entry.tail)
+            upload(entry, entry.base - 1);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        MemoryTracker::Instance().Track(MemoryTracker::Kind::Cpu, entry.texture | CPU_COPY, name + " (mip chain)",
+                                        entry.pixels.size(), entry.owner);
+
+        m_Index[entry.texture] = m_Entries.size();
+        m_Entries.push_back(std::move(entry));
+        return m_Entries.back().texture;
+    }
+
+    // render thread: about pixels texels of the texture's top level are needed across the screen this frame,
+    // textures that weren't created here are ignored
+    void Request(unsigned int texture, float pixels) {
+        auto it = m_Index.find(texture);
+        if (it == m_Index.end())
+            return;
+        Entry& entry = m_Entries[it->second];
+        int size = std::max(entry.levels[0].width, entry.levels[0].height);
+        int level = pixels >= 1.0f ? (int) std::floor(std::log2(size / pixels)) : entry.tail;
+        level = std::min(std::max(level, 0), entry.tail);
+        entry.wanted = entry.lastNeeded == m_Frame ? std::min(entry.wanted, level) : level;
+        entry.lastNeeded = m_Frame;
+    }
+
+    // once per frame after the requests: streams in the wanted levels and keeps the resident levels in the budget
+    void Update() {
+        glActiveTexture(GL_TEXTURE0);
+        size_t uploaded = 0;
+        bool progress = true;
+        // one level per texture and round, so the textures in view sharpen together
+        while (progress) {
+            progress = false;
+            for (Entry& entry : m_Entries) {
+                if (entry.lastNeeded != m_Frame || entry.wanted >= entry.base)
+                    continue;
+                size_t bytes = entry.levels[entry.base - 1].gpuBytes;
+                if (uploaded && uploaded + bytes > UPLOAD_BYTES_PER_FRAME)
+                    continue;
+                if (m_Resident + bytes > m_Budget && !evict(m_Resident + bytes - m_Budget, false))
+                    continue;
+                glBindTexture(GL_TEXTURE_2D, entry.texture);
+                upload(entry, entry.base - 1);
+                uploaded += bytes;
+                progress = true;
+            }
+        }
+        // a lowered budget trims textures in view as well
+        if (m_Resident > m_Budget)
+            evict(m_Resident - m_Budget, true);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        m_Uploaded = uploaded;
+        m_Frame++;
+        publish();
+    }
+
+    // the texture has an alpha channel with texels below one half, materials using it for color are alpha tested
+    bool Cutout(unsigned int texture) const {
+        auto it = m_Index.find(texture);
+        return it != m_Index.end() && m_Entries[it->second].cutout;
+    }
+
+    void SetBudget(size_t bytes) { m_Budget = bytes; }
+    size_t Budget() const { return m_Budget; }
+    size_t ResidentBytes() const { return m_Resident; }
+    // bytes if every level of every texture was resident
+    size_t FullBytes() const {
+        size_t bytes = 0;
+        for (const Entry& entry : m_Entries)
+            bytes += entry.fullBytes;
+        return bytes;
+    }
+
+    // diameter in pixels of a world space box seen through a perspective camera
+    static float ScreenSize(const Aabb& bounds, const glm::mat4& view, float fovY, int viewportHeight) {
+        glm::vec3 center = (bounds.min + bounds.max) * 0.5f;
+        float radius = glm::length(bounds.max - bounds.min) * 0.5f;
+        float distance = glm::length(glm::vec3(view * glm::vec4(center, 1.0f)));
+        if (distance <= radius)
+            return (float) viewportHeight;
+        return radius / (distance * std::tan(fovY * 0.5f)) * viewportHeight;
+    }
+
+    // residency of every texture, finest levels first
+    void DrawWindow() {
+        {
+            std::lock_guard<std::mutex> lock(m_ShownMutex);
+            m_Drawn.resident = m_Shown.resident;
+            m_Drawn.budget = m_Shown.budget;
+            m_Drawn.full = m_Shown.full;
+            m_Drawn.uploaded = m_Shown.uploaded;
+            m_Drawn.evictions = m_Shown.evictions;
+            m_Drawn.rows.assign(m_Shown.rows.begin(), m_Shown.rows.end());
+        }
+        ImGui::Text("Resident %.1f MB of %.1f MB budget, %.1f MB with all levels", megabytes(m_Drawn.resident),
+                    megabytes(m_Drawn.budget), megabytes(m_Drawn.full));
+        ImGui::Text("Streamed %.2f MB last frame, %llu levels evicted so far", megabytes(m_Drawn.uploaded),
+                    m_Drawn.evictions);
+        std::sort(m_Drawn.rows.begin(), m_Drawn.rows.end(), [](const Row& a, const Row& b) {
+            return a.width > b.width;
+        });
+        ImGui::Columns(4, "textureStreamer");
+        ImGui::Text("Texture");
+        ImGui::NextColumn();
+        ImGui::Text("Resident");
+        ImGui::NextColumn();
+        ImGui::Text("Wanted");
+        ImGui::NextColumn();
+        ImGui::Text("MB");
+        ImGui::NextColumn();
+        for (const Row& row : m_Drawn.rows) {
+            ImGui::Text("%s", row.name);
+            ImGui::NextColumn();
+            ImGui::Text("%dx%d of %dx%d", row.width, row.height, row.fullWidth, row.fullHeight);
+            ImGui::NextColumn();
+            if (row.wantedWidth)
+                ImGui::Text("%dx%d", row.wantedWidth, row.wantedHeight);
+            else
+                ImGui::Text("-");
+            ImGui::NextColumn();
+            ImGui::Text("%.2f", megabytes(row.residentBytes));
+            ImGui::NextColumn();
+        }
+        ImGui::Columns(1);
+    }
+
+private:
+    // CPU copies are tracked under the texture name with this bit set, mesh copies use their VAO names
+    static const unsigned int CPU_COPY = 0x80000000u;
+
+    struct Level {
+        int width, height;
+        size_t offset;   // into the entry's pixels
+        size_t gpuBytes; // as the memory tracker counts it
+    };
+    struct Entry {
+        unsigned int texture = 0;
+        std::string name;
+        std::string owner;
+        GLenum format = GL_RGBA;
+        bool cutout = false;
+        std::vector<unsigned char> pixels; // all levels, finest first
+        std::vector<Level> levels;
+        int tail = 0;   // coarsest level that can be evicted is tail - 1
+        int base = 0;   // finest resident level
+        int wanted = 0; // finest level needed the last time the texture was seen
+        unsigned long long lastNeeded = 0;
+        size_t residentBytes = 0;
+        size_t fullBytes = 0;
+    };
+
+    TextureStreamer() = default;
+
+    static double megabytes(size_t bytes) { return bytes / (1024.0 * 1024.0); }
+
+    static bool hasCutout(const unsigned char* rgba, size_t texels) {
+        for (size_t i = 0; i < texels; i++) {
+            if (rgba[4 * i + 3] < 128)
+                return true;
+        }
+        return false;
+    }
+    // box filtered mip chain down to 1x1
+    static void buildLevels(Entry& entry, const unsigned char* pixels, int width, int height, int components) {
+        size_t total = 0;
+        for (int w = width, h = height;; w = std::max(1, w / 2), h = std::max(1, h / 2)) {
+            size_t gpuBytes = MemoryTracker::TextureBytes(entry.format, w, h);
+            entry.levels.push_back({w, h, total, gpuBytes});
+            total += (size_t) w * h * components;
+            entry.fullBytes += gpuBytes;
+            if (w == 1 && h == 1)
+                break;
+        }
+        entry.pixels.resize(total);
+        std::memcpy(entry.pixels.data(), pixels, (size_t) width * height * components);
+        for (size_t i = 1; i < entry.levels.size(); i++) {
+            const Level& source = entry.levels[i - 1];
+            const Level& level = entry.levels[i];
+            const unsigned char* src = entry.pixels.data() + source.offset;
+            unsigned char* dst = entry.pixels.data() + level.offset;
+            for (int y = 0; y < level.height; y++) {
+                int y0 = std::min(2 * y, source.height - 1), y1 = std::min(2 * y + 1, source.height - 1);
+                for (int x = 0; x < level.width; x++) {
+                    int x0 = std::min(2 * x, source.width - 1), x1 = std::min(2 * x + 1, source.width - 1);
+                    for (int c = 0; c < components; c++) {
+                        unsigned int sum = src[(y0 * source.width + x0) * components + c] +
+                                           src[(y0 * source.width + x1) * components + c] +
+                                           src[(y1 * source.width + x0) * components + c] +
+                                           src[(y1 * source.width + x1) * components + c];
+                        dst[(y * level.width + x) * components + c] = (unsigned char) ((sum + 2) / 4);
+                    }
+                }
+            }
+        }
+    }
+
+    // the texture has to be bound, level is the one above the current base
+    void upload(Entry& entry, int level) {
+        const Level& l = entry.levels[level];
+        // rows of the small levels aren't 4 byte aligned
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, level, entry.format, l.width, l.height, 0, entry.format, GL_UNSIGNED_BYTE,
+                     entry.pixels.data() + l.offset);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        entry.base = level;
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, entry.base);
+        entry.residentBytes += l.gpuBytes;
+        m_Resident += l.gpuBytes;
+        track(entry);
+    }
+    // the finest resident level goes, respecifying it with a zero size releases its storage
+    void evictLevel(Entry& entry) {
+        const Level& l = entry.levels[entry.base];
+        glBindTexture(GL_TEXTURE_2D, entry.texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, entry.base + 1);
+        glTexImage2D(GL_TEXTURE_2D, entry.base, entry.format, 0, 0, 0, entry.format, GL_UNSIGNED_BYTE, NULL);
+        entry.base++;
+        entry.residentBytes -= l.gpuBytes;
+        m_Resident -= l.gpuBytes;
+        m_Evictions++;
+        track(entry);
+    }
+    // frees at least bytes, least recently needed textures first. Textures needed this frame only give up levels
+    // finer than they want, unless inView is set.
+    bool evict(size_t bytes, bool inView) {
+        size_t freed = 0;
+        while (freed < bytes) {
+            Entry* victim = nullptr;
+            for (Entry& entry : m_Entries) {
+                if (entry.base >= entry.tail)
+                    continue;
+                if (entry.lastNeeded == m_Frame && entry.base >= entry.wanted && !inView)
+                    continue;
+                if (!victim || entry.lastNeeded < victim->lastNeeded ||
+                    (entry.lastNeeded == victim->lastNeeded && entry.base < victim->base))
+                    victim = &entry;
+            }
+            if (!victim)
+                return false;
+            freed += victim->levels[victim->base].gpuBytes;
+            evictLevel(*victim);
+        }
+        return true;
+    }
+    // copies what DrawWindow() shows, the rows only allocate when textures were added since the last frame
+    void publish() {
+        std::lock_guard<std::mutex> lock(m_ShownMutex);
+        m_Shown.resident = m_Resident;
+        m_Shown.budget = m_Budget;
+        m_Shown.full = FullBytes();
+        m_Shown.uploaded = m_Uploaded;
+        m_Shown.evictions = m_Evictions;
+        m_Shown.rows.resize(m_Entries.size());
+        for (size_t i = 0; i < m_Entries.size(); i++) {
+            const Entry& entry = m_Entries[i];
+            Row& row = m_Shown.rows[i];
+            size_t slash = entry.name.find_last_of('/');
+            std::snprintf(row.name, sizeof(row.name), "%s",
+                          entry.name.c_str() + (slash == std::string::npos ? 0 : slash + 1));
+            row.width = entry.levels[entry.base].width;
+            row.height = entry.levels[entry.base].height;
+            row.fullWidth = entry.levels[0].width;
+            row.fullHeight = entry.levels[0].height;
+            // wanted by the frame that just ended
+            bool needed = entry.lastNeeded + 1 == m_Frame;
+            row.wantedWidth = needed ? entry.levels[entry.wanted].width : 0;
+            row.wantedHeight = needed ? entry.levels[entry.wanted].height : 0;
+            row.residentBytes = entry.residentBytes;
+        }
+    }
+
+    void track(const Entry& entry) {
+        MemoryTracker::Instance().Track(MemoryTracker::Kind::Texture, entry.texture, entry.name, entry.residentBytes,
+                                        entry.owner);
+    }
+
+    // one line of the window
+    struct Row {
+        char name[64];
+        int width, height;
+        int fullWidth, fullHeight;
+        int wantedWidth, wantedHeight; // 0 when it wasn't needed
+        size_t residentBytes;
+    };
+    struct Shown {
+        size_t resident = 0, budget = 0, full = 0, uploaded = 0;
+        unsigned long long evictions = 0;
+        std::vector<Row> rows;
+    };
+
+    std::vector<Entry> m_Entries;
+    std::unordered_map<unsigned int, size_t> m_Index;
+    unsigned long long m_Frame = 1;
+    size_t m_Budget = 256 * 1024 * 1024;
+    size_t m_Resident = 0;
+    size_t m_Uploaded = 0;
+    unsigned long long m_Evictions = 0;
+    std::mutex m_ShownMutex;
+    Shown m_Shown;
+    Shown m_Drawn; // the drawing thread's copy of m_Shown
+};
+
+};
+
+#endif //PROJECT_BASE_TEXTURESTREAMER_H
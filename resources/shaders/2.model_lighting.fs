@@ -17,13 +17,22 @@ struct PointLight {
 
 struct Material {
     sampler2D texture_diffuse1;
+#ifdef HAS_SPECULAR_MAP
     sampler2D texture_specular1;
+#endif
+#ifdef HAS_NORMAL_MAP
+    sampler2D texture_normal1;
+#endif
 
     float shininess;
 };
 in vec2 TexCoords;
 in vec3 Normal;
 in vec3 FragPos;
+in float ViewDepth;
+#ifdef HAS_NORMAL_MAP
+in mat3 TBN;
+#endif
 
 struct DirLight{
     vec3 direction;
@@ -33,7 +42,6 @@ struct DirLight{
 
 };
 struct SpotLight {
-    bool turnOn;
     vec3 position;
     vec3 direction;
     vec3 color;
@@ -49,16 +57,103 @@ struct SpotLight {
     vec3 diffuse;
     vec3 specular;
 };
-uniform PointLight pointLight;
+#if NUM_POINT_LIGHTS > 0
+uniform PointLight pointLights[NUM_POINT_LIGHTS];
+#endif
 uniform Material material;
 uniform DirLight dirLight;
 uniform SpotLight spotLight;
 
 uniform vec3 viewPosition;
+
+// debug views: 1 counts the fragments shaded per pixel (blended additively), 2 shows the light evaluation cost of the
+// fragment, 3 the id of the mesh it belongs to
+#if DEBUG_VIEW == 3
+uniform int debugId;
+#endif
+// lights evaluated plus shadow filters, a filter of 4 taps costs as much as a light. Only the cost view reads it,
+// every other permutation optimizes it away
+float lightCost = 0.0;
+
+// omnidirectional shadows of the point light, static and dynamic casters are kept in separate cube maps
+uniform samplerCube pointShadowStatic;
+uniform samplerCube pointShadowDynamic;
+uniform float pointShadowFar;
+uniform bool pointShadows;
+
+// returns 1.0 when the fragment is in shadow of the point light
+float CalcPointShadow(vec3 lightPos, vec3 fragPos)
+{
+    const vec3 sampleOffsets[4] = vec3[](
+        vec3( 1,  1,  1), vec3( 1, -1, -1),
+        vec3(-1,  1, -1), vec3(-1, -1,  1)
+    );
+    vec3 fragToLight = fragPos - lightPos;
+    float currentDepth = length(fragToLight);
+    float bias = 0.15;
+    float diskRadius = (1.0 + currentDepth / pointShadowFar) / 50.0;
+    float shadow = 0.0;
+    for (int i = 0; i < 4; ++i) {
+        vec3 dir = fragToLight + sampleOffsets[i] * diskRadius;
+        // dynamic casters are rendered "on top" of the cached static ones, take the closer occluder
+        float closestDepth = min(texture(pointShadowStatic, dir).r, texture(pointShadowDynamic, dir).r);
+        closestDepth *= pointShadowFar;
+        if (currentDepth - bias > closestDepth)
+            shadow += 1.0;
+        lightCost += 0.25;
+    }
+    return shadow / 4.0;
+}
+
+// cascaded shadow maps of the directional light, one layer per cascade
+uniform sampler2DArrayShadow cascadeShadowMap;
+uniform mat4 cascadeLightSpace[4];
+uniform float cascadeSplits[4];
+uniform int cascadeCount;
+uniform bool dirShadows;
+
+// returns 1.0 when the fragment is in shadow of the directional light
+float CalcDirShadow(vec3 fragPos, vec3 normal, vec3 lightDir)
+{
+    int cascade = -1;
+    for (int i = 0; i < cascadeCount; ++i) {
+        if (ViewDepth < cascadeSplits[i]) {
+            cascade = i;
+            break;
+        }
+    }
+    // beyond the shadow distance
+    if (cascade < 0)
+        return 0.0;
+    vec4 lightSpacePos = cascadeLightSpace[cascade] * vec4(fragPos, 1.0);
+    vec3 projCoords = lightSpacePos.xyz / lightSpacePos.w * 0.5 + 0.5;
+    if (projCoords.z > 1.0)
+        return 0.0;
+    float bias = max(0.002 * (1.0 - dot(normal, lightDir)), 0.0005);
+    vec2 texelSize = 1.0 / vec2(textureSize(cascadeShadowMap, 0).xy);
+    float lit = 0.0;
+    for (int x = 0; x < 2; ++x)
+        for (int y = 0; y < 2; ++y)
+            lit += texture(cascadeShadowMap, vec4(projCoords.xy + (vec2(x, y) - 0.5) * texelSize, cascade, projCoords.z - bias));
+    lightCost += 1.0;
+    return 1.0 - lit / 4.0;
+}
+
+// specular intensity of the material, meshes without a specular map use a constant one
+vec3 SampleSpecular()
+{
+#ifdef HAS_SPECULAR_MAP
+    return vec3(texture(material.texture_specular1, TexCoords));
+#else
+    return vec3(0.5);
+#endif
+}
+
 // calculates the color when using a point light.
 
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
+vec3 CalcPointLight(PointLight light, bool castsShadow, vec3 normal, vec3 fragPos, vec3 viewDir)
 {
+    lightCost += 1.0;
     vec3 lightDir = normalize(light.position - fragPos);
 
     // diffuse shading
@@ -75,17 +170,19 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     // combine results
     vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, TexCoords));
     vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, TexCoords));
+    vec3 specular = light.specular * spec * SampleSpecular();
     ambient *= attenuation;
     diffuse *= attenuation * diff;
     specular *= attenuation;
-    return (ambient + diffuse + specular) * light.color;
+    float shadow = castsShadow && pointShadows ? CalcPointShadow(light.position, fragPos) : 0.0;
+    return (ambient + (1.0 - shadow) * (diffuse + specular)) * light.color;
 }
 
 // calculates the color when using a direct light with blinn.
 
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
 {
+    lightCost += 1.0;
 
     vec3 lightDir = normalize(-light.direction);
     // diffuse shading
@@ -96,48 +193,73 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     // combine results
     vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, TexCoords));
     vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, TexCoords));
-    return (ambient +diffuse + specular );
+    vec3 specular = light.specular * spec * SampleSpecular();
+    float shadow = dirShadows ? CalcDirShadow(fragPos, normal, lightDir) : 0.0;
+    return (ambient + (1.0 - shadow) * (diffuse + specular));
 }
+#ifdef SPOTLIGHT_ON
 // calculates the color when using a spot light.
 vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
 {
-    if (light.turnOn){
-        vec3 lightDir = normalize(light.position - fragPos);
-        // diffuse shading
-        float diff = max(dot(normal, lightDir), 0.0);
-        // specular shading
-        vec3 reflectDir = reflect(-lightDir, normal);
-        float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-        // attenuation
-        float distance = length(light.position - fragPos);
-        float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
-        // spotlight intensity
-        float theta = dot(lightDir, normalize(-light.direction));
-        float epsilon = light.cutOff - light.outerCutOff;
-        float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
-        // combine results
-
-        vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, TexCoords));
-        vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoords));
-        vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, TexCoords));
-        ambient *= attenuation * intensity;
-        diffuse *= attenuation * intensity;
-        specular *= attenuation * intensity;
-        return (ambient + diffuse + specular) * light.color;
-    }
-    else
-        return vec3(0);
+    lightCost += 1.0;
+    vec3 lightDir = normalize(light.position - fragPos);
+    // diffuse shading
+    float diff = max(dot(normal, lightDir), 0.0);
+    // specular shading
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+    // attenuation
+    float distance = length(light.position - fragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    // spotlight intensity
+    float theta = dot(lightDir, normalize(-light.direction));
+    float epsilon = light.cutOff - light.outerCutOff;
+    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+    // combine results
+
+    vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, TexCoords));
+    vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoords));
+    vec3 specular = light.specular * spec * SampleSpecular();
+    ambient *= attenuation * intensity;
+    diffuse *= attenuation * intensity;
+    specular *= attenuation * intensity;
+    return (ambient + diffuse + specular) * light.color;
 }
+#endif
 void main()
 {
+#ifdef ALPHA_TEST
+    if (texture(material.texture_diffuse1, TexCoords).a < 0.5)
+        discard;
+#endif
+#ifdef HAS_NORMAL_MAP
+    vec3 normal = normalize(TBN * (texture(material.texture_normal1, TexCoords).rgb * 2.0 - 1.0));
+#else
     vec3 normal = normalize(Normal);
+#endif
     vec3 viewDir = normalize(viewPosition - FragPos);
     vec3 result = vec3(0, 0, 0);
     result += CalcDirLight(dirLight, normal, FragPos, viewDir);
-    result += CalcPointLight(pointLight, normal, FragPos, viewDir);
+#if NUM_POINT_LIGHTS > 0
+    // only the first point light has a shadow map
+    for (int i = 0; i < NUM_POINT_LIGHTS; ++i)
+        result += CalcPointLight(pointLights[i], i == 0, normal, FragPos, viewDir);
+#endif
+#ifdef SPOTLIGHT_ON
     result += CalcSpotLight(spotLight, normal, FragPos, viewDir);
+#endif
 
+#if DEBUG_VIEW > 0
+#if DEBUG_VIEW == 1
+    FragColor = vec4(1.0, 0.0, 0.0, 1.0);
+#elif DEBUG_VIEW == 2
+    FragColor = vec4(lightCost, 0.0, 0.0, 1.0);
+#else
+    FragColor = vec4(float(debugId), 0.0, 0.0, 1.0);
+#endif
+    BrightColor = vec4(0.0);
+    return;
+#endif
     FragColor = vec4(result, 1.0);
     float brightness = dot(FragColor.rgb, vec3(0.2126, 0.7152, 0.0722));
         if(brightness > 1.0)
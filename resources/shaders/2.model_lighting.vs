@@ -2,19 +2,40 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+#ifdef HAS_NORMAL_MAP
+layout (location = 3) in vec3 aTangent;
+#endif
 
 out vec2 TexCoords;
 out vec3 Normal;
 out vec3 FragPos;
+out float ViewDepth;
+#ifdef HAS_NORMAL_MAP
+out mat3 TBN;
+#endif
 
-uniform mat4 model;
+// per-draw data, bound from the draw data ring
+layout (std140) uniform PerDraw {
+    mat4 model;
+};
 uniform mat4 view;
 uniform mat4 projection;
 
+// must match the depth pre-pass bit for bit, the lighting pass tests GL_EQUAL against its depth
+invariant gl_Position;
+
 void main()
 {
     FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = aNormal;
+    // models are only scaled uniformly, so the upper 3x3 of the model matrix is enough for normals
+    Normal = mat3(model) * aNormal;
     TexCoords = aTexCoords;    
+    ViewDepth = -(view * vec4(FragPos, 1.0)).z;
+#ifdef HAS_NORMAL_MAP
+    vec3 N = normalize(Normal);
+    vec3 T = normalize(mat3(model) * aTangent);
+    T = normalize(T - dot(T, N) * N);
+    TBN = mat3(T, cross(N, T), N);
+#endif
     gl_Position = projection * view * vec4(FragPos, 1.0);
-}
\ No newline at end of file
+}
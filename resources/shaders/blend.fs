@@ -11,23 +11,20 @@ uniform sampler2D texture2;
 uniform sampler2D texture3;
 uniform sampler2D texture4;
 uniform sampler2D texture5;
-uniform int pair;
-uniform bool side;
 void main()
 {
-
-	if(side)
+	// the card side and pair are compile time features, every card face gets its own specialised program
+#ifdef CARD_BACK
 	FragColor = texture(texture1, TexCoord);
-	else{
-	    if(pair == 1)
-	        FragColor = mix(texture(texture1, TexCoord), texture(texture3, TexCoord), 0.7);
-	    if(pair == 2)
-            FragColor = mix(texture(texture1, TexCoord), texture(texture4, TexCoord), 0.7);
-        if(pair == 3)
-            FragColor = mix(texture(texture1, TexCoord), texture(texture5, TexCoord), 0.7);
-        if(pair == 4)
-       	    FragColor = mix(texture(texture1, TexCoord), texture(texture2, TexCoord), 0.7);
-	}
+#elif CARD_PAIR == 1
+	FragColor = mix(texture(texture1, TexCoord), texture(texture3, TexCoord), 0.7);
+#elif CARD_PAIR == 2
+	FragColor = mix(texture(texture1, TexCoord), texture(texture4, TexCoord), 0.7);
+#elif CARD_PAIR == 3
+	FragColor = mix(texture(texture1, TexCoord), texture(texture5, TexCoord), 0.7);
+#else
+	FragColor = mix(texture(texture1, TexCoord), texture(texture2, TexCoord), 0.7);
+#endif
 	float brightness = dot(FragColor.rgb, vec3(0.2126, 0.7152, 0.0722));
         if(brightness > 1.0)
             BrightColor = vec4(FragColor.rgb, 1.0);
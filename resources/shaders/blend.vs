@@ -4,7 +4,10 @@ layout (location = 1) in vec2 aTexCoord;
 
 out vec2 TexCoord;
 
-uniform mat4 model;
+// per-draw data, bound from the draw data ring
+layout (std140) uniform PerDraw {
+    mat4 model;
+};
 uniform mat4 view;
 uniform mat4 projection;
 
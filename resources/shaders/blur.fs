@@ -4,28 +4,37 @@ out vec4 FragColor;
 in vec2 TexCoords;
 
 uniform sampler2D image;
+// part of the image that holds the scene, it only fills a corner of the target under dynamic resolution
+uniform vec2 uvScale = vec2(1.0);
 
 uniform bool horizontal;
 uniform float weight[5] = float[] (0.2270270270, 0.1945945946, 0.1216216216, 0.0540540541, 0.0162162162);
 
+vec3 sampleImage(vec2 uv, vec2 texel)
+{
+    // clamp to the used corner, the texels outside of it are left over from larger frames
+    return texture(image, clamp(uv, 0.5 * texel, uvScale - 0.5 * texel)).rgb;
+}
+
 void main()
 {             
      vec2 tex_offset = 1.0 / textureSize(image, 0); // gets size of single texel
-     vec3 result = texture(image, TexCoords).rgb * weight[0];
+     vec2 uv = TexCoords * uvScale;
+     vec3 result = sampleImage(uv, tex_offset) * weight[0];
      if(horizontal)
      {
          for(int i = 1; i < 5; ++i)
          {
-            result += texture(image, TexCoords + vec2(tex_offset.x * i, 0.0)).rgb * weight[i];
-            result += texture(image, TexCoords - vec2(tex_offset.x * i, 0.0)).rgb * weight[i];
+            result += sampleImage(uv + vec2(tex_offset.x * i, 0.0), tex_offset) * weight[i];
+            result += sampleImage(uv - vec2(tex_offset.x * i, 0.0), tex_offset) * weight[i];
          }
      }
      else
      {
          for(int i = 1; i < 5; ++i)
          {
-             result += texture(image, TexCoords + vec2(0.0, tex_offset.y * i)).rgb * weight[i];
-             result += texture(image, TexCoords - vec2(0.0, tex_offset.y * i)).rgb * weight[i];
+             result += sampleImage(uv + vec2(0.0, tex_offset.y * i), tex_offset) * weight[i];
+             result += sampleImage(uv - vec2(0.0, tex_offset.y * i), tex_offset) * weight[i];
          }
      }
      FragColor = vec4(result, 1.0);
@@ -0,0 +1,36 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+// red channel of the scene holds what the debug view of the lighting shader wrote
+uniform sampler2D scene;
+// 1 overdraw, 2 light cost: the value is mapped from 0 to range; 3 mesh ids: every id gets its own color
+uniform int mode;
+uniform float range;
+uniform vec2 uvScale = vec2(1.0);
+
+// black, blue, cyan, green, yellow, red, white
+vec3 Heat(float t)
+{
+    const vec3 stops[7] = vec3[](
+        vec3(0.0, 0.0, 0.0), vec3(0.0, 0.0, 1.0), vec3(0.0, 1.0, 1.0), vec3(0.0, 1.0, 0.0),
+        vec3(1.0, 1.0, 0.0), vec3(1.0, 0.0, 0.0), vec3(1.0, 1.0, 1.0)
+    );
+    float x = clamp(t, 0.0, 1.0) * 6.0;
+    int i = min(int(x), 5);
+    return mix(stops[i], stops[i + 1], x - float(i));
+}
+
+void main()
+{
+    // counts and ids must not be filtered, take the nearest texel of the corner the scene was rendered into
+    vec2 size = vec2(textureSize(scene, 0));
+    ivec2 texel = ivec2(min(TexCoords * uvScale * size, uvScale * size - 0.5));
+    float value = texelFetch(scene, texel, 0).r;
+    if (mode == 3)
+        // ids that follow each other land far apart on the map, 0 is left for the background
+        FragColor = vec4(value > 0.0 ? Heat(0.15 + 0.85 * fract(value * 0.618034)) : vec3(0.0), 1.0);
+    else
+        FragColor = vec4(Heat(value / range), 1.0);
+}
@@ -0,0 +1,18 @@
+#version 330 core
+#ifdef ALPHA_TEST
+in vec2 TexCoords;
+
+struct Material {
+    sampler2D texture_diffuse1;
+};
+uniform Material material;
+#endif
+
+void main()
+{
+    // depth is written by the fixed function pipeline, cut out texels must not write any
+#ifdef ALPHA_TEST
+    if (texture(material.texture_diffuse1, TexCoords).a < 0.5)
+        discard;
+#endif
+}
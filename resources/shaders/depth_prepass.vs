@@ -0,0 +1,26 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+#ifdef ALPHA_TEST
+layout (location = 2) in vec2 aTexCoords;
+
+out vec2 TexCoords;
+#endif
+
+// per-draw data, bound from the draw data ring
+layout (std140) uniform PerDraw {
+    mat4 model;
+};
+uniform mat4 view;
+uniform mat4 projection;
+
+// the lighting pass tests GL_EQUAL against this depth, both have to compute the exact same position
+invariant gl_Position;
+
+void main()
+{
+#ifdef ALPHA_TEST
+    TexCoords = aTexCoords;
+#endif
+    vec3 FragPos = vec3(model * vec4(aPos, 1.0));
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
@@ -7,12 +7,16 @@ uniform sampler2D scene;
 uniform sampler2D bloomBlur;
 uniform bool bloom;
 uniform float exposure;
+// the scene was rendered into this corner of its targets, stretching it over the screen upscales it bilinearly
+uniform vec2 uvScale = vec2(1.0);
 
 void main()
 {
     const float gamma = 2.2;
-    vec3 hdrColor = texture(scene, TexCoords).rgb;
-    vec3 bloomColor = texture(bloomBlur, TexCoords).rgb;
+    vec2 halfTexel = 0.5 / vec2(textureSize(scene, 0));
+    vec2 uv = clamp(TexCoords * uvScale, halfTexel, uvScale - halfTexel);
+    vec3 hdrColor = texture(scene, uv).rgb;
+    vec3 bloomColor = texture(bloomBlur, uv).rgb;
     if(bloom)
         hdrColor += bloomColor; // additive blending
     // tone mapping
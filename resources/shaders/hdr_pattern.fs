@@ -0,0 +1,23 @@
+#version 330 core
+layout (location = 0) out vec4 FragColor;
+layout (location = 1) out vec4 BrightColor;
+
+in vec2 TexCoords;
+
+// synthetic HDR image for the target format benchmark: smooth gradients over several orders of magnitude,
+// fine detail that shows banding and a few bright spots that feed the bloom
+void main()
+{
+    vec2 uv = TexCoords;
+    vec3 color = vec3(uv.x, uv.y, 1.0 - uv.x) * exp2(uv.y * 10.0 - 6.0);
+    color *= 0.75 + 0.25 * sin(uv.x * 120.0) * sin(uv.y * 80.0);
+    for (int i = 0; i < 4; i++)
+    {
+        vec2 d = uv - vec2(0.2 + 0.2 * i, 0.3 + 0.1 * i);
+        color += vec3(24.0, 18.0, 10.0) * exp(-dot(d, d) * 4000.0);
+    }
+    FragColor = vec4(color, 1.0);
+    // same threshold as the scene shaders
+    float brightness = dot(color, vec3(0.2126, 0.7152, 0.0722));
+    BrightColor = brightness > 1.0 ? vec4(color, 1.0) : vec4(0.0, 0.0, 0.0, 1.0);
+}
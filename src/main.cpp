@@ -1,3 +1,5 @@
+// replaces the global operator new/delete, has to come before anything includes rg/AllocationTracker.h
+#define ALLOCATION_TRACKER_IMPLEMENTATION
 #include "imgui.h"
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_opengl3.h"
@@ -13,8 +15,33 @@
 #include <learnopengl/shader.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
-
+#include <rg/PointShadowMap.h>
+#include <rg/CascadedShadowMap.h>
+#include <rg/Profiler.h>
+#include <rg/HeadlessContext.h>
+#include <rg/Benchmark.h>
+#include <rg/InputRecorder.h>
+#include <rg/Log.h>
+#include <rg/GLDebug.h>
+#include <rg/GLStats.h>
+#include <rg/GLStateCache.h>
+#include <rg/MemoryTracker.h>
+#include <rg/StartupTracer.h>
+#include <rg/FrameAllocator.h>
+#include <rg/AllocationTracker.h>
+#include <rg/JobSystem.h>
+#include <rg/RenderThread.h>
+#include <rg/CommandBuffer.h>
+#include <rg/DrawDataRing.h>
+#include <rg/TextureStreamer.h>
+#include <rg/DynamicResolution.h>
+#include <rg/RenderTargetPool.h>
+#include <rg/FragmentCounter.h>
+
+#include <chrono>
 #include <iostream>
+#include <mutex>
+#include <thread>
 #define RAND_MAX 7
 void framebuffer_size_callback(GLFWwindow *window, int width, int height);
 
@@ -28,7 +55,14 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod
 
 unsigned int loadCubemap(vector<std::string> faces);
 
-unsigned int loadTexture(char const * path);
+// image decoded by stb_image, GL doesn't know about it yet
+struct DecodedImage {
+    std::string path;
+    unsigned char* data = nullptr;
+    int width = 0, height = 0, components = 0;
+};
+DecodedImage decodeImage(const std::string& path);
+unsigned int uploadTexture(DecodedImage& image);
 void renderQuad();
 void renderCube();
 // settings
@@ -36,7 +70,17 @@ const unsigned int SCR_WIDTH = 1280;
 const unsigned int SCR_HEIGHT = 720;
 bool bloom = true;
 bool bloomKeyPressed = false;
+// formats the HDR scene and bloom targets can be switched between, cheapest last
+const GLenum hdrFormats[] = {GL_RGBA16F, GL_RGB16F, GL_R11F_G11F_B10F};
+// heatmaps of the model pass shown instead of the tonemapped scene, the value is the DEBUG_VIEW of the lighting shader
+enum DebugView { DEBUG_VIEW_OFF, DEBUG_VIEW_OVERDRAW, DEBUG_VIEW_LIGHT_COST, DEBUG_VIEW_MESH_ID };
+const char* debugViewNames[] = {"Off", "Overdraw", "Light cost", "Mesh id"};
+// value shown as the hottest color: fragments per pixel, lights plus shadow filters per fragment
+const float debugViewRanges[] = {1.0f, 8.0f, 6.0f, 1.0f};
 float exposure = 1.0f;
+// size of the window's framebuffer, updated on the main thread and passed to the render thread with every frame
+int framebufferWidth = SCR_WIDTH;
+int framebufferHeight = SCR_HEIGHT;
 // camera
 
 float lastX = SCR_WIDTH / 2.0f;
@@ -47,6 +91,10 @@ bool firstMouse = true;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
+// benchmark, recording and replay advance the simulation with a fixed step so every run sees the same frames
+const float FIXED_TIMESTEP = 1.0f / 60.0f;
+const unsigned int BENCHMARK_WARMUP_FRAMES = 60;
+
 struct PointLight {
     glm::vec3 position;
     glm::vec3 ambient;
@@ -65,7 +113,7 @@ struct DirLight {
 
 };
 struct SpotLight {
-    bool turnOn;
+    bool turnOn = false;
 };
 struct ProgramState {
     glm::vec3 clearColor = glm::vec3(0);
@@ -77,6 +125,20 @@ struct ProgramState {
     PointLight pointLight;
     DirLight dirLight;
     SpotLight spotLight;
+    bool pointShadows = true;
+    bool dirShadows = true;
+    int cascadeCount = 3;
+    int cascadeResolution = 2048;
+    int textureBudgetMB = 256;
+    rg::DynamicResolution::Settings dynamicResolution;
+    // formats of the HDR scene color and of the bright colors with their bloom chain, what --hdr-formats recommends
+    GLenum sceneFormat = GL_RGBA16F;
+    GLenum bloomFormat = GL_RGBA16F;
+    // lay down the models' depth first so the lighting shader runs once per visible pixel
+    bool depthPrepass = true;
+    int debugView = DEBUG_VIEW_OFF;
+    // skip GL calls that wouldn't change the state, off still counts them
+    bool stateCache = true;
 
     ProgramState()
             : camera(glm::vec3(0.0f, 0.0f, 3.0f)) {}
@@ -133,64 +195,292 @@ struct GameState {
 };
 GameState gameState;
 
+// fingerprint of the game state, compared between a recording and its replay
+uint32_t hashGameState() {
+    uint32_t hash = rg::InputRecorder::Hash(&gameState.card, sizeof(gameState.card));
+    for (int value : {gameState.number, gameState.pickedCount, gameState.last, gameState.now,
+                      (int) gameState.cleared, (int) gameState.move, (int) gameState.reset})
+        hash = rg::InputRecorder::Hash(&value, sizeof(value), hash);
+    hash = rg::InputRecorder::Hash(&gameState.timer, sizeof(gameState.timer), hash);
+    for (unsigned int i = 0; i < gameState.used.size(); i++) {
+        bool used = gameState.used[i];
+        hash = rg::InputRecorder::Hash(&used, sizeof(used), hash);
+        hash = rg::InputRecorder::Hash(&gameState.rot[i], sizeof(float), hash);
+    }
+    return hash;
+}
+
+// records the input of a session (--record) or plays one back (--replay)
+rg::InputRecorder inputRecorder;
+
+// --------------------------------------------------
+// SCENE
+struct SceneObject {
+    Model* model;
+    glm::mat4 transform;
+    bool dynamic;       // moves every frame, re-rendered into the dynamic shadow map
+    bool castsPointShadow;
+    glm::mat4 shadowTransform; // transform the cached static shadow map was rendered with
+};
+
+struct RenderStats {
+    unsigned int pointShadowStaticRebuilds = 0;
+    unsigned int pointShadowDynamicDraws = 0;
+    bool pointShadowStaticUpdated = false;
+    float shaderSetupMs = 0.0f;
+    unsigned int lightingVariants = 0;
+    unsigned int cardVariants = 0;
+    int cascadeCount = 0;
+    rg::CascadedShadowMap::CascadeStats cascades[rg::CascadedShadowMap::MAX_CASCADES];
+    float simulationMs = 0.0f;
+    float renderMs = 0.0f;
+    bool drawDataPersistent = false;
+    size_t drawDataHighWater = 0;
+    unsigned long long drawDataStalls = 0;
+    float renderScale = 1.0f;
+    float gpuFrameMs = 0.0f;
+    int sceneWidth = 0, sceneHeight = 0;
+    size_t renderTargetCount = 0;
+    GLenum sceneFormat = 0, bloomFormat = 0;
+    size_t renderTargetBytes = 0, renderTargetPeak = 0;
+    unsigned long long renderTargetAllocations = 0, renderTargetFrees = 0;
+    bool depthPrepass = false;
+    // fragments that passed the depth test in the pre-pass and in the lighting pass of the models
+    unsigned long long prepassFragments = 0, lightingFragments = 0;
+    // GPU time of the pre-pass and of the lighting pass, the latter measured separately with and without pre-pass
+    float prepassMs = 0.0f, lightingMs[2] = {0.0f, 0.0f};
+    bool stateCache = false;
+    rg::GLStateCache::Counters stateCalls = {};
+    // the render thread's frame allocator
+    size_t frameAllocatorUsed = 0, frameAllocatorHighWater = 0, frameAllocatorCapacity = 0;
+    unsigned int programCacheHits = 0, programCacheMisses = 0;
+};
+// written by the render thread during a frame, then published to shownRenderStats for the UI on the main thread
+RenderStats renderStats;
+RenderStats shownRenderStats;
+std::mutex renderStatsMutex;
+
+// everything the render thread needs to know about one simulated frame, it doesn't read the program or game state
+struct FramePacket {
+    unsigned int frame = 0;
+    float simulationMs = 0.0f;
+    int framebufferWidth = 0, framebufferHeight = 0;
+    glm::mat4 view, projection;
+    glm::vec3 cameraPosition;
+    float cameraZoom = 0.0f;
+    float aspect = 1.0f;
+    glm::vec3 clearColor;
+    PointLight pointLight;
+    DirLight dirLight;
+    bool spotLightOn = false;
+    bool pointShadows = true, dirShadows = true;
+    int cascadeCount = 0, cascadeResolution = 0;
+    int textureBudgetMB = 0;
+    rg::DynamicResolution::Settings dynamicResolution;
+    GLenum sceneFormat = GL_RGBA16F, bloomFormat = GL_RGBA16F;
+    bool depthPrepass = true;
+    int debugView = DEBUG_VIEW_OFF;
+    bool stateCache = true;
+    bool bloom = true;
+    float exposure = 1.0f;
+    glm::mat4 cardModels[8];
+    bool cardFaceUp[8] = {};
+    bool cardUsed[8] = {};
+    glm::mat4 chairTransform;
+    rg::ImGuiFrame imgui;
+};
 
 // --------------------------------------------------
 ProgramState *programState;
 
-void DrawImGui(ProgramState *programState);
+void BuildImGui(ProgramState *programState);
+
+int main(int argc, char **argv) {
+    // command line: --benchmark [--path <camera path>] [--frames <count>] [--output <json file>]
+    //               --record <file> | --replay <file>
+    //               --startup-budget <ms> | --startup-budget <phase>=<ms>
+    //               --no-alloc (abort on the first heap allocation of the render loop after warm-up)
+    //               --job-scaling <json file> (job system scaling benchmark, exits afterwards)
+    //               --command-buffers <json file> (direct vs recorded draw submission, exits afterwards)
+    //               --no-buffer-storage (per-draw data through glBufferSubData even if GL_ARB_buffer_storage is there)
+    //               --hdr-format <RGBA16F|RGB16F|R11F_G11F_B10F> (format of the HDR scene and bloom targets)
+    //               --hdr-formats <json file> (HDR target format benchmark, exits afterwards)
+    //               --no-depth-prepass (shade the models without laying down their depth first)
+    //               --no-state-cache (every state call reaches the driver, redundant ones are still counted)
+    // ------------------------------------------------------------------------------------------
+    rg::AllocationTracker::NameThread("Main");
+    rg::StartupTracer& startup = rg::StartupTracer::Instance();
+    startup.Phase("Arguments");
+    bool benchmarkMode = false;
+    std::string benchmarkPath = "resources/benchmark/orbit.path";
+    std::string benchmarkOutput = "benchmark.json";
+    unsigned int benchmarkFrames = 600;
+    std::string recordPath;
+    std::string replayPath;
+    std::string jobScalingOutput;
+    std::string commandBufferOutput;
+    bool bufferStorage = true;
+    GLenum hdrFormat = 0;
+    std::string hdrFormatsOutput;
+    bool depthPrepass = true;
+    bool stateCacheEnabled = true;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--benchmark")
+            benchmarkMode = true;
+        else if (arg == "--path" && i + 1 < argc)
+            benchmarkPath = argv[++i];
+        else if (arg == "--frames" && i + 1 < argc)
+            benchmarkFrames = std::max(2, atoi(argv[++i]));
+        else if (arg == "--output" && i + 1 < argc)
+            benchmarkOutput = argv[++i];
+        else if (arg == "--record" && i + 1 < argc)
+            recordPath = argv[++i];
+        else if (arg == "--replay" && i + 1 < argc)
+            replayPath = argv[++i];
+        else if (arg == "--startup-budget" && i + 1 < argc)
+            startup.ParseBudget(argv[++i]);
+        else if (arg == "--no-alloc")
+            rg::AllocationTracker::Instance().SetStrict(true);
+        else if (arg == "--job-scaling" && i + 1 < argc)
+            jobScalingOutput = argv[++i];
+        else if (arg == "--command-buffers" && i + 1 < argc)
+            commandBufferOutput = argv[++i];
+        else if (arg == "--no-buffer-storage")
+            bufferStorage = false;
+        else if (arg == "--hdr-format" && i + 1 < argc) {
+            std::string name = argv[++i];
+            for (GLenum format : hdrFormats) {
+                if (name == rg::RenderTargetPool::FormatName(format))
+                    hdrFormat = format;
+            }
+            if (!hdrFormat)
+                LOG_WARNING(General, "Unknown HDR format: %s", name.c_str());
+        }
+        else if (arg == "--hdr-formats" && i + 1 < argc)
+            hdrFormatsOutput = argv[++i];
+        else if (arg == "--no-depth-prepass")
+            depthPrepass = false;
+        else if (arg == "--no-state-cache")
+            stateCacheEnabled = false;
+        else
+            LOG_WARNING(General, "Unknown argument: %s", arg.c_str());
+    }
+    if (!recordPath.empty() && !replayPath.empty()) {
+        LOG_ERROR(General, "--record and --replay can't be used together");
+        return -1;
+    }
+    // these runs have to be reproducible: fixed time step, default state and nothing saved on exit
+    const bool deterministic = benchmarkMode || !recordPath.empty() || !replayPath.empty();
+    if (!jobScalingOutput.empty()) {
+        int result = rg::Benchmark::RunJobScaling(jobScalingOutput) ? 0 : -1;
+        rg::Logger::Instance().Shutdown();
+        return result;
+    }
+    rg::JobSystem& jobs = rg::JobSystem::Instance();
+    jobs.Start();
+    if (!commandBufferOutput.empty()) {
+        // only needs a context, no window
+        rg::HeadlessContext context;
+        int result = context.Create() && rg::Benchmark::RunCommandBuffers(commandBufferOutput) ? 0 : -1;
+        jobs.Shutdown();
+        rg::Logger::Instance().Shutdown();
+        return result;
+    }
+    if (!hdrFormatsOutput.empty()) {
+        rg::HeadlessContext context;
+        int result = context.Create() && rg::Benchmark::RunHdrFormats(hdrFormatsOutput) ? 0 : -1;
+        jobs.Shutdown();
+        rg::Logger::Instance().Shutdown();
+        return result;
+    }
 
-int main() {
-    // glfw: initialize and configure
-    // ------------------------------
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    startup.Phase("Context");
+    GLFWwindow *window = NULL;
+    rg::HeadlessContext headless;
+    if (benchmarkMode) {
+        // offscreen context, no window and no input
+        if (!headless.Create()) {
+            LOG_ERROR(GL, "Failed to create a headless OpenGL context");
+            return -1;
+        }
+    } else {
+        // glfw: initialize and configure
+        // ------------------------------
+        glfwInit();
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#ifndef NDEBUG
+        glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
+#endif
 
 #ifdef __APPLE__
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
 
-    // glfw window creation
-    // --------------------
-    GLFWwindow *window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
-    if (window == NULL) {
-        std::cout << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
-        return -1;
-    }
-    glfwMakeContextCurrent(window);
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-    glfwSetCursorPosCallback(window, mouse_callback);
-    glfwSetScrollCallback(window, scroll_callback);
-    glfwSetKeyCallback(window, key_callback);
-    // tell GLFW to capture our mouse
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-
-    // glad: load all OpenGL function pointers
-    // ---------------------------------------
-    if (!gladLoadGLLoader((GLADloadproc) glfwGetProcAddress)) {
-        std::cout << "Failed to initialize GLAD" << std::endl;
-        return -1;
+        // glfw window creation
+        // --------------------
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
+        if (window == NULL) {
+            LOG_ERROR(GL, "Failed to create GLFW window");
+            glfwTerminate();
+            return -1;
+        }
+        glfwMakeContextCurrent(window);
+        glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+        glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+        glfwSetCursorPosCallback(window, mouse_callback);
+        glfwSetScrollCallback(window, scroll_callback);
+        glfwSetKeyCallback(window, key_callback);
+        // tell GLFW to capture our mouse
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+
+        // glad: load all OpenGL function pointers
+        // ---------------------------------------
+        if (!gladLoadGLLoader((GLADloadproc) glfwGetProcAddress)) {
+            LOG_ERROR(GL, "Failed to initialize GLAD");
+            return -1;
+        }
     }
 
+    // wraps the glad pointers in an instrumentation build, before anything else calls into GL
+    rg::GLStats::Instance().Install();
+    // then the state cache on top, GLStats only sees the calls that change something
+    rg::GLStateCache::Instance().Install();
+    rg::GLStateCache::Instance().SetEnabled(stateCacheEnabled);
+    // driver messages go to the log, objects and passes get names for captures
+    rg::GLDebug::Init();
+
     // tell stb_image.h to flip loaded texture's on the y-axis (before loading model).
     //stbi_set_flip_vertically_on_load(true);
 
+    startup.Phase("Program state");
     programState = new ProgramState;
-    programState->LoadFromFile("resources/program_state.txt");
-    if (programState->ImGuiEnabled) {
-        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
+    if (!deterministic)
+        programState->LoadFromFile("resources/program_state.txt");
+    if (hdrFormat)
+        programState->sceneFormat = programState->bloomFormat = hdrFormat;
+    programState->depthPrepass = depthPrepass;
+    programState->stateCache = stateCacheEnabled;
+    startup.Phase("ImGui");
+    if (!benchmarkMode) {
+        if (programState->ImGuiEnabled) {
+            glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
+        }
+        // Init Imgui
+        IMGUI_CHECKVERSION();
+        ImGui::CreateContext();
+        ImGuiIO &io = ImGui::GetIO();
+        (void) io;
+
+
+        ImGui_ImplGlfw_InitForOpenGL(window, true);
+        ImGui_ImplOpenGL3_Init("#version 330 core");
+        // creates the font texture while the context is still current here, the UI itself is built on this
+        // thread every frame but only drawn on the render thread
+        ImGui_ImplOpenGL3_NewFrame();
     }
-    // Init Imgui
-    IMGUI_CHECKVERSION();
-    ImGui::CreateContext();
-    ImGuiIO &io = ImGui::GetIO();
-    (void) io;
-
-
-    ImGui_ImplGlfw_InitForOpenGL(window, true);
-    ImGui_ImplOpenGL3_Init("#version 330 core");
 
     // configure global opengl state
     // -----------------------------
@@ -198,8 +488,20 @@ int main() {
     glEnable(GL_CULL_FACE);
     glCullFace(GL_BACK);
 
+    // glfw: terminate, clearing all previously allocated GLFW resources. Declared before every GL object below, so
+    // it runs after their destructors (shaders, shadow maps, render targets, timers) while the context still exists.
+    // ----------------------------------------------------------------------------------------------------------
+    struct GlfwTerminator {
+        GLFWwindow* window;
+        ~GlfwTerminator() {
+            if (window)
+                glfwTerminate();
+        }
+    } glfwTerminator = {window};
+
     // build and compile shaders
     // -------------------------
+    startup.Phase("Shader sources");
     Shader ourShader("resources/shaders/2.model_lighting.vs", "resources/shaders/2.model_lighting.fs");
     Shader blendShader("resources/shaders/blend.vs", "resources/shaders/blend.fs");
     Shader blendingShader("resources/shaders/blending.vs", "resources/shaders/blending.fs");
@@ -208,10 +510,40 @@ int main() {
     Shader shaderLight("resources/shaders/bloom.vs", "resources/shaders/light_box.fs");
     Shader shaderBlur("resources/shaders/blur.vs", "resources/shaders/blur.fs");
     Shader hdrShader("resources/shaders/hdr.vs", "resources/shaders/hdr.fs");
+    Shader debugViewShader("resources/shaders/hdr.vs", "resources/shaders/debug_view.fs");
+    Shader shadowDepthShader("resources/shaders/shadow_depth.vs", "resources/shaders/shadow_depth.fs");
+    Shader depthPrepassShader("resources/shaders/depth_prepass.vs", "resources/shaders/depth_prepass.fs");
+    Shader pointShadowShader("resources/shaders/point_shadow_depth.vs", "resources/shaders/point_shadow_depth.fs",
+                             "resources/shaders/point_shadow_depth.gs");
+
+    // submit every program up front, the driver compiles them in parallel while the models are loading
+    startup.Phase("Shader submit");
+    int shaderCompilation = startup.BeginAsync("Shader compilation");
+    ShaderBatch shaderBatch;
+    for (unsigned int spotLightOn = 0; spotLightOn < 2; spotLightOn++) {
+        for (unsigned int specularMap = 0; specularMap < 2; specularMap++) {
+            for (unsigned int normalMap = 0; normalMap < 2; normalMap++) {
+                unsigned int key = Shader::WithFeature(0, ShaderFeatures::NUM_POINT_LIGHTS, 1);
+                key = Shader::WithFeature(key, ShaderFeatures::SPOTLIGHT_ON, spotLightOn);
+                key = Shader::WithFeature(key, ShaderFeatures::HAS_SPECULAR_MAP, specularMap);
+                key = Shader::WithFeature(key, ShaderFeatures::HAS_NORMAL_MAP, normalMap);
+                shaderBatch.Add(ourShader, key);
+            }
+        }
+    }
+    shaderBatch.Add(blendShader, Shader::WithFeature(0, ShaderFeatures::CARD_BACK, 1));
+    for (unsigned int pair = 1; pair <= 4; pair++)
+        shaderBatch.Add(blendShader, Shader::WithFeature(0, ShaderFeatures::CARD_PAIR, pair));
+    shaderBatch.Add(depthPrepassShader);
+    shaderBatch.Add(depthPrepassShader, Shader::WithFeature(0, ShaderFeatures::ALPHA_TEST, 1));
+    for (Shader* other : {&blendingShader, &skyboxShader, &shader, &shaderLight, &shaderBlur, &hdrShader,
+                          &shadowDepthShader, &pointShadowShader})
+        shaderBatch.Add(*other);
 
 
     // load models
     // -----------
+    startup.Phase("Models");
     Model Dog("resources/objects/Dog/scene.gltf");
     Dog.SetShaderTextureNamePrefix("material.");
     Model Tree("resources/objects/Tree/scene.gltf");
@@ -227,7 +559,57 @@ int main() {
     Model DeskLamp("resources/objects/DeskLamp/scene.gltf");
     DeskLamp.SetShaderTextureNamePrefix("material.");
 
+    // place models in the scene
+    // -------------------------
+    std::vector<SceneObject> sceneObjects;
+    glm::mat4 model = glm::mat4(1.0f);
+
+    //Dog
+    model = glm::mat4(1.0f);
+    model = glm::translate(model,glm::vec3(9.0,0.0,0.0));
+    model = glm::rotate(model, (float)glm::radians(-45.f),glm::vec3(0.0,1,0.0));
+    model = glm::scale(model, glm::vec3(0.5f,0.5f,0.5f));
+    sceneObjects.push_back({&Dog, model, false, true, model});
+
+    //Tree
+    model = glm::mat4(1.0f);
+    model = glm::translate(model,glm::vec3(0.0,0.0,0.0));
+    model = glm::rotate(model, (float)glm::radians(-90.f),glm::vec3(1.0,0,0.0));
+    model = glm::scale(model, glm::vec3(0.25f,0.25f,0.25f));
+    sceneObjects.push_back({&Tree, model, false, true, model});
+
+    //Table
+    model = glm::mat4(1.0f);
+    model = glm::translate(model,glm::vec3(3.0,0.0,7.0));
+    model = glm::scale(model, glm::vec3(2.5f,2.5f,2.5f));
+    sceneObjects.push_back({&Table, model, false, true, model});
+
+    //Chair (rocks, transform is updated every frame)
+    const size_t chairIndex = sceneObjects.size();
+    sceneObjects.push_back({&Chair, glm::mat4(1.0f), true, true, glm::mat4(1.0f)});
+
+    //Lamp (holds the point light, so it doesn't cast that light's shadows)
+    model = glm::mat4(1.0f);
+    model = glm::translate(model,glm::vec3(0.0,-1,17.0));
+    model = glm::rotate(model, (float)glm::radians(80.f),glm::vec3(0.0,1,0.0));
+    model = glm::scale(model, glm::vec3(1.35f,1.35f,1.35f));
+    sceneObjects.push_back({&Lamp, model, false, false, model});
+
+    //Desk Lamp
+    model = glm::mat4(1.0f);
+    model = glm::translate(model,glm::vec3(4.6,3.54,7.f));
+    model = glm::rotate(model, (float)glm::radians(-90.f),glm::vec3(1.0,0.0,0.0));
+    model = glm::rotate(model, (float)glm::radians(180.f),glm::vec3(0.0,0.0,1.0));
+    model = glm::scale(model, glm::vec3(0.081f,0.081f,0.081f));
+    sceneObjects.push_back({&DeskLamp, model, false, true, model});
+
+    //Moon (far away and self lit, drawn separately)
+    glm::mat4 moonModel = glm::mat4(1.0f);
+    moonModel = glm::translate(moonModel,glm::vec3(10.0,20.0,-40.0));
+    moonModel = glm::scale(moonModel, glm::vec3(0.4f,0.4f,0.4f));
+
     // skybox
+    startup.Phase("Skybox");
     float skyboxVertices[] = {
             // positions
             -1.0f,  1.0f, -1.0f,
@@ -346,8 +728,10 @@ int main() {
     glGenVertexArrays(1, &skyboxVAO);
     glGenBuffers(1, &skyboxVBO);
     glBindVertexArray(skyboxVAO);
+    rg::GLDebug::Label(GL_VERTEX_ARRAY, skyboxVAO, "Skybox VAO");
     glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
+    rg::MemoryTracker::Instance().Track(rg::MemoryTracker::Kind::Buffer, skyboxVBO, "Skybox VBO", sizeof(skyboxVertices), "Skybox");
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
     stbi_set_flip_vertically_on_load(false);
@@ -368,9 +752,11 @@ int main() {
     glGenBuffers(1, &VBO);
 
     glBindVertexArray(VAO);
+    rg::GLDebug::Label(GL_VERTEX_ARRAY, VAO, "Cards VAO");
 
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    rg::MemoryTracker::Instance().Track(rg::MemoryTracker::Kind::Buffer, VBO, "Cards VBO", sizeof(vertices), "Cards");
 
     // position attribute
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
@@ -398,9 +784,11 @@ int main() {
     glGenBuffers(1, &VBO1);
 
     glBindVertexArray(VAO1);
+    rg::GLDebug::Label(GL_VERTEX_ARRAY, VAO1, "Victory VAO");
 
     glBindBuffer(GL_ARRAY_BUFFER, VBO1);
     glBufferData(GL_ARRAY_BUFFER, sizeof(victoryvertices), victoryvertices, GL_STATIC_DRAW);
+    rg::MemoryTracker::Instance().Track(rg::MemoryTracker::Kind::Buffer, VBO1, "Victory VBO", sizeof(victoryvertices), "Cards");
 
     // position attribute
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
@@ -412,84 +800,81 @@ int main() {
     glBindVertexArray(0);
 
     //HDR
-    // configure (floating point) framebuffers
+    // the floating point framebuffers of the scene and the bloom blur come from the render target pool, at the
+    // window's size, and are only allocated when the first frame acquires them
     // ---------------------------------------
-    unsigned int hdrFBO;
-    glGenFramebuffers(1, &hdrFBO);
-    glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
-    // create 2 floating point color buffers (1 for normal rendering, other for brightness threshold values)
-    unsigned int colorBuffers[2];
-    glGenTextures(2, colorBuffers);
-    for (unsigned int i = 0; i < 2; i++)
-    {
-        glBindTexture(GL_TEXTURE_2D, colorBuffers[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);  // we clamp to the edge as the blur filter would otherwise sample repeated texture values!
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        // attach texture to framebuffer
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, colorBuffers[i], 0);
-    }
-    // create and attach depth buffer (renderbuffer)
-    unsigned int rboDepth;
-    glGenRenderbuffers(1, &rboDepth);
-    glBindRenderbuffer(GL_RENDERBUFFER, rboDepth);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, SCR_WIDTH, SCR_HEIGHT);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rboDepth);
-    // tell OpenGL which color attachments we'll use (of this framebuffer) for rendering
-    unsigned int attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
-    glDrawBuffers(2, attachments);
-    // finally check if framebuffer is complete
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-        std::cout << "Framebuffer not complete!" << std::endl;
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-    // ping-pong-framebuffer for blurring
-    unsigned int pingpongFBO[2];
-    unsigned int pingpongColorbuffers[2];
-    glGenFramebuffers(2, pingpongFBO);
-    glGenTextures(2, pingpongColorbuffers);
-    for (unsigned int i = 0; i < 2; i++)
-    {
-        glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[i]);
-        glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE); // we clamp to the edge as the blur filter would otherwise sample repeated texture values!
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pingpongColorbuffers[i], 0);
-        // also check if framebuffers are complete (no need for depth buffer)
+    startup.Phase("Framebuffers");
+    rg::RenderTargetPool renderTargets;
+
+    // the final image goes to the window, a headless context has no default framebuffer to present
+    unsigned int outputFBO = 0;
+    unsigned int outputRenderbuffers[2] = {0, 0};
+    if (benchmarkMode) {
+        glGenFramebuffers(1, &outputFBO);
+        glGenRenderbuffers(2, outputRenderbuffers);
+        glBindFramebuffer(GL_FRAMEBUFFER, outputFBO);
+        rg::GLDebug::Label(GL_FRAMEBUFFER, outputFBO, "Benchmark output FBO");
+        glBindRenderbuffer(GL_RENDERBUFFER, outputRenderbuffers[0]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, SCR_WIDTH, SCR_HEIGHT);
+        rg::MemoryTracker::Instance().Track(rg::MemoryTracker::Kind::Renderbuffer, outputRenderbuffers[0], "Output color",
+                                            rg::MemoryTracker::TextureBytes(GL_RGBA8, SCR_WIDTH, SCR_HEIGHT), "Benchmark output FBO");
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, outputRenderbuffers[0]);
+        glBindRenderbuffer(GL_RENDERBUFFER, outputRenderbuffers[1]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, SCR_WIDTH, SCR_HEIGHT);
+        rg::MemoryTracker::Instance().Track(rg::MemoryTracker::Kind::Renderbuffer, outputRenderbuffers[1], "Output depth",
+                                            rg::MemoryTracker::TextureBytes(GL_DEPTH_COMPONENT24, SCR_WIDTH, SCR_HEIGHT), "Benchmark output FBO");
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, outputRenderbuffers[1]);
         if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-            std::cout << "Framebuffer not complete!" << std::endl;
+            LOG_ERROR(Render, "Framebuffer not complete!");
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        // there is no window that would set the viewport
+        glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
     }
 
     // load textures
     // -------------
-    unsigned int texture1 = loadTexture(FileSystem::getPath("resources/textures/card.jpg").c_str());
-    unsigned int texture2 = loadTexture(FileSystem::getPath("resources/textures/python.png").c_str());
-    unsigned int texture3 = loadTexture(FileSystem::getPath("resources/textures/c++.png").c_str());
-    // load and create a texture
-    // -------------------------
-    unsigned int texture4 = loadTexture(FileSystem::getPath("resources/textures/haskell.png").c_str());;
-    unsigned int texture5 = loadTexture(FileSystem::getPath("resources/textures/java.png").c_str());;
-    unsigned int texture6 = loadTexture(FileSystem::getPath("resources/textures/victory.png").c_str());;
+    startup.Phase("Card textures");
+    // decoded on the workers, each one is uploaded on the GL thread as soon as it is ready
+    // -----------------------------------------------------------------------------------
+    std::string cardTexturePaths[6] = {
+            FileSystem::getPath("resources/textures/card.jpg"),
+            FileSystem::getPath("resources/textures/python.png"),
+            FileSystem::getPath("resources/textures/c++.png"),
+            FileSystem::getPath("resources/textures/haskell.png"),
+            FileSystem::getPath("resources/textures/java.png"),
+            FileSystem::getPath("resources/textures/victory.png")
+    };
+    unsigned int cardTextures[6] = {};
+    {
+        DecodedImage cardImages[6];
+        rg::JobCounter cardTexturesLoaded;
+        for (int i = 0; i < 6; i++) {
+            jobs.Run([&, i]() {
+                cardImages[i] = decodeImage(cardTexturePaths[i]);
+                jobs.RunOnGLThread([&, i]() { cardTextures[i] = uploadTexture(cardImages[i]); }, &cardTexturesLoaded);
+            }, &cardTexturesLoaded);
+        }
+        jobs.Wait(cardTexturesLoaded);
+    }
+    unsigned int texture1 = cardTextures[0];
+    unsigned int texture2 = cardTextures[1];
+    unsigned int texture3 = cardTextures[2];
+    unsigned int texture4 = cardTextures[3];
+    unsigned int texture5 = cardTextures[4];
+    unsigned int texture6 = cardTextures[5];
 
 
 
     // tell opengl for each sampler to which texture unit it belongs to (only has to be done once)
+    // the values are kept by the shaders, no need to bind the programs which may still be compiling
     // -------------------------------------------------------------------------------------------
-    blendShader.use();
     blendShader.setInt("texture1", 0);
     blendShader.setInt("texture2", 1);
     blendShader.setInt("texture3", 2);
     blendShader.setInt("texture4", 3);
     blendShader.setInt("texture5", 4);
-    blendingShader.use();
     blendingShader.setInt("texture6", 5);
 
-    skyboxShader.use();
     skyboxShader.setInt("skybox", 0);
     //initialize point light
     SpotLight& spotLight = programState->spotLight;
@@ -526,13 +911,39 @@ int main() {
 
     // shader configuration
     // --------------------
-    ourShader.use();
     ourShader.setInt("diffuseTexture", 0);
-    shaderBlur.use();
+    ourShader.SetFeature(ShaderFeatures::NUM_POINT_LIGHTS, 1);
     shaderBlur.setInt("image", 0);
-    hdrShader.use();
     hdrShader.setInt("scene", 0);
     hdrShader.setInt("bloomBlur", 1);
+    debugViewShader.setInt("scene", 0);
+
+    // point light shadows, static casters are cached and only re-rendered when something moves
+    startup.Phase("Shadow maps");
+    rg::PointShadowMap pointShadow(1024, 0.1f, 40.0f);
+    const unsigned int pointShadowStaticUnit = 8;
+    const unsigned int pointShadowDynamicUnit = 9;
+    ourShader.setInt("pointShadowStatic", pointShadowStaticUnit);
+    ourShader.setInt("pointShadowDynamic", pointShadowDynamicUnit);
+    ourShader.setFloat("pointShadowFar", pointShadow.FarPlane());
+
+    // cascaded shadows of the moon light, distant cascades are cached and refreshed less often
+    rg::CascadedShadowMap cascadedShadow(programState->cascadeCount, programState->cascadeResolution, 40.0f);
+    const unsigned int cascadeShadowUnit = 10;
+    ourShader.setInt("cascadeShadowMap", cascadeShadowUnit);
+    // object space bounds of a card, used to cull cards per cascade
+    rg::Aabb cardBounds;
+    cardBounds.Expand(glm::vec3(-0.05f, -0.5f, -0.25f));
+    cardBounds.Expand(glm::vec3(0.05f, 0.5f, 0.25f));
+    // per-draw matrices of the model and card passes, written once per frame and bound by range.
+    // This, the counters and the timers below are destroyed at the end of main, before glfwTerminator
+    rg::DrawDataRing drawDataRing(256 * 1024, bufferStorage);
+    rg::DynamicResolution dynamicResolution;
+    // what the depth pre-pass costs and saves, the lighting pass is measured per mode so toggling can be compared
+    rg::FragmentCounter prepassFragments, lightingFragments;
+    rg::GpuTimer prepassTimer, lightingTimers[2];
+    LOG_INFO(Render, "Per-draw data %s", drawDataRing.Persistent() ? "persistently mapped (GL_ARB_buffer_storage)"
+                                                                   : "uploaded with glBufferSubData");
 
     // draw in wireframe
     //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
@@ -541,46 +952,300 @@ int main() {
     glm::vec3 cubePosition2[8];
 
 
+    rg::Profiler& profiler = rg::Profiler::Instance();
+    rg::GLStats& glStats = rg::GLStats::Instance();
+    rg::GLStateCache& stateCache = rg::GLStateCache::Instance();
+    rg::TextureStreamer& textureStreamer = rg::TextureStreamer::Instance();
+
+    inputRecorder.SetCallbacks(key_callback, mouse_callback, scroll_callback);
+    if (!recordPath.empty() && !inputRecorder.StartRecording(recordPath, FIXED_TIMESTEP)) {
+        LOG_ERROR(Input, "Failed to open recording: %s", recordPath.c_str());
+        return -1;
+    }
+    if (!replayPath.empty() && !inputRecorder.StartReplay(replayPath))
+        return -1;
+    const float timestep = inputRecorder.Replaying() ? inputRecorder.Timestep() : FIXED_TIMESTEP;
+
+    // the camera follows the scripted path instead of the input, or the replay decides the length of the run
+    unsigned int warmupFrames = BENCHMARK_WARMUP_FRAMES;
+    if (inputRecorder.Replaying()) {
+        warmupFrames = std::min(warmupFrames, inputRecorder.Frames() / 2);
+        benchmarkFrames = inputRecorder.Frames() - warmupFrames;
+    }
+    rg::Benchmark benchmark(benchmarkMode ? benchmarkFrames : 0, warmupFrames);
+    // from here on the loop is expected not to touch the heap, see AllocationTracker
+    rg::AllocationTracker& allocations = rg::AllocationTracker::Instance();
+    allocations.SetWarmup(warmupFrames);
+    rg::CameraPath cameraPath;
+    if (benchmarkMode) {
+        if (!inputRecorder.Replaying() && !cameraPath.Load(benchmarkPath)) {
+            LOG_ERROR(Benchmark, "Failed to load camera path: %s", benchmarkPath.c_str());
+            return -1;
+        }
+        rg::Benchmark::InstallDrawCounters();
+    }
+
     // render loop
     // -----------
-    while (!glfwWindowShouldClose(window)) {
-        // per-frame time logic
-        // --------------------
-        float currentFrame = glfwGetTime();
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
+    startup.Phase("First frame");
+    // Simulation and input run on this thread, everything that touches GL on the render thread, which owns the
+    // context from here on. A headless benchmark renders inline on this thread instead, so the measured frames
+    // don't depend on how the two threads get scheduled.
+    rg::FrameHandoff<FramePacket> frames;
+    const bool renderThreaded = window != NULL;
+    std::atomic<bool> shadersReady{false};
+
+    // draws a placeholder until every program has been compiled, false when the window was closed meanwhile
+    auto compileShaders = [&]() {
+        while (!shaderBatch.Poll()) {
+            if (frames.Closed())
+                return false;
+            jobs.RunGLThreadJobs();
+            if (window) {
+                float pulse = 0.05f + 0.05f * sin(glfwGetTime() * 4.0f);
+                glClearColor(pulse, pulse, pulse, 1.0f);
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                glfwSwapBuffers(window);
+            }
+        }
+        renderStats.shaderSetupMs = shaderBatch.SetupMilliseconds();
+        return true;
+    };
 
-        // input
-        // -----
-        processInput(window);
+    // the cascades and the model pass are recorded on the job system while the render thread submits other passes,
+    // recording only reads the scene and the frame packet
+    rg::CommandBuffer cascadeCommands[rg::CascadedShadowMap::MAX_CASCADES];
+    rg::CommandBuffer modelCommands;
+    rg::CommandBuffer depthCommands;
+    auto recordCascade = [&](int c, const FramePacket& frame) {
+        rg::CommandBuffer& commands = cascadeCommands[c];
+        commands.Clear();
+        commands.BindProgram(shadowDepthShader);
+        for (const SceneObject& object : sceneObjects) {
+            bool modelSet = false;
+            for (const Mesh& mesh : object.model->meshes) {
+                if (!cascadedShadow.Intersects(c, rg::transformAabb(mesh.bounds, object.transform)))
+                    continue;
+                if (!modelSet) {
+                    commands.SetModel(object.transform);
+                    modelSet = true;
+                }
+                commands.DrawMesh(mesh);
+            }
+        }
+        for (unsigned int i = 0; i < 8; i++) {
+            if (!cascadedShadow.Intersects(c, rg::transformAabb(cardBounds, frame.cardModels[i])))
+                continue;
+            commands.SetModel(frame.cardModels[i]);
+            commands.DrawArrays(VAO, 0, 36);
+        }
+    };
+    auto recordModelPass = [&](const FramePacket& frame) {
+        static const UniformName debugIdName("debugId");
+        modelCommands.Clear();
+        modelCommands.BindProgram(ourShader);
+        int meshId = 0;
+        for (const SceneObject& object : sceneObjects) {
+            modelCommands.SetModel(object.transform);
+            for (const Mesh& mesh : object.model->meshes) {
+                modelCommands.BindMaterial(mesh);
+                if (frame.debugView == DEBUG_VIEW_MESH_ID)
+                    modelCommands.SetInt(debugIdName, ++meshId);
+                modelCommands.DrawMesh(mesh);
+            }
+        }
+        // same objects in the same order, so every depth the lighting pass tests for equality was written here
+        depthCommands.Clear();
+        depthCommands.BindProgram(depthPrepassShader);
+        for (const SceneObject& object : sceneObjects) {
+            depthCommands.SetModel(object.transform);
+            for (const Mesh& mesh : object.model->meshes) {
+                depthCommands.BindAlphaTest(mesh);
+                depthCommands.DrawMeshPositions(mesh);
+            }
+        }
+    };
+
+    // all GL work of one frame, on the render thread
+    int viewportWidth = framebufferWidth, viewportHeight = framebufferHeight;
+    // size of the scene targets, follows the window once a resize has settled
+    rg::SettledSize renderSize(framebufferWidth, framebufferHeight);
+    auto renderFrame = [&](FramePacket& frame) {
+        std::chrono::steady_clock::time_point renderStart = std::chrono::steady_clock::now();
+        // the render thread's own, the main thread has another one for the UI
+        rg::FrameAllocator& frameAllocator = rg::FrameAllocator::Instance();
+        frameAllocator.Reset();
+        allocations.BeginFrame();
+        jobs.RunGLThreadJobs();
+        drawDataRing.BeginFrame();
+        glStats.BeginFrame();
+        stateCache.SetEnabled(frame.stateCache);
+        stateCache.BeginFrame();
+        profiler.BeginFrame();
+        dynamicResolution.BeginFrame();
+        renderTargets.BeginFrame();
+        if (renderThreaded && (frame.framebufferWidth != viewportWidth || frame.framebufferHeight != viewportHeight)) {
+            // make sure the viewport matches the new window dimensions; note that width and
+            // height will be significantly larger than specified on retina displays.
+            viewportWidth = frame.framebufferWidth;
+            viewportHeight = frame.framebufferHeight;
+            glViewport(0, 0, viewportWidth, viewportHeight);
+        }
+        sceneObjects[chairIndex].transform = frame.chairTransform;
+        glm::mat4 projection = frame.projection;
+        glm::mat4 view = frame.view;
+        // the scene is drawn into the corner of its targets the render scale covers
+        renderSize.Update(frame.framebufferWidth, frame.framebufferHeight);
+        const int targetWidth = renderSize.Width(), targetHeight = renderSize.Height();
+        float renderScale = dynamicResolution.Scale();
+        int sceneWidth = std::max(1, (int) std::lround(targetWidth * renderScale));
+        int sceneHeight = std::max(1, (int) std::lround(targetHeight * renderScale));
+        glm::vec2 sceneUvScale((float) sceneWidth / targetWidth, (float) sceneHeight / targetHeight);
+        // the debug views accumulate counts and write mesh ids into red, that needs at least a half float channel
+        // (R11F_G11F_B10F only keeps 6 mantissa bits)
+        GLenum sceneFormat = frame.sceneFormat;
+        if (frame.debugView != DEBUG_VIEW_OFF && sceneFormat != GL_RGBA16F && sceneFormat != GL_RGB16F &&
+            sceneFormat != GL_RGBA32F)
+            sceneFormat = GL_RGBA16F;
+        // formats the driver can't render to fall back to RGBA16F, which 3.3 guarantees
+        const rg::RenderTargetDesc sceneTarget = {renderTargets.RenderableFormat(sceneFormat, GL_RGBA16F),
+                                                  targetWidth, targetHeight, 1};
+        const rg::RenderTargetDesc hdrTarget = {renderTargets.RenderableFormat(frame.bloomFormat, GL_RGBA16F),
+                                                targetWidth, targetHeight, 1};
+        rg::JobCounter recorded;
+        jobs.Run([&recordModelPass, &frame]() { recordModelPass(frame); }, &recorded);
 
         // render
         // ------
-        glClearColor(programState->clearColor.r, programState->clearColor.g, programState->clearColor.b, 1.0f);
+        glBindFramebuffer(GL_FRAMEBUFFER, outputFBO);
+        glClearColor(frame.clearColor.r, frame.clearColor.g, frame.clearColor.b, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+        // 0. render point light shadows, the static cube map is only refreshed when a static caster or the light moved
+        // ------------------------------------------------------------------------------------------------------------
+        profiler.Push("Point shadows");
+        renderStats.pointShadowStaticUpdated = false;
+        renderStats.pointShadowDynamicDraws = 0;
+        if (frame.pointShadows) {
+            pointShadow.SetLightPosition(frame.pointLight.position);
+            for (SceneObject& object : sceneObjects) {
+                if (!object.dynamic && object.castsPointShadow && object.transform != object.shadowTransform)
+                    pointShadow.InvalidateStatic();
+            }
+            glDisable(GL_CULL_FACE);
+            if (pointShadow.StaticDirty()) {
+                pointShadow.BeginStatic(pointShadowShader);
+                for (SceneObject& object : sceneObjects) {
+                    if (object.dynamic || !object.castsPointShadow)
+                        continue;
+                    pointShadowShader.setMat4("model", object.transform);
+                    object.model->DrawGeometry();
+                    object.shadowTransform = object.transform;
+                }
+                pointShadow.End();
+                renderStats.pointShadowStaticUpdated = true;
+            }
+            // dynamic casters: the rocking chair and the cards
+            pointShadow.BeginDynamic(pointShadowShader);
+            for (SceneObject& object : sceneObjects) {
+                if (!object.dynamic || !object.castsPointShadow)
+                    continue;
+                pointShadowShader.setMat4("model", object.transform);
+                object.model->DrawGeometry();
+                renderStats.pointShadowDynamicDraws += object.model->meshes.size();
+            }
+            glBindVertexArray(VAO);
+            for (unsigned int i = 0; i < 8; i++) {
+                pointShadowShader.setMat4("model", frame.cardModels[i]);
+                glDrawArrays(GL_TRIANGLES, 0, 36);
+            }
+            glBindVertexArray(0);
+            renderStats.pointShadowDynamicDraws += 8;
+            pointShadow.End();
+        }
+        renderStats.pointShadowStaticRebuilds = pointShadow.StaticRebuilds();
+        profiler.Pop();
+
+        // 0b. render the cascades of the moon light that are due this frame, casters are culled per cascade
+        // ---------------------------------------------------------------------------------------------------
+        profiler.Push("Cascaded shadows");
+        if (frame.dirShadows) {
+            cascadedShadow.Configure(frame.cascadeCount, frame.cascadeResolution);
+            cascadedShadow.Update(view, glm::radians(frame.cameraZoom), frame.aspect, 0.1f,
+                                  frame.dirLight.direction);
+            // every cascade due this frame culls its casters and records its draws on a worker
+            for (int c = 0; c < cascadedShadow.CascadeCount(); c++) {
+                if (cascadedShadow.NeedsRender(c))
+                    jobs.Run([&recordCascade, &frame, c]() { recordCascade(c, frame); }, &recorded);
+            }
+            jobs.Wait(recorded);
+            glDisable(GL_CULL_FACE);
+            for (int c = 0; c < cascadedShadow.CascadeCount(); c++) {
+                if (!cascadedShadow.NeedsRender(c))
+                    continue;
+                cascadedShadow.BeginCascade(c, shadowDepthShader);
+                cascadeCommands[c].Submit();
+                cascadedShadow.EndCascade(c, cascadeCommands[c].DrawCount());
+            }
+            renderStats.cascadeCount = cascadedShadow.CascadeCount();
+            for (int c = 0; c < renderStats.cascadeCount; c++)
+                renderStats.cascades[c] = cascadedShadow.Stats(c);
+        } else {
+            renderStats.cascadeCount = 0;
+        }
+        profiler.Pop();
+
+        // stream in the texture levels the models are seen at, the moon only ever needs its small ones
+        profiler.Push("Texture streaming");
+        textureStreamer.SetBudget((size_t) frame.textureBudgetMB * 1024 * 1024);
+        auto requestTextures = [&](const Model& model, const glm::mat4& transform) {
+            for (const Mesh& mesh : model.meshes) {
+                float pixels = rg::TextureStreamer::ScreenSize(rg::transformAabb(mesh.bounds, transform), view,
+                                                               glm::radians(frame.cameraZoom), sceneHeight);
+                for (const Texture& texture : mesh.textures)
+                    textureStreamer.Request(texture.id, pixels);
+            }
+        };
+        for (const SceneObject& object : sceneObjects)
+            requestTextures(*object.model, object.transform);
+        requestTextures(Moon, moonModel);
+        textureStreamer.Update();
+        profiler.Pop();
+
         // 1. render scene into floating point framebuffer
         // -----------------------------------------------
-        glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
+        profiler.Push("Model pass");
+        // 2 floating point color buffers, 1 for normal rendering, the other for brightness threshold values
+        unsigned int hdrColor = renderTargets.Acquire(sceneTarget, "HDR color");
+        unsigned int hdrBright = renderTargets.Acquire(hdrTarget, "HDR bright");
+        unsigned int hdrDepth = renderTargets.Acquire({GL_DEPTH_COMPONENT24, targetWidth, targetHeight, 1}, "HDR depth");
+        glBindFramebuffer(GL_FRAMEBUFFER, renderTargets.Framebuffer({hdrColor, hdrBright}, hdrDepth));
+        glViewport(0, 0, sceneWidth, sceneHeight);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         // don't forget to enable shader before setting uniforms
         ourShader.use();
-        dirLight.ambient = glm::vec3(0.02, 0.02, 0.02);
-
-        ourShader.setVec3("pointLight.position", pointLight.position);
-        ourShader.setVec3("pointLight.ambient", pointLight.ambient);
-        ourShader.setVec3("pointLight.color",normalize(lightColors[1]));
-        ourShader.setVec3("pointLight.diffuse", pointLight.diffuse);
-        ourShader.setVec3("pointLight.specular", pointLight.specular);
-        ourShader.setFloat("pointLight.constant", pointLight.constant);
-        ourShader.setFloat("pointLight.linear", pointLight.linear);
-        ourShader.setFloat("pointLight.quadratic", pointLight.quadratic);
-        ourShader.setVec3("dirLight.position", dirLight.direction);
-        ourShader.setVec3("dirLight.ambient", dirLight.ambient);
+        const PointLight& pointLight = frame.pointLight;
+        const DirLight& dirLight = frame.dirLight;
+
+        ourShader.setVec3("pointLights[0].position", pointLight.position);
+        ourShader.setVec3("pointLights[0].ambient", pointLight.ambient);
+        ourShader.setVec3("pointLights[0].color",normalize(lightColors[1]));
+        ourShader.setVec3("pointLights[0].diffuse", pointLight.diffuse);
+        ourShader.setVec3("pointLights[0].specular", pointLight.specular);
+        ourShader.setFloat("pointLights[0].constant", pointLight.constant);
+        ourShader.setFloat("pointLights[0].linear", pointLight.linear);
+        ourShader.setFloat("pointLights[0].quadratic", pointLight.quadratic);
+        ourShader.setBool("pointShadows", frame.pointShadows);
+        pointShadow.Bind(pointShadowStaticUnit, pointShadowDynamicUnit);
+        ourShader.setVec3("dirLight.direction", dirLight.direction);
+        ourShader.setBool("dirShadows", frame.dirShadows);
+        cascadedShadow.SetUniforms(ourShader);
+        cascadedShadow.Bind(cascadeShadowUnit);
+        ourShader.setVec3("dirLight.ambient", glm::vec3(0.02, 0.02, 0.02));
         ourShader.setVec3("dirLight.diffuse", dirLight.diffuse);
         ourShader.setVec3("dirLight.specular", dirLight.specular);
-        ourShader.setVec3("viewPosition", programState->camera.Position);
+        ourShader.setVec3("viewPosition", frame.cameraPosition);
         ourShader.setFloat("material.shininess", 32.0f);
         // spotLight
         ourShader.setVec3("spotLight.position", glm::vec3(3.66,6.9,7.f));
@@ -594,80 +1259,61 @@ int main() {
         ourShader.setFloat("spotLight.quadratic", 0.039);
         ourShader.setFloat("spotLight.cutOff", glm::cos(glm::radians(28.5f)));
         ourShader.setFloat("spotLight.outerCutOff", glm::cos(glm::radians(36.0f)));
-        ourShader.setFloat("spotLight.turnOn",spotLight.turnOn);
+        ourShader.SetFeature(ShaderFeatures::SPOTLIGHT_ON, frame.spotLightOn);
+        ourShader.SetFeature(ShaderFeatures::DEBUG_VIEW, frame.debugView);
 
-        // view/projection transformations
-        glm::mat4 projection = glm::perspective(glm::radians(programState->camera.Zoom),
-                                                (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 100.0f);
-        glm::mat4 view = programState->camera.GetViewMatrix();
         ourShader.setMat4("projection", projection);
         ourShader.setMat4("view", view);
 
-        // render the loaded model
-        glm::mat4 model = glm::mat4(1.0f);
-
-
-        //Dog
-        model = glm::mat4(1.0f);
-        model = glm::translate(model,glm::vec3(9.0,0.0,0.0));
-        model = glm::rotate(model, (float)glm::radians(-45.f),glm::vec3(0.0,1,0.0));
-        model = glm::scale(model, glm::vec3(0.5f,0.5f,0.5f));
-        ourShader.setMat4("model", model);
-        Dog.Draw(ourShader);
-
-        //Tree
-        model = glm::mat4(1.0f);
-        model = glm::translate(model,glm::vec3(0.0,0.0,0.0));
-        model = glm::rotate(model, (float)glm::radians(-90.f),glm::vec3(1.0,0,0.0));
-        model = glm::scale(model, glm::vec3(0.25f,0.25f,0.25f));
-        ourShader.setMat4("model", model);
-        Tree.Draw(ourShader);
-
-        //Table
-        model = glm::mat4(1.0f);
-        model = glm::translate(model,glm::vec3(3.0,0.0,7.0));
-        model = glm::scale(model, glm::vec3(2.5f,2.5f,2.5f));
-        ourShader.setMat4("model", model);
-        Table.Draw(ourShader);
-
-        //Chair
-        model = glm::mat4(1.0f);
-        model = glm::translate(model,glm::vec3(-3.0,0.0,7.0));
-        model = glm::rotate(model, (float)glm::radians(sin((float)glfwGetTime())* 15),glm::vec3(0.0,0,1.0));
-        model = glm::rotate(model, (float)glm::radians(90.f),glm::vec3(0.0,1,0.0));
-        model = glm::scale(model, glm::vec3(0.8f,0.8f,0.8f));
-        ourShader.setMat4("model", model);
-        Chair.Draw(ourShader);
-
-        //Lamp
-        model = glm::mat4(1.0f);
-        model = glm::translate(model,glm::vec3(0.0,-1,17.0));
-        model = glm::rotate(model, (float)glm::radians(80.f),glm::vec3(0.0,1,0.0));
-        model = glm::scale(model, glm::vec3(1.35f,1.35f,1.35f));
-        ourShader.setMat4("model", model);
-        Lamp.Draw(ourShader);
-
-        //Desk Lamp
-        model = glm::mat4(1.0f);
-        model = glm::translate(model,glm::vec3(4.6,3.54,7.f));
-        model = glm::rotate(model, (float)glm::radians(-90.f),glm::vec3(1.0,0.0,0.0));
-        model = glm::rotate(model, (float)glm::radians(180.f),glm::vec3(0.0,0.0,1.0));
-        model = glm::scale(model, glm::vec3(0.081f,0.081f,0.081f));
-        ourShader.setMat4("model", model);
-        DeskLamp.Draw(ourShader);
+        // render the loaded models, with the pre-pass the lighting shader only runs where its depth is the closest
+        jobs.Wait(recorded);
+        if (frame.depthPrepass) {
+            profiler.Push("Depth pre-pass");
+            depthPrepassShader.use();
+            depthPrepassShader.setMat4("projection", projection);
+            depthPrepassShader.setMat4("view", view);
+            glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+            prepassTimer.Begin();
+            prepassFragments.Begin();
+            depthCommands.Submit(&drawDataRing);
+            prepassFragments.End();
+            prepassTimer.End();
+            glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+            glDepthFunc(GL_EQUAL);
+            glDepthMask(GL_FALSE);
+            profiler.Pop();
+        }
+        ourShader.use();
+        // every shaded fragment adds one to the overdraw count
+        if (frame.debugView == DEBUG_VIEW_OVERDRAW) {
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_ONE, GL_ONE);
+        }
+        lightingTimers[frame.depthPrepass].Begin();
+        lightingFragments.Begin();
+        modelCommands.Submit(&drawDataRing);
+        lightingFragments.End();
+        lightingTimers[frame.depthPrepass].End();
+        glDepthFunc(GL_LESS);
+        glDepthMask(GL_TRUE);
 
         //Moon
-        dirLight.ambient = glm::vec3(1, 1, 1);
-        ourShader.setVec3("dirLight.ambient", dirLight.ambient);
+        ourShader.setVec3("dirLight.ambient", glm::vec3(1, 1, 1));
         ourShader.setFloat("material.shininess", 512.0f);
-
-        model = glm::mat4(1.0f);
-        model = glm::translate(model,glm::vec3(10.0,20.0,-40.0));
-        model = glm::scale(model, glm::vec3(0.4f,0.4f,0.4f));
-        ourShader.setMat4("model", model);
+        size_t moonDraw = drawDataRing.Push(&moonModel, sizeof(glm::mat4));
+        drawDataRing.Commit();
+        drawDataRing.Bind(UniformBlocks::PER_DRAW.binding, moonDraw, sizeof(glm::mat4));
+        if (frame.debugView == DEBUG_VIEW_MESH_ID)
+            ourShader.setInt("debugId", (int) modelCommands.DrawCount() + 1);
         Moon.Draw(ourShader);
+        glDisable(GL_BLEND);
+        // the heatmaps only cover the lighting shader, the rest of the scene still occludes but leaves them alone
+        if (frame.debugView != DEBUG_VIEW_OFF)
+            glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        profiler.Pop();
 
         // bind textures on corresponding texture units
+        profiler.Push("Card pass");
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, texture1);
         glActiveTexture(GL_TEXTURE1);
@@ -684,108 +1330,35 @@ int main() {
         blendShader.setMat4("projection", projection);
         blendShader.setMat4("view", view);
 
-        // --------------------------------------------------
-        // USED FOR MINI GAME
-        //
-        if(gameState.reset) {
-            srand(time(0));
-            for (int i = 0; i < 8; i++) {
-                newOrder[i] = -1;
-            }
-            for (int i = 0; i < 8; i++) {
-                int x = rand() % 8;
-                while (std::find(newOrder.begin(), newOrder.end(), x) != newOrder.end()) {
-                    x = rand() % 8;
-                }
-                newOrder[i] = x;
-            }
-            for (int i = 0; i < 8; i++) {
-                cubePosition2[i] = cubePositions[newOrder[i]];
-                gameState.rot[i] = 0;
-                gameState.used[i] = false;
-                gameState.number = 0;
-                gameState.pickedCount = 0;
-                gameState.card = -1;
-            }
-            gameState.reset = false;
-        }
-        auto it = find(newOrder.begin(), newOrder.end(),gameState.card);
-        if(gameState.cleared){
-            gameState.now = it - newOrder.begin();
-            if(gameState.card != -1 && !gameState.used[gameState.now ] && gameState.pickedCount < 4) {
-
-                gameState.number++;
-
-                gameState.used[gameState.now ] = true;
-                gameState.rot[gameState.now ] = 180.f;
-                if (gameState.number == 1) {
-                    gameState.last = gameState.now;
-                }
-                if (gameState.number == 2) {
-                    gameState.number = 0;
-                     if (gameState.now  / 2 == gameState.last / 2) {
-                         gameState.move = true;
-                     }
-                     else{
-                         gameState.used[gameState.last] = false;
-                         gameState.used[gameState.now ] = false;
-                     }
-                     gameState.timer = glfwGetTime();
-                     gameState.cleared = false;
-                     gameState.card = -1;
-                }
-            }
-        }
-        if(glfwGetTime() - gameState.timer > 1 && !gameState.cleared) {
-
-            if(gameState.move){
-                cubePosition2[gameState.now] = cardPicked[gameState.pickedCount  * 2];
-                cubePosition2[gameState.last] = cardPicked[gameState.pickedCount*2 + 1];
-                gameState.pickedCount += 1;
-                gameState.move = false;
-            } else {
-                gameState.rot[gameState.last] = 0;
-                gameState.rot[gameState.now] = 0;
-            }
-            gameState.cleared = true;
-        }
-        // --------------------------------------------------
-        // render cards
+        // render cards, all their matrices go to the ring at once
+        size_t cardStride = drawDataRing.Stride(sizeof(glm::mat4));
+        size_t cardDraws = drawDataRing.Allocate(8 * cardStride);
+        for (unsigned int i = 0; i < 8; i++)
+            memcpy((char*) drawDataRing.Pointer(cardDraws) + i * cardStride, &frame.cardModels[i], sizeof(glm::mat4));
+        drawDataRing.Commit();
         glBindVertexArray(VAO);
         int pair = 0;
         bool drawVictory = true;
         for (unsigned int i = 0; i < 8; i++){
-            glCullFace(GL_FRONT);
-            bool side = false;
             if (i%2 == 0)
                 pair++;
-            blendShader.setBool("side", side);
-            blendShader.setInt("pair", pair);
-
-            // calculate the model matrix for each object and pass it to shader before drawing
-            glm::mat4 model = glm::mat4(1.0f); // make sure to initialize matrix to identity matrix first
-            model = glm::translate(model, cubePosition2[i]);
-            float angle = 90.0f;
-            model = glm::rotate(model, glm::radians(angle), glm::vec3(0.0f, 1.0f, 0.0f));
-            model = glm::rotate(model, glm::radians(angle), glm::vec3(1.0f, 0.0f, 0.0f));
-            model = glm::rotate(model, glm::radians(angle), glm::vec3(0.0f, 1.0f, 0.0f));
-            model = glm::rotate(model, glm::radians(gameState.rot[i]), glm::vec3(0.0f, 1.0f, 0.0f));
-            if(gameState.rot[i])
-                glCullFace(GL_BACK);
+            blendShader.SetFeature(ShaderFeatures::CARD_BACK, false);
+            blendShader.SetFeature(ShaderFeatures::CARD_PAIR, pair);
 
-            model = glm::scale(model, glm::vec3(0.7f,0.7f,0.7f));
+            glCullFace(frame.cardFaceUp[i] ? GL_BACK : GL_FRONT);
 
-            blendShader.setMat4("model", model);
+            drawDataRing.Bind(UniformBlocks::PER_DRAW.binding, cardDraws + i * cardStride, sizeof(glm::mat4));
 
             glDrawArrays(GL_TRIANGLES, 0, 6);
 
             glCullFace(GL_FRONT);
 
-            side = true;
-            blendShader.setBool("side", side);
+            // the back doesn't depend on the pair, all cards share one program for it
+            blendShader.SetFeature(ShaderFeatures::CARD_BACK, true);
+            blendShader.SetFeature(ShaderFeatures::CARD_PAIR, 0);
             glDrawArrays(GL_TRIANGLES, 6, 36);
 
-            if(!gameState.used[i]){
+            if(!frame.cardUsed[i]){
                 drawVictory = false;
             }
         }
@@ -805,15 +1378,18 @@ int main() {
         }
 
 
+        profiler.Pop();
+
         // finally show all the light sources as bright cubes
+        profiler.Push("Light cubes");
         shaderLight.use();
         shaderLight.setMat4("projection", projection);
         shaderLight.setMat4("view", view);
         for (unsigned int i = 0; i < lightPositions.size(); i++)
         {
-            if (i == 0 && !spotLight.turnOn)
+            if (i == 0 && !frame.spotLightOn)
                 continue;
-            model = glm::mat4(1.0f);
+            glm::mat4 model = glm::mat4(1.0f);
             model = glm::translate(model, glm::vec3(lightPositions[i]));
             model = glm::rotate(model, (float)glm::radians(-10.f),glm::vec3(0,1,0));
             model = glm::scale(model, glm::vec3(lightScales[i]));
@@ -822,10 +1398,13 @@ int main() {
             renderCube();
         }
 
+        profiler.Pop();
+
         // Draw skybox
+        profiler.Push("Skybox");
         glDepthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
         skyboxShader.use();
-        view = glm::mat4(glm::mat3(programState->camera.GetViewMatrix())); // remove translation from the view matrix
+        view = glm::mat4(glm::mat3(frame.view)); // remove translation from the view matrix
         skyboxShader.setMat4("view", view);
         skyboxShader.setMat4("projection", projection);
         // skybox cube
@@ -835,55 +1414,351 @@ int main() {
         glDrawArrays(GL_TRIANGLES, 0, 36);
         glBindVertexArray(0);
         glDepthFunc(GL_LESS); // set depth function back to default
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        profiler.Pop();
 
 
         // 2. blur bright fragments with two-pass Gaussian Blur
         // --------------------------------------------------
+        profiler.Push("Bloom blur");
+        renderTargets.Release(hdrDepth);
         bool horizontal = true, first_iteration = true;
         unsigned int amount = 10;
+        // the second ping-pong buffer is acquired once the first pass has read the bright colors, it gets their texture
+        unsigned int pingpongColorbuffers[2] = {0, renderTargets.Acquire(hdrTarget, "Bloom ping-pong 1")};
         shaderBlur.use();
+        shaderBlur.setVec2("uvScale", sceneUvScale);
+        // the passes before leave any unit active, the blur samples unit 0
+        glActiveTexture(GL_TEXTURE0);
         for (unsigned int i = 0; i < amount; i++)
         {
-            glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[horizontal]);
+            if (!pingpongColorbuffers[horizontal])
+                pingpongColorbuffers[horizontal] = renderTargets.Acquire(hdrTarget, "Bloom ping-pong 0");
+            glBindFramebuffer(GL_FRAMEBUFFER, renderTargets.Framebuffer({pingpongColorbuffers[horizontal]}));
             shaderBlur.setInt("horizontal", horizontal);
-            glBindTexture(GL_TEXTURE_2D, first_iteration ? colorBuffers[1] : pingpongColorbuffers[!horizontal]);  // bind texture of other framebuffer (or scene if first iteration)
+            glBindTexture(GL_TEXTURE_2D, first_iteration ? hdrBright : pingpongColorbuffers[!horizontal]);  // bind texture of other framebuffer (or scene if first iteration)
             renderQuad();
             horizontal = !horizontal;
-            if (first_iteration)
+            if (first_iteration) {
                 first_iteration = false;
+                renderTargets.Release(hdrBright);
+            }
         }
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, outputFBO);
+        profiler.Pop();
 
         // 3. now render floating point color buffer to 2D quad and tonemap HDR colors to default framebuffer's (clamped) color range
         // --------------------------------------------------------------------------------------------------------------------------
+        profiler.Push("Tonemap");
+        glViewport(0, 0, viewportWidth, viewportHeight);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        hdrShader.use();
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, colorBuffers[0]);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[!horizontal]);
-        hdrShader.setInt("bloom", bloom);
-        hdrShader.setFloat("exposure", exposure);
+        if (frame.debugView != DEBUG_VIEW_OFF) {
+            debugViewShader.use();
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, hdrColor);
+            debugViewShader.setInt("mode", frame.debugView);
+            debugViewShader.setFloat("range", debugViewRanges[frame.debugView]);
+            debugViewShader.setVec2("uvScale", sceneUvScale);
+        } else {
+            hdrShader.use();
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, hdrColor);
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[!horizontal]);
+            hdrShader.setInt("bloom", frame.bloom);
+            hdrShader.setFloat("exposure", frame.exposure);
+            hdrShader.setVec2("uvScale", sceneUvScale);
+        }
         renderQuad();
+        renderTargets.Release(hdrColor);
+        renderTargets.Release(pingpongColorbuffers[0]);
+        renderTargets.Release(pingpongColorbuffers[1]);
+        profiler.Pop();
 
-        std::cout << "bloom: " << (bloom ? "on" : "off") << "| exposure: " << exposure << std::endl;
 
 
+        renderStats.lightingVariants = ourShader.VariantCount();
+        renderStats.cardVariants = blendShader.VariantCount();
+        if (ImDrawData* drawData = frame.imgui.Data()) {
+            PROFILE_SCOPE("ImGui");
+            ImGui_ImplOpenGL3_RenderDrawData(drawData);
+        }
+        drawDataRing.EndFrame();
+        renderStats.drawDataPersistent = drawDataRing.Persistent();
+        renderStats.drawDataHighWater = drawDataRing.HighWater();
+        renderStats.drawDataStalls = drawDataRing.Stalls();
+        dynamicResolution.EndFrame(frame.dynamicResolution);
+        renderStats.renderScale = renderScale;
+        renderStats.gpuFrameMs = dynamicResolution.GpuMilliseconds();
+        renderStats.sceneWidth = sceneWidth;
+        renderStats.sceneHeight = sceneHeight;
+        renderStats.renderTargetCount = renderTargets.TargetCount();
+        renderStats.sceneFormat = sceneTarget.internalFormat;
+        renderStats.bloomFormat = hdrTarget.internalFormat;
+        renderStats.renderTargetBytes = renderTargets.ResidentBytes();
+        renderStats.renderTargetPeak = renderTargets.PeakBytes();
+        renderStats.renderTargetAllocations = renderTargets.Allocations();
+        renderStats.renderTargetFrees = renderTargets.Frees();
+        renderStats.depthPrepass = frame.depthPrepass;
+        renderStats.prepassFragments = prepassFragments.Fragments();
+        renderStats.lightingFragments = lightingFragments.Fragments();
+        renderStats.prepassMs = prepassTimer.Milliseconds();
+        for (int mode = 0; mode < 2; mode++)
+            renderStats.lightingMs[mode] = lightingTimers[mode].Milliseconds();
+        profiler.EndFrame();
+        glStats.EndFrame();
+        stateCache.EndFrame();
+        renderStats.stateCache = stateCache.Enabled();
+        renderStats.stateCalls = stateCache.LastFrame();
+        allocations.EndFrame();
+        renderStats.frameAllocatorUsed = frameAllocator.Used();
+        renderStats.frameAllocatorHighWater = frameAllocator.HighWater();
+        renderStats.frameAllocatorCapacity = frameAllocator.Capacity();
+        renderStats.programCacheHits = rg::ProgramCache::Instance().Hits();
+        renderStats.programCacheMisses = rg::ProgramCache::Instance().Misses();
+        renderStats.simulationMs = frame.simulationMs;
+        renderStats.renderMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - renderStart).count();
+        std::lock_guard<std::mutex> lock(renderStatsMutex);
+        shownRenderStats = renderStats;
+    };
 
-        if (programState->ImGuiEnabled)
-            DrawImGui(programState);
-        // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
-        // -------------------------------------------------------------------------------
-        glfwSwapBuffers(window);
+    std::thread renderThread;
+    if (renderThreaded) {
+        // the context moves over to the render thread
+        glfwMakeContextCurrent(NULL);
+        renderThread = std::thread([&]() {
+            rg::AllocationTracker::NameThread("Render");
+            glfwMakeContextCurrent(window);
+            jobs.AttachThread();
+            jobs.SetGLThread();
+            if (compileShaders()) {
+                shadersReady.store(true);
+                glfwPostEmptyEvent();
+                while (FramePacket* frame = frames.Acquire()) {
+                    renderFrame(*frame);
+                    // glfw: swap buffers
+                    glfwSwapBuffers(window);
+                    frames.Release();
+                }
+            }
+            glfwMakeContextCurrent(NULL);
+        });
+        // keeps the window responsive while the render thread waits for the shaders
+        while (!shadersReady.load() && !glfwWindowShouldClose(window))
+            glfwWaitEventsTimeout(0.05);
+    } else {
+        compileShaders();
+    }
+    startup.End(shaderCompilation);
+
+    unsigned int simulationFrame = 0;
+    float aspect = (float) SCR_WIDTH / (float) SCR_HEIGHT;
+    while (benchmarkMode ? !benchmark.Done() : !glfwWindowShouldClose(window)) {
+        // the first frame has been presented, the cold start is over
+        if (frames.Rendered() > 0 && !startup.Finished())
+            startup.Finish("startup_trace.json");
+        std::chrono::steady_clock::time_point simulationStart = std::chrono::steady_clock::now();
+        // per-frame time logic
+        // --------------------
+        float currentFrame = deterministic ? simulationFrame * timestep : glfwGetTime();
+        deltaTime = deterministic ? timestep : currentFrame - lastFrame;
+        lastFrame = currentFrame;
+
+        if (benchmarkMode)
+            benchmark.BeginFrame();
+
+        // input
+        // -----
+        if (!inputRecorder.BeginFrame(window))
+            break; // the replay ran out of frames
+        if (!benchmarkMode || inputRecorder.Replaying())
+            processInput(window);
+        if (benchmarkMode && !inputRecorder.Replaying()) {
+            rg::CameraPath::Key key = cameraPath.Sample(benchmark.PathTime());
+            programState->camera.Position = key.position;
+            programState->camera.SetOrientation(key.yaw, key.pitch);
+        }
+
+        // --------------------------------------------------
+        // USED FOR MINI GAME
+        //
+        if(gameState.reset) {
+            srand(inputRecorder.ShuffleSeed(benchmarkMode ? 0 : (unsigned int) time(0)));
+            for (int i = 0; i < 8; i++) {
+                newOrder[i] = -1;
+            }
+            for (int i = 0; i < 8; i++) {
+                int x = rand() % 8;
+                while (std::find(newOrder.begin(), newOrder.end(), x) != newOrder.end()) {
+                    x = rand() % 8;
+                }
+                newOrder[i] = x;
+            }
+            for (int i = 0; i < 8; i++) {
+                cubePosition2[i] = cubePositions[newOrder[i]];
+                gameState.rot[i] = 0;
+                gameState.used[i] = false;
+                gameState.number = 0;
+                gameState.pickedCount = 0;
+                gameState.card = -1;
+            }
+            gameState.reset = false;
+        }
+        auto it = find(newOrder.begin(), newOrder.end(),gameState.card);
+        if(gameState.cleared){
+            gameState.now = it - newOrder.begin();
+            if(gameState.card != -1 && !gameState.used[gameState.now ] && gameState.pickedCount < 4) {
+
+                gameState.number++;
+
+                gameState.used[gameState.now ] = true;
+                inputRecorder.Event(rg::InputRecorder::PICK, gameState.now);
+                gameState.rot[gameState.now ] = 180.f;
+                if (gameState.number == 1) {
+                    gameState.last = gameState.now;
+                }
+                if (gameState.number == 2) {
+                    gameState.number = 0;
+                     if (gameState.now  / 2 == gameState.last / 2) {
+                         gameState.move = true;
+                     }
+                     else{
+                         gameState.used[gameState.last] = false;
+                         gameState.used[gameState.now ] = false;
+                     }
+                     gameState.timer = currentFrame;
+                     gameState.cleared = false;
+                     gameState.card = -1;
+                }
+            }
+        }
+        if(currentFrame - gameState.timer > 1 && !gameState.cleared) {
+
+            if(gameState.move){
+                cubePosition2[gameState.now] = cardPicked[gameState.pickedCount  * 2];
+                cubePosition2[gameState.last] = cardPicked[gameState.pickedCount*2 + 1];
+                gameState.pickedCount += 1;
+                gameState.move = false;
+            } else {
+                gameState.rot[gameState.last] = 0;
+                gameState.rot[gameState.now] = 0;
+            }
+            gameState.cleared = true;
+        }
+
+        // everything the renderer needs goes into the frame packet
+        // ---------------------------------------------------------
+        FramePacket& frame = frames.Write();
+        frame.frame = simulationFrame;
+        // calculate the model matrix for each card, used by the shadow and the card pass
+        for (unsigned int i = 0; i < 8; i++) {
+            glm::mat4 model = glm::mat4(1.0f); // make sure to initialize matrix to identity matrix first
+            model = glm::translate(model, cubePosition2[i]);
+            float angle = 90.0f;
+            model = glm::rotate(model, glm::radians(angle), glm::vec3(0.0f, 1.0f, 0.0f));
+            model = glm::rotate(model, glm::radians(angle), glm::vec3(1.0f, 0.0f, 0.0f));
+            model = glm::rotate(model, glm::radians(angle), glm::vec3(0.0f, 1.0f, 0.0f));
+            model = glm::rotate(model, glm::radians(gameState.rot[i]), glm::vec3(0.0f, 1.0f, 0.0f));
+            model = glm::scale(model, glm::vec3(0.7f,0.7f,0.7f));
+            frame.cardModels[i] = model;
+            frame.cardFaceUp[i] = gameState.rot[i] != 0;
+            frame.cardUsed[i] = gameState.used[i];
+        }
+        // --------------------------------------------------
+
+        //Chair
+        model = glm::mat4(1.0f);
+        model = glm::translate(model,glm::vec3(-3.0,0.0,7.0));
+        model = glm::rotate(model, (float)glm::radians(sin(currentFrame)* 15),glm::vec3(0.0,0,1.0));
+        model = glm::rotate(model, (float)glm::radians(90.f),glm::vec3(0.0,1,0.0));
+        model = glm::scale(model, glm::vec3(0.8f,0.8f,0.8f));
+        frame.chairTransform = model;
+
+        // view/projection transformations, a minimized window keeps the last aspect ratio
+        if (framebufferWidth > 0 && framebufferHeight > 0)
+            aspect = (float) framebufferWidth / (float) framebufferHeight;
+        frame.aspect = aspect;
+        frame.projection = glm::perspective(glm::radians(programState->camera.Zoom), aspect, 0.1f, 100.0f);
+        frame.view = programState->camera.GetViewMatrix();
+        frame.cameraPosition = programState->camera.Position;
+        frame.cameraZoom = programState->camera.Zoom;
+        frame.clearColor = programState->clearColor;
+        frame.pointLight = pointLight;
+        frame.dirLight = dirLight;
+        frame.spotLightOn = spotLight.turnOn;
+        frame.pointShadows = programState->pointShadows;
+        frame.dirShadows = programState->dirShadows;
+        frame.cascadeCount = programState->cascadeCount;
+        frame.cascadeResolution = programState->cascadeResolution;
+        frame.textureBudgetMB = programState->textureBudgetMB;
+        frame.dynamicResolution = programState->dynamicResolution;
+        frame.sceneFormat = programState->sceneFormat;
+        frame.bloomFormat = programState->bloomFormat;
+        frame.depthPrepass = programState->depthPrepass;
+        frame.debugView = programState->debugView;
+        frame.stateCache = programState->stateCache;
+        // reproducible runs render every frame at full resolution, otherwise the GPU's load decides what they show
+        frame.dynamicResolution.enabled = programState->dynamicResolution.enabled && !deterministic;
+        frame.bloom = bloom;
+        frame.exposure = exposure;
+        frame.framebufferWidth = framebufferWidth;
+        frame.framebufferHeight = framebufferHeight;
+        if (programState->ImGuiEnabled && !benchmarkMode) {
+            // the windows show what the render thread published with its last finished frame, no waiting for it
+            BuildImGui(programState);
+            frame.imgui.Capture(ImGui::GetDrawData());
+        } else {
+            frame.imgui.Clear();
+        }
+        inputRecorder.EndFrame(programState->camera, hashGameState());
+        simulationFrame++;
+        frame.simulationMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - simulationStart).count();
+        frames.Publish();
+        if (!renderThreaded) {
+            renderFrame(*frames.Acquire());
+            frames.Release();
+        }
+        if (benchmarkMode) {
+            benchmark.EndFrame();
+            inputRecorder.Poll(window);
+            continue;
+        }
+        // glfw: poll IO events (keys pressed/released, mouse moved etc.), the render thread swaps the buffers
+        // ---------------------------------------------------------------------------------------------------
         glfwPollEvents();
+        inputRecorder.Poll(window);
+    }
+    // the render thread finishes the frame it is on and gives the context back
+    frames.Close();
+    if (renderThread.joinable()) {
+        renderThread.join();
+        glfwMakeContextCurrent(window);
+        jobs.SetGLThread();
     }
-    programState->SaveToFile("resources/program_state.txt");
+    inputRecorder.Close();
+    int exitCode = 0;
+    if (benchmarkMode) {
+        if (benchmark.WriteJson(benchmarkOutput, replayPath.empty() ? benchmarkPath : replayPath, SCR_WIDTH, SCR_HEIGHT)) {
+            LOG_INFO(Benchmark, "Benchmark results written to %s", benchmarkOutput.c_str());
+        } else {
+            LOG_ERROR(Benchmark, "Failed to write benchmark results to %s", benchmarkOutput.c_str());
+            exitCode = -1;
+        }
+        glDeleteFramebuffers(1, &outputFBO);
+        glDeleteRenderbuffers(2, outputRenderbuffers);
+    }
+    if (!deterministic)
+        programState->SaveToFile("resources/program_state.txt");
     delete programState;
-    ImGui_ImplOpenGL3_Shutdown();
-    ImGui_ImplGlfw_Shutdown();
-    ImGui::DestroyContext();
-    // glfw: terminate, clearing all previously allocated GLFW resources.
-    // ------------------------------------------------------------------
+    profiler.Shutdown();
+    jobs.Shutdown();
+    rg::Logger::Instance().Shutdown();
+    if (!benchmarkMode) {
+        ImGui_ImplOpenGL3_Shutdown();
+        ImGui_ImplGlfw_Shutdown();
+        ImGui::DestroyContext();
+    }
+    renderTargets.Clear();
     glDeleteVertexArrays(1, &VAO);
     glDeleteBuffers(1, &VBO);
     glDeleteVertexArrays(1, &skyboxVAO);
@@ -891,56 +1766,58 @@ int main() {
     glDeleteVertexArrays(1, &VAO1);
     glDeleteBuffers(1, &VBO1);
     glDeleteBuffers(1, &skyboxVBO);
-
-    glfwTerminate();
-    return 0;
+    // let the GPU retire the fences of the per-draw ring and the pending fragment and timer queries, the
+    // destructors that run next delete them
+    glFinish();
+    return exitCode;
 }
 
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
 // ---------------------------------------------------------------------------------------------------------
 void processInput(GLFWwindow *window) {
-    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+    // escape isn't recorded, it only ends the session
+    if (window && glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
     //Movment
-    if (glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS)
+    if (inputRecorder.KeyDown(window, GLFW_KEY_LEFT_SHIFT))
         deltaTime *=5;
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+    if (inputRecorder.KeyDown(window, GLFW_KEY_W))
         programState->camera.ProcessKeyboard(FORWARD, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+    if (inputRecorder.KeyDown(window, GLFW_KEY_S))
         programState->camera.ProcessKeyboard(BACKWARD, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+    if (inputRecorder.KeyDown(window, GLFW_KEY_A))
         programState->camera.ProcessKeyboard(LEFT, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+    if (inputRecorder.KeyDown(window, GLFW_KEY_D))
         programState->camera.ProcessKeyboard(RIGHT, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS)
+    if (inputRecorder.KeyDown(window, GLFW_KEY_SPACE))
         programState->camera.ProcessKeyboard(UP, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_LEFT_CONTROL) == GLFW_PRESS)
+    if (inputRecorder.KeyDown(window, GLFW_KEY_LEFT_CONTROL))
         programState->camera.ProcessKeyboard(DOWN, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS)
+    if (inputRecorder.KeyDown(window, GLFW_KEY_Q))
         programState->camera.ProcessKeyboard(R_LEFT, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS)
+    if (inputRecorder.KeyDown(window, GLFW_KEY_E))
         programState->camera.ProcessKeyboard(R_RIGHT, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS)
+    if (inputRecorder.KeyDown(window, GLFW_KEY_F))
         programState->camera.ProcessKeyboard(TABLE_VIEW, deltaTime);
 
-    if (glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS && !bloomKeyPressed)
+    if (inputRecorder.KeyDown(window, GLFW_KEY_B) && !bloomKeyPressed)
     {
         bloom = !bloom;
         bloomKeyPressed = true;
     }
-    if (glfwGetKey(window, GLFW_KEY_B) == GLFW_RELEASE)
+    if (!inputRecorder.KeyDown(window, GLFW_KEY_B))
     {
         bloomKeyPressed = false;
     }
 
-    if (glfwGetKey(window, GLFW_KEY_N) == GLFW_PRESS)
+    if (inputRecorder.KeyDown(window, GLFW_KEY_N))
     {
         if (exposure > 0.0f)
             exposure -= 0.01f;
         else
             exposure = 0.0f;
     }
-    else if (glfwGetKey(window, GLFW_KEY_M) == GLFW_PRESS)
+    else if (inputRecorder.KeyDown(window, GLFW_KEY_M))
     {
         exposure += 0.01f;
     }
@@ -948,14 +1825,16 @@ void processInput(GLFWwindow *window) {
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
 // ---------------------------------------------------------------------------------------------
 void framebuffer_size_callback(GLFWwindow *window, int width, int height) {
-    // make sure the viewport matches the new window dimensions; note that width and
-    // height will be significantly larger than specified on retina displays.
-    glViewport(0, 0, width, height);
+    // the render thread owns the context, it sets the viewport when the next frame arrives with the new size
+    framebufferWidth = width;
+    framebufferHeight = height;
 }
 
 // glfw: whenever the mouse moves, this callback is called
 // -------------------------------------------------------
 void mouse_callback(GLFWwindow *window, double xpos, double ypos) {
+    if (!inputRecorder.OnMouse(xpos, ypos))
+        return;
     if (firstMouse) {
         lastX = xpos;
         lastY = ypos;
@@ -975,11 +1854,20 @@ void mouse_callback(GLFWwindow *window, double xpos, double ypos) {
 // glfw: whenever the mouse scroll wheel scrolls, this callback is called
 // ----------------------------------------------------------------------
 void scroll_callback(GLFWwindow *window, double xoffset, double yoffset) {
+    if (!inputRecorder.OnScroll(xoffset, yoffset))
+        return;
     programState->camera.ProcessMouseScroll(yoffset);
 }
 
-void DrawImGui(ProgramState *programState) {
-    ImGui_ImplOpenGL3_NewFrame();
+// main thread, the draw data is handed to the render thread with the frame
+void BuildImGui(ProgramState *programState) {
+    // the windows' scratch lists live in this thread's frame memory
+    rg::FrameAllocator::Instance().Reset();
+    RenderStats stats;
+    {
+        std::lock_guard<std::mutex> lock(renderStatsMutex);
+        stats = shownRenderStats;
+    }
     ImGui_ImplGlfw_NewFrame();
     ImGui::NewFrame();
 
@@ -996,6 +1884,135 @@ void DrawImGui(ProgramState *programState) {
         ImGui::DragFloat("pointLight.constant", &programState->pointLight.constant, 0.05, 0.0, 1.0);
         ImGui::DragFloat("pointLight.linear", &programState->pointLight.linear, 0.05, 0.0, 1.0);
         ImGui::DragFloat("pointLight.quadratic", &programState->pointLight.quadratic, 0.05, 0.0, 1.0);
+        ImGui::DragFloat3("pointLight.position", (float*)&programState->pointLight.position, 0.05);
+        ImGui::Checkbox("Point shadows", &programState->pointShadows);
+        ImGui::Checkbox("Moon shadows", &programState->dirShadows);
+        ImGui::SliderInt("Shadow cascades", &programState->cascadeCount, 1, rg::CascadedShadowMap::MAX_CASCADES);
+        static const int cascadeResolutions[] = {512, 1024, 2048, 4096};
+        static const char* cascadeResolutionNames[] = {"512", "1024", "2048", "4096"};
+        int resolutionIndex = 2;
+        for (int i = 0; i < 4; i++) {
+            if (cascadeResolutions[i] == programState->cascadeResolution)
+                resolutionIndex = i;
+        }
+        if (ImGui::Combo("Cascade resolution", &resolutionIndex, cascadeResolutionNames, 4))
+            programState->cascadeResolution = cascadeResolutions[resolutionIndex];
+        ImGui::SliderInt("Texture budget (MB)", &programState->textureBudgetMB, 16, 1024);
+        rg::DynamicResolution::Settings& resolution = programState->dynamicResolution;
+        auto formatCombo = [](const char* label, GLenum& format) {
+            if (ImGui::BeginCombo(label, rg::RenderTargetPool::FormatName(format))) {
+                for (GLenum candidate : hdrFormats) {
+                    if (ImGui::Selectable(rg::RenderTargetPool::FormatName(candidate), candidate == format))
+                        format = candidate;
+                }
+                ImGui::EndCombo();
+            }
+        };
+        formatCombo("HDR scene format", programState->sceneFormat);
+        formatCombo("Bloom format", programState->bloomFormat);
+        ImGui::Checkbox("Depth pre-pass", &programState->depthPrepass);
+        ImGui::Combo("Debug view", &programState->debugView, debugViewNames, 4);
+        ImGui::Checkbox("GL state cache", &programState->stateCache);
+        if (programState->debugView != DEBUG_VIEW_OFF) {
+            double scenePixels = std::max(1, stats.sceneWidth * stats.sceneHeight);
+            ImGui::Text("%.2f fragments shaded per pixel", stats.lightingFragments / scenePixels);
+            if (programState->debugView != DEBUG_VIEW_MESH_ID)
+                ImGui::Text("black 0 ... white %.0f %s", debugViewRanges[programState->debugView],
+                            programState->debugView == DEBUG_VIEW_OVERDRAW ? "fragments" : "lights");
+        }
+        ImGui::Checkbox("Dynamic resolution", &resolution.enabled);
+        ImGui::SliderFloat("Frame time target (ms)", &resolution.targetMs, 4.0f, 33.0f);
+        ImGui::SliderFloat("Min render scale", &resolution.minScale, 0.25f, resolution.maxScale);
+        ImGui::SliderFloat("Max render scale", &resolution.maxScale, resolution.minScale, 1.0f);
+        ImGui::End();
+    }
+
+    {
+        ImGui::Begin("Render stats");
+        ImGui::Text("Bloom: %s | exposure: %.2f", bloom ? "on" : "off", exposure);
+        ImGui::Text("CPU: simulation %.2f ms, render thread %.2f ms", stats.simulationMs, stats.renderMs);
+        ImGui::Text("Point shadow static rebuilds: %u%s", stats.pointShadowStaticRebuilds,
+                    stats.pointShadowStaticUpdated ? " (updated this frame)" : "");
+        ImGui::Text("Point shadow dynamic draws: %u", stats.pointShadowDynamicDraws);
+        ImGui::Text("Shader permutations: %u lighting, %u cards", stats.lightingVariants, stats.cardVariants);
+        ImGui::Text("Shaders ready after %.1f ms", stats.shaderSetupMs);
+        ImGui::Text("Per-draw data: %s, %zu KB peak, %llu stalls",
+                    stats.drawDataPersistent ? "persistent ring" : "glBufferSubData",
+                    stats.drawDataHighWater / 1024, stats.drawDataStalls);
+        ImGui::Text("Render scale: %.2f (%dx%d), GPU frame %.2f ms", stats.renderScale, stats.sceneWidth,
+                    stats.sceneHeight, stats.gpuFrameMs);
+        ImGui::Text("Render targets: %zu, %.1f MB (peak %.1f MB), %llu allocated, %llu freed",
+                    stats.renderTargetCount, stats.renderTargetBytes / (1024.0 * 1024.0),
+                    stats.renderTargetPeak / (1024.0 * 1024.0), stats.renderTargetAllocations,
+                    stats.renderTargetFrees);
+        ImGui::Text("HDR formats: scene %s, bloom %s", rg::RenderTargetPool::FormatName(stats.sceneFormat),
+                    rg::RenderTargetPool::FormatName(stats.bloomFormat));
+        // shaded fragments per scene pixel, 1 plus the overdraw where models cover the whole screen
+        double scenePixels = std::max(1, stats.sceneWidth * stats.sceneHeight);
+        ImGui::Text("Depth pre-pass: %s, lighting shades %.2f fragments per pixel", stats.depthPrepass ? "on" : "off",
+                    stats.lightingFragments / scenePixels);
+        if (stats.depthPrepass && stats.lightingFragments)
+            ImGui::Text("  without it %.2f per pixel, overdraw %.2fx", stats.prepassFragments / scenePixels,
+                        (double) stats.prepassFragments / stats.lightingFragments);
+        // worth it once the lighting time it saves is more than the time the depth-only draws take
+        if (stats.lightingMs[0] > 0.0f && stats.lightingMs[1] > 0.0f)
+            ImGui::Text("  lighting %.2f ms without, %.2f ms with + %.2f ms pre-pass: %s", stats.lightingMs[0],
+                        stats.lightingMs[1], stats.prepassMs,
+                        stats.lightingMs[1] + stats.prepassMs < stats.lightingMs[0] ? "pays off"
+                                                                                                      : "doesn't pay off");
+        unsigned long long stateCalls = 0, redundantCalls = 0;
+        for (int k = 0; k < rg::GLStateCache::KIND_COUNT; k++) {
+            stateCalls += stats.stateCalls.calls[k];
+            redundantCalls += stats.stateCalls.redundant[k];
+        }
+        // the same counts with the cache off are the calls it saves
+        if (ImGui::TreeNode("stateCache", "GL state cache: %s, %llu of %llu state calls redundant%s",
+                            stats.stateCache ? "on" : "off", redundantCalls, stateCalls,
+                            stats.stateCache ? " (skipped)" : "")) {
+            for (int k = 0; k < rg::GLStateCache::KIND_COUNT; k++)
+                ImGui::Text("%s: %llu of %llu", rg::GLStateCache::KindName((rg::GLStateCache::Kind) k),
+                            stats.stateCalls.redundant[k], stats.stateCalls.calls[k]);
+            ImGui::TreePop();
+        }
+        ImGui::Text("Program binary cache: %u hits, %u misses", stats.programCacheHits, stats.programCacheMisses);
+        for (int c = 0; c < stats.cascadeCount; c++) {
+            const rg::CascadedShadowMap::CascadeStats& cascade = stats.cascades[c];
+            ImGui::Text("Cascade %d: %u draws, cpu %.3f ms, gpu %.3f ms%s", c, cascade.drawCalls, cascade.cpuMs,
+                        cascade.gpuMs, cascade.updated ? "" : " (cached)");
+        }
+        ImGui::End();
+    }
+
+    {
+        ImGui::Begin("Profiler");
+        rg::Profiler::Instance().DrawTimeline();
+        ImGui::End();
+    }
+
+    {
+        ImGui::Begin("Memory");
+        rg::MemoryTracker::Instance().DrawWindow();
+        ImGui::End();
+    }
+
+    {
+        ImGui::Begin("Texture streaming");
+        rg::TextureStreamer::Instance().DrawWindow();
+        ImGui::End();
+    }
+
+    {
+        ImGui::Begin("Allocations");
+        ImGui::Text("Frame allocator: %.1f KB used, high water %.1f KB of %.1f KB",
+                    stats.frameAllocatorUsed / 1024.0, stats.frameAllocatorHighWater / 1024.0,
+                    stats.frameAllocatorCapacity / 1024.0);
+        rg::AllocationTracker::Instance().DrawWindow();
+        ImGui::End();
+    }
+
+    if (rg::GLStats::Enabled()) {
+        ImGui::Begin("GL calls");
+        rg::GLStats::Instance().DrawWindow();
         ImGui::End();
     }
 
@@ -1010,21 +2027,21 @@ void DrawImGui(ProgramState *programState) {
     }
 
     ImGui::Render();
-    ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 }
 
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods) {
+    if (!inputRecorder.OnKey(key, scancode, action, mods))
+        return;
     if (key == GLFW_KEY_F1 && action == GLFW_PRESS) {
         programState->ImGuiEnabled = !programState->ImGuiEnabled;
-        if (programState->ImGuiEnabled) {
+        if (programState->ImGuiEnabled)
             programState->CameraMouseMovementUpdateEnabled = false;
-            glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
-        } else {
-            glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-        }
+        // a headless replay has no window
+        if (window)
+            glfwSetInputMode(window, GLFW_CURSOR, programState->ImGuiEnabled ? GLFW_CURSOR_NORMAL : GLFW_CURSOR_DISABLED);
     }
     //spotLight on/off
-    if (glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS)
+    if (key == GLFW_KEY_T && action == GLFW_PRESS)
         programState->spotLight.turnOn = !programState->spotLight.turnOn;
     // --------------------------------------------------
     // USED FOR MINI GAME
@@ -1042,39 +2059,51 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod
 }
 //utility function for loading a 2D texture from file
 // ---------------------------------------------------
-unsigned int loadTexture(char const * path)
+// stb_image only, safe to call from any thread
+DecodedImage decodeImage(const std::string& path)
 {
+    DecodedImage image;
+    image.path = path;
+    image.data = stbi_load(path.c_str(), &image.width, &image.height, &image.components, 0);
+    return image;
+}
+
+// main thread, creates the texture and frees the decoded pixels
+unsigned int uploadTexture(DecodedImage& image)
+{
+    STARTUP_SCOPE(image.path);
+    const char* path = image.path.c_str();
     unsigned int textureID;
     glGenTextures(1, &textureID);
 
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
-    if (data)
+    if (image.data)
     {
         GLenum format;
-        if (nrComponents == 1)
+        if (image.components == 1)
             format = GL_RED;
-        else if (nrComponents == 3)
+        else if (image.components == 3)
             format = GL_RGB;
-        else if (nrComponents == 4)
+        else if (image.components == 4)
             format = GL_RGBA;
 
         glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+        rg::GLDebug::Label(GL_TEXTURE, textureID, path);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.data);
         glGenerateMipmap(GL_TEXTURE_2D);
+        rg::MemoryTracker::Instance().Track(rg::MemoryTracker::Kind::Texture, textureID, path,
+                                            rg::MemoryTracker::TextureBytes(format, image.width, image.height, 1, true));
 
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT); // for this tutorial: use GL_CLAMP_TO_EDGE to prevent semi-transparent borders. Due to interpolation it takes texels from next repeat
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
     }
     else
     {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
+        LOG_ERROR(Assets, "Texture failed to load at path: %s", path);
     }
+    stbi_image_free(image.data);
+    image.data = nullptr;
 
     return textureID;
 }
@@ -1084,27 +2113,36 @@ unsigned int loadCubemap(vector<std::string> faces)
     unsigned int textureID;
     glGenTextures(1, &textureID);
     glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-
-    int width, height, nrChannels;
+    rg::GLDebug::Label(GL_TEXTURE, textureID, "Skybox cubemap");
+
+    // the faces are decoded in parallel, uploading stays on this thread
+    vector<DecodedImage> images(faces.size());
+    rg::JobSystem::Instance().ParallelFor(faces.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+            images[i] = decodeImage(faces[i]);
+    });
+    size_t bytes = 0;
     for (unsigned int i = 0; i < faces.size(); i++)
     {
-        unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-        if (data)
+        STARTUP_SCOPE(faces[i]);
+        DecodedImage& image = images[i];
+        if (image.data)
         {
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-            stbi_image_free(data);
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, image.width, image.height, 0, GL_RGB, GL_UNSIGNED_BYTE, image.data);
+            bytes += rg::MemoryTracker::TextureBytes(GL_RGB, image.width, image.height);
         }
         else
         {
-            std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
-            stbi_image_free(data);
+            LOG_ERROR(Assets, "Cubemap texture failed to load at path: %s", faces[i].c_str());
         }
+        stbi_image_free(image.data);
     }
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    rg::MemoryTracker::Instance().Track(rg::MemoryTracker::Kind::Texture, textureID, "Skybox cubemap", bytes, "Skybox");
 
     return textureID;
 }